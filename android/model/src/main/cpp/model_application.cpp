@@ -1,21 +1,75 @@
 #include "model_application.h"
 
+#include <algorithm>
 #include <array>
-#include <istream>
-#include <string>
-#include <sstream>
-#include <unordered_map>
+#include <cmath>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 
 #include <log.h>
 #include <filesystem.h>
+#include <obj_loader.h>
+#include <vertex_welder.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
+
+namespace {
+
+const char *kModelFile = "models/viking_room.obj";
+const char *kModelCacheFile = "viking_room.mesh";
+const char *kTextureFile = "textures/viking_room.png";
+const char *kTextureKtx2File = "textures/viking_room.ktx2";
+const char *kTextureCacheFile = "viking_room.etc2";
+
+// Leaves the levels above texture.first_level out of a chain uploaded as is. The data before
+// the first level kept is not staged, which drops the skipped levels of chains stored largest
+// first.
+void SkipLevels(StreamedTexture &texture) {
+    if (texture.HasRgba8Level0() || texture.generate_mipmaps || texture.first_level == 0) {
+        return;
+    }
+    auto last_level = static_cast<uint32_t>(texture.levels.size()) - 1;
+    texture.first_level = std::min(texture.first_level, last_level);
+    texture.levels.erase(texture.levels.begin(), texture.levels.begin() + texture.first_level);
+    size_t offset = texture.size;
+    for (const tiny_engine::MipLevel &level : texture.levels) {
+        offset = std::min(offset, level.offset);
+    }
+    for (tiny_engine::MipLevel &level : texture.levels) {
+        level.offset -= offset;
+    }
+    texture.data += offset;
+    texture.size -= offset;
+}
+
+// Bytes of each level of the full chain, for TextureResidency. Formats GetTextureLevels does
+// not know are counted at 4 bytes per pixel.
+std::vector<size_t> GetLevelSizes(VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t mip_levels) {
+    std::vector<tiny_engine::MipLevel> levels = tiny_engine::GetTextureLevels(format,
+                                                                              width,
+                                                                              height,
+                                                                              mip_levels);
+    size_t size = tiny_engine::GetTextureSize(format, width, height, mip_levels);
+    if (levels.empty()) {
+        levels = tiny_engine::GetMipChainLayout(width, height, mip_levels, 4);
+        size = tiny_engine::GetMipChainSize(width, height, mip_levels, 4);
+    }
+    std::vector<size_t> sizes(mip_levels);
+    for (uint32_t i = 0; i < mip_levels; i++) {
+        sizes[i] = (i + 1 < mip_levels ? levels[i + 1].offset : size) - levels[i].offset;
+    }
+    return sizes;
+}
+
+} // namespace
 
 ModelApplication::ModelApplication(void *native_window, std::vector<char> vert_shader_code,
-                                   std::vector<char> frag_shader_code) {
+                                   std::vector<char> frag_shader_code,
+                                   bool split_for_16bit_indices)
+        : split_for_16bit_indices_(split_for_16bit_indices) {
     layers_ = {
             "VK_LAYER_KHRONOS_validation"
     };
@@ -28,8 +82,11 @@ ModelApplication::ModelApplication(void *native_window, std::vector<char> vert_s
     native_window_ = native_window;
     vert_shader_code_ = vert_shader_code;
     frag_shader_code_ = frag_shader_code;
-    binding_descriptions_ = Vertex::GetBindingDescription();
-    attribute_descriptions_ = Vertex::GetAttributeDescriptions();
+    vertex_layout_ = tiny_engine::MakeVertexLayout(tiny_engine::PositionFormat::kSnorm16,
+                                                   tiny_engine::ColorFormat::kUnorm8,
+                                                   tiny_engine::TexCoordFormat::kFloat16);
+    binding_descriptions_ = tiny_engine::GetVertexBindingDescriptions(vertex_layout_);
+    attribute_descriptions_ = tiny_engine::GetVertexAttributeDescriptions(vertex_layout_);
     max_frames_in_flight_ = 2;
 }
 
@@ -38,193 +95,256 @@ void ModelApplication::Init() {
     VulkanApplication::Init();
 }
 
-void ModelApplication::Draw() {
-    vkWaitForFences(device_, 1, &in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
-
-    uint32_t image_index;
-    VkResult result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX,
-                                            image_available_semaphores_[current_frame_],
-                                            VK_NULL_HANDLE,
-                                            &image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        LOGI("RecreateSwapChain cause of VK_ERROR_OUT_OF_DATE_KHR");
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+void ModelApplication::DestroyResources() {
+    if (culled_index_buffer_ != VK_NULL_HANDLE) {
+        DestroyBuffer(device_, culled_index_buffer_, culled_index_buffer_memory_);
     }
-
-    UpdateUniformBuffer(image_index);
-
-    if (images_in_flight_[image_index] != VK_NULL_HANDLE) {
-        vkWaitForFences(device_, 1, &images_in_flight_[image_index], VK_TRUE, UINT64_MAX);
+    vkDestroySampler(device_, texture_sampler_, nullptr);
+    for (const auto &texture : staged_textures_) {
+        DestroyTextureStaging(*texture);
     }
-    images_in_flight_[image_index] = in_flight_fences_[current_frame_];
-
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-    VkSemaphore wait_semaphores[] = {image_available_semaphores_[current_frame_]};
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
+    staged_textures_.clear();
+    if (texture_file_ != nullptr) {
+        texture_residency_.Remove(texture_residency_id_);
+    }
+    if (texture_image_ != VK_NULL_HANDLE) {
+        vkDestroyImageView(device_, texture_image_view_, nullptr);
+        DestroyImage(device_, texture_image_, texture_image_memory_);
+    }
+    vkDestroyImageView(device_, placeholder_image_view_, nullptr);
+    DestroyImage(device_, placeholder_image_, placeholder_image_memory_);
+}
 
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffers_[image_index];
+void ModelApplication::Rotate(float radius, float x, float y, float z) {
+    glm::mat4 tmp = glm::mat4(ubo_.model);
+    ubo_.model = glm::rotate(glm::mat4(1.0f), radius, glm::vec3(x, y, z)) * tmp;
+}
 
-    VkSemaphore signal_semaphores[] = {render_finished_semaphores_[current_frame_]};
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = signal_semaphores;
+void ModelApplication::CreateTextureImage() {
+    // The model is drawn with a grey texel until the streamed texture has been uploaded.
+    const uint8_t placeholder[4] = {128, 128, 128, 255};
+    UploadTextureImage(placeholder,
+                       1,
+                       1,
+                       VK_FORMAT_R8G8B8A8_SRGB,
+                       placeholder_image_,
+                       placeholder_image_memory_);
+
+    // A KTX2 container shipped with the image is uploaded as is, without decoding or encoding.
+    bool ktx2 = tiny_engine::Filesystem::GetInstance().Exists(kTextureKtx2File);
+    RequestTexture(ktx2 ? kTextureKtx2File : kTextureFile);
+}
 
-    vkResetFences(device_, 1, &in_flight_fences_[current_frame_]);
+void ModelApplication::CreateTextureImageView() {
+    placeholder_image_view_ = CreateImageView(device_,
+                                              placeholder_image_,
+                                              VK_FORMAT_R8G8B8A8_SRGB,
+                                              VK_IMAGE_ASPECT_COLOR_BIT);
+}
 
-    if (vkQueueSubmit(graphics_queue_, 1, &submit_info, in_flight_fences_[current_frame_]) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+void ModelApplication::RequestTexture(const char *filename, uint32_t first_level) {
+    bool ktx2 = strcmp(filename, kTextureKtx2File) == 0;
+    VkFormat rgb_format = FindTextureFormat(false);
+    VkFormat rgba_format = FindTextureFormat(true);
+    auto texture = std::make_shared<StreamedTexture>();
+    texture->first_level = first_level;
+
+    // An image which stays RGBA8 is decoded straight into staging memory, which has to be made
+    // here on the render thread. Only its header is read, the decode worker faults in the rest.
+    size_t level0_size = 0;
+    if (!ktx2 && tiny_engine::Filesystem::GetInstance().Exists(filename)) {
+        tiny_engine::FileView file = tiny_engine::Filesystem::GetInstance().Map(filename);
+        tiny_engine::ImageInfo info;
+        VkFormat format;
+        if (tiny_engine::GetImageInfo(file.data(), file.size(), info)
+            && tiny_engine::GetStagedImageFormat(info, rgb_format, rgba_format, format)) {
+            level0_size = tiny_engine::GetDecodeBufferSize(info);
+            CreateTextureStaging(info.width, info.height, format, level0_size, *texture);
+            staged_textures_.push_back(texture);
+        }
     }
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signal_semaphores;
+    tiny_engine::StreamRequest request;
+    request.filename = filename;
+    request.decode = [texture, ktx2, rgb_format, rgba_format, level0_size](
+            const tiny_engine::FileView &file) {
+        if (ktx2) {
+            if (!tiny_engine::LoadKtx2Texture(file, *texture)) {
+                throw std::runtime_error("failed to load texture image!");
+            }
+        } else if (texture->staging_buffer != VK_NULL_HANDLE) {
+            tiny_engine::DecodeImageFile(file,
+                                         static_cast<uint8_t *>(texture->staging_memory.mapped),
+                                         level0_size);
+        } else {
+            // The baked chain for this version of the image, or decode, encode and bake it.
+            uint64_t source_hash = tiny_engine::HashBytes(file.data(), file.size());
+            if (!tiny_engine::LoadBakedTexture(kTextureCacheFile,
+                                               source_hash,
+                                               rgb_format,
+                                               rgba_format,
+                                               *texture)) {
+                tiny_engine::EncodeTexture(tiny_engine::DecodeImageFile(file),
+                                           kTextureCacheFile,
+                                           source_hash,
+                                           rgb_format,
+                                           rgba_format,
+                                           *texture);
+            }
+        }
+        size_t size = texture->size;
+        SkipLevels(*texture);
+        return size;
+    };
+    request.upload = [this, texture, ktx2, filename, first_level]() {
+        ForgetStagedTexture(texture);
+        if (ktx2 && !SupportsTextureFormat(texture->format)) {
+            LOGW("%s has an unsupported format, falling back to %s", kTextureKtx2File,
+                 kTextureFile);
+            RequestTexture(kTextureFile, first_level);
+            return;
+        }
+        texture_file_ = filename;
+        UploadStreamedTexture(*texture);
+    };
+    request.fail = [this, texture, ktx2, first_level](const std::string &error) {
+        LOGW("failed to stream the texture: %s", error.c_str());
+        ForgetStagedTexture(texture);
+        DestroyTextureStaging(*texture);
+        if (ktx2) {
+            RequestTexture(kTextureFile, first_level);
+        } else if (texture_file_ != nullptr) {
+            // Keep what is resident, the residency manager may ask again.
+            texture_residency_.SetResident(texture_residency_id_,
+                                           texture_image_ != VK_NULL_HANDLE
+                                           ? texture_first_level_ : texture_mip_levels_);
+        }
+    };
+    asset_streamer_.Request(std::move(request));
+}
 
-    VkSwapchainKHR swapchains[] = {swapchain_};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapchains;
+void ModelApplication::ForgetStagedTexture(const std::shared_ptr<StreamedTexture> &texture) {
+    auto it = std::find(staged_textures_.begin(), staged_textures_.end(), texture);
+    if (it != staged_textures_.end()) {
+        staged_textures_.erase(it);
+    }
+}
 
-    presentInfo.pImageIndices = &image_index;
+void ModelApplication::UploadStreamedTexture(const StreamedTexture &texture) {
+    RetireTexture();
+    texture_format_ = texture.format;
+    // Levels uploaded, starting at first_level unless the chain is built here.
+    uint32_t mip_levels = UploadTexture(texture, texture_image_, texture_image_memory_);
+    uint32_t first_level = 0;
+    if (!texture.HasRgba8Level0() && !texture.generate_mipmaps) {
+        first_level = texture.first_level;
+    }
 
-    result = vkQueuePresentKHR(present_queue_, &presentInfo);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        LOGI("RecreateSwapChain cause of result:%d", result);
-        return;
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("failed to present swap chain image!");
+    if (texture_file_ != nullptr && texture_width_ == 0) {
+        // The first upload is the full chain, the residency manager is told its level sizes.
+        texture_width_ = texture.levels[0].width;
+        texture_height_ = texture.levels[0].height;
+        texture_mip_levels_ = mip_levels;
+        tiny_engine::TextureResidencyHandlers handlers;
+        handlers.trim = [this](uint32_t first_level) { TrimTexture(first_level); };
+        handlers.evict = [this]() { EvictTexture(); };
+        handlers.restream = [this](uint32_t first_level) {
+            RequestTexture(texture_file_, first_level);
+        };
+        texture_residency_id_ = texture_residency_.Add(GetLevelSizes(texture_format_,
+                                                                     texture_width_,
+                                                                     texture_height_,
+                                                                     texture_mip_levels_),
+                                                       std::move(handlers));
+    }
+    texture_first_level_ = first_level;
+    if (first_level < texture.first_level && texture.first_level < mip_levels) {
+        // A chain built on upload is always full, drop the levels above the one asked for.
+        TrimTextureImage(texture_image_,
+                         texture_image_memory_,
+                         texture_format_,
+                         texture.levels[0].width,
+                         texture.levels[0].height,
+                         mip_levels,
+                         texture.first_level);
+        texture_first_level_ = texture.first_level;
     }
+    texture_residency_.SetResident(texture_residency_id_, texture_first_level_);
 
-    current_frame_ = (current_frame_ + 1) % max_frames_in_flight_;
-    vkDeviceWaitIdle(device_);
+    texture_image_view_ = CreateImageView(device_,
+                                          texture_image_,
+                                          texture_format_,
+                                          VK_IMAGE_ASPECT_COLOR_BIT,
+                                          texture_mip_levels_ - texture_first_level_);
+    // The descriptor sets of frames in flight still reference the previous image, each is
+    // switched over by UpdateFrame once its frame slot is free.
+    stale_texture_descriptors_.assign(max_frames_in_flight_, true);
 }
 
-void ModelApplication::Cleanup() {
-    vkDestroySampler(device_, texture_sampler_, nullptr);
-    vkDestroyImageView(device_, texture_image_view_, nullptr);
-    vkDestroyImage(device_, texture_image_, nullptr);
-    vkFreeMemory(device_, texture_image_memory_, nullptr);
-    VulkanApplication::Cleanup();
+void ModelApplication::TrimTexture(uint32_t first_level) {
+    std::vector<tiny_engine::MipLevel> levels = tiny_engine::GetMipChainLayout(texture_width_,
+                                                                               texture_height_,
+                                                                               texture_mip_levels_,
+                                                                               1);
+    const tiny_engine::MipLevel &level = levels[texture_first_level_];
+    VkImageView image_view = texture_image_view_;
+    RetireResource([this, image_view]() {
+        vkDestroyImageView(device_, image_view, nullptr);
+    });
+    TrimTextureImage(texture_image_,
+                     texture_image_memory_,
+                     texture_format_,
+                     level.width,
+                     level.height,
+                     texture_mip_levels_ - texture_first_level_,
+                     first_level - texture_first_level_);
+    texture_first_level_ = first_level;
+    texture_residency_.SetResident(texture_residency_id_, texture_first_level_);
+    texture_image_view_ = CreateImageView(device_,
+                                          texture_image_,
+                                          texture_format_,
+                                          VK_IMAGE_ASPECT_COLOR_BIT,
+                                          texture_mip_levels_ - texture_first_level_);
+    stale_texture_descriptors_.assign(max_frames_in_flight_, true);
 }
 
-void ModelApplication::Rotate(float radius, float x, float y, float z) {
-    glm::mat4 tmp = glm::mat4(ubo_.model);
-    ubo_.model = glm::rotate(glm::mat4(1.0f), radius, glm::vec3(x, y, z)) * tmp;
+void ModelApplication::EvictTexture() {
+    RetireTexture();
+    // Drawn with the placeholder until it is streamed again.
+    stale_texture_descriptors_.assign(max_frames_in_flight_, true);
 }
 
-void ModelApplication::CreateDescriptorSetLayout() {
-    VkDescriptorSetLayoutBinding ubo_layout_binding{};
-    ubo_layout_binding.binding = 0;
-    ubo_layout_binding.descriptorCount = 1;
-    ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    ubo_layout_binding.pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutBinding sampler_layout_binding{};
-    sampler_layout_binding.binding = 1;
-    sampler_layout_binding.descriptorCount = 1;
-    sampler_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    sampler_layout_binding.pImmutableSamplers = nullptr;
-
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {ubo_layout_binding,
-                                                            sampler_layout_binding};
-
-    VkDescriptorSetLayoutCreateInfo layout_create_info{};
-    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layout_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
-    layout_create_info.pBindings = bindings.data();
-    if (vkCreateDescriptorSetLayout(device_, &layout_create_info, nullptr,
-                                    &descriptor_set_layout_) != VK_SUCCESS ||
-        descriptor_set_layout_ == VK_NULL_HANDLE) {
-        throw std::runtime_error("failed to create descriptor set layout!");
+void ModelApplication::RetireTexture() {
+    if (texture_image_ == VK_NULL_HANDLE) {
+        return;
     }
+    VkImage image = texture_image_;
+    tiny_engine::MemoryAllocation image_memory = texture_image_memory_;
+    VkImageView image_view = texture_image_view_;
+    RetireResource([this, image, image_memory, image_view]() mutable {
+        vkDestroyImageView(device_, image_view, nullptr);
+        DestroyImage(device_, image, image_memory);
+    });
+    texture_image_ = VK_NULL_HANDLE;
+    texture_image_view_ = VK_NULL_HANDLE;
 }
 
-void ModelApplication::CreateTextureImage() {
-    int tex_width, tex_height, tex_channels;
-    auto img = tiny_engine::Filesystem::GetInstance().Read<stbi_uc>("textures/viking_room.png");
-    stbi_uc *pixels = stbi_load_from_memory(img.data(),
-                                            img.size(),
-                                            &tex_width,
-                                            &tex_height,
-                                            &tex_channels,
-                                            STBI_rgb_alpha);
-    VkDeviceSize image_size = tex_width * tex_height * 4;
-
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
-    }
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    CreateBuffer(physical_device_,
-                 device_,
-                 image_size,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 staging_buffer,
-                 staging_buffer_memory);
-
-    void *data;
-    vkMapMemory(device_, staging_buffer_memory, 0, image_size, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(image_size));
-    vkUnmapMemory(device_, staging_buffer_memory);
-
-    stbi_image_free(pixels);
-
-    CreateImage(physical_device_,
-                device_,
-                tex_width,
-                tex_height,
-                VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                texture_image_,
-                texture_image_memory_);
-
-    TransitionImageLayout(device_,
-                          command_pool_,
-                          graphics_queue_,
-                          texture_image_,
-                          VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    CopyBufferToImage(device_,
-                      command_pool_,
-                      graphics_queue_,
-                      staging_buffer,
-                      texture_image_,
-                      static_cast<uint32_t>(tex_width),
-                      static_cast<uint32_t>(tex_height));
-
-    TransitionImageLayout(device_,
-                          command_pool_,
-                          graphics_queue_,
-                          texture_image_,
-                          VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    vkDestroyBuffer(device_, staging_buffer, nullptr);
-    vkFreeMemory(device_, staging_buffer_memory, nullptr);
-}
-
-void ModelApplication::CreateTextureImageView() {
-    texture_image_view_ = CreateImageView(device_,
-                                          texture_image_,
-                                          VK_FORMAT_R8G8B8A8_SRGB,
-                                          VK_IMAGE_ASPECT_COLOR_BIT);
+void ModelApplication::UpdateTextureDescriptor(VkDescriptorSet descriptor_set) {
+    VkDescriptorImageInfo image_info{};
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = texture_image_ != VK_NULL_HANDLE ? texture_image_view_
+                                                            : placeholder_image_view_;
+    image_info.sampler = texture_sampler_;
+
+    VkWriteDescriptorSet descriptor_write{};
+    descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_write.dstSet = descriptor_set;
+    descriptor_write.dstBinding = 1;
+    descriptor_write.dstArrayElement = 0;
+    descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptor_write.descriptorCount = 1;
+    descriptor_write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(device_, 1, &descriptor_write, 0, nullptr);
 }
 
 void ModelApplication::CreateTextureSampler() {
@@ -242,6 +362,10 @@ void ModelApplication::CreateTextureSampler() {
     sampler_create_info.compareEnable = VK_FALSE;
     sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
     sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_create_info.minLod = 0.0f;
+    // Not limited to the levels of the placeholder, the view limits the levels sampled.
+    sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+    sampler_create_info.mipLodBias = 0.0f;
 
     if (vkCreateSampler(device_, &sampler_create_info, nullptr, &texture_sampler_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -249,10 +373,11 @@ void ModelApplication::CreateTextureSampler() {
 }
 
 void ModelApplication::CreateVertexBuffer() {
-    VkDeviceSize buffer_size = sizeof(vertices_[0]) * vertices_.size();
+    const void *vertex_data = mesh_cached_ ? mesh_cache_.GetVertices() : vertex_data_.data();
+    VkDeviceSize buffer_size = mesh_cached_ ? mesh_cache_.GetVertexSize() : vertex_data_.size();
 
     VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    tiny_engine::MemoryAllocation staging_buffer_memory;
     CreateBuffer(physical_device_,
                  device_,
                  buffer_size,
@@ -262,10 +387,7 @@ void ModelApplication::CreateVertexBuffer() {
                  staging_buffer_memory);
 
 
-    void *data;
-    vkMapMemory(device_, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, vertices_.data(), (size_t) buffer_size);
-    vkUnmapMemory(device_, staging_buffer_memory);
+    memcpy(staging_buffer_memory.mapped, vertex_data, (size_t) buffer_size);
 
     CreateBuffer(physical_device_,
                  device_,
@@ -282,14 +404,14 @@ void ModelApplication::CreateVertexBuffer() {
                vertex_buffer_,
                buffer_size);
 
-    vkDestroyBuffer(device_, staging_buffer, nullptr);
-    vkFreeMemory(device_, staging_buffer_memory, nullptr);
+    ReleaseStagingBuffer(device_, staging_buffer, staging_buffer_memory);
 }
 
 void ModelApplication::CreateIndexBuffer() {
-    VkDeviceSize buffer_size = sizeof(indices_[0]) * indices_.size();
+    const void *index_data = GetIndexData();
+    VkDeviceSize buffer_size = mesh_cached_ ? mesh_cache_.GetIndexSize() : indices_.GetSize();
     VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    tiny_engine::MemoryAllocation staging_buffer_memory;
     CreateBuffer(physical_device_,
                  device_,
                  buffer_size,
@@ -298,10 +420,7 @@ void ModelApplication::CreateIndexBuffer() {
                  staging_buffer,
                  staging_buffer_memory);
 
-    void *data;
-    vkMapMemory(device_, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, indices_.data(), (size_t) buffer_size);
-    vkUnmapMemory(device_, staging_buffer_memory);
+    memcpy(staging_buffer_memory.mapped, index_data, (size_t) buffer_size);
 
     CreateBuffer(physical_device_,
                  device_,
@@ -318,209 +437,269 @@ void ModelApplication::CreateIndexBuffer() {
                index_buffer_,
                buffer_size);
 
-    vkDestroyBuffer(device_, staging_buffer, nullptr);
-    vkFreeMemory(device_, staging_buffer_memory, nullptr);
-}
+    ReleaseStagingBuffer(device_, staging_buffer, staging_buffer_memory);
 
-void ModelApplication::CreateUniformBuffers() {
-    VkDeviceSize buffer_size = sizeof(UniformBufferObject);
-
-    uniform_buffers_.resize(swapchain_images_.size());
-    uniform_buffers_memory_.resize(swapchain_images_.size());
-
-    ubo_.model = glm::mat4(1.0f);
-    ubo_.view = glm::lookAt(glm::vec3(0.0f, 0.0f, -6.0f), glm::vec3(0.0f, 0.0f, 0.0f),
-                            glm::vec3(0.0f, 1.0f, 0.0f));
-    ubo_.proj = glm::perspective(glm::radians(45.0f),
-                                 swapchain_extent_.width / (float) swapchain_extent_.height, 0.1f,
-                                 10.0f);
-    ubo_.proj[1][1] *= -1;
-
-    for (size_t i = 0; i < swapchain_images_.size(); i++) {
+    if (!meshlets_.empty()) {
+        VkDeviceSize index_size = index_type_ == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t)
+                                                                      : sizeof(uint32_t);
+        culled_index_slice_size_ = sub_meshes_[0].index_count * index_size;
+        culled_index_counts_.assign(max_frames_in_flight_, 0);
         CreateBuffer(physical_device_,
                      device_,
-                     buffer_size,
-                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     culled_index_slice_size_ * max_frames_in_flight_,
+                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     uniform_buffers_[i],
-                     uniform_buffers_memory_[i]);
-
-
-        void *data;
-        vkMapMemory(device_, uniform_buffers_memory_[i], 0, sizeof(ubo_), 0, &data);
-        memcpy(data, &ubo_, sizeof(ubo_));
-        vkUnmapMemory(device_, uniform_buffers_memory_[i]);
+                     culled_index_buffer_,
+                     culled_index_buffer_memory_);
     }
 }
 
-void ModelApplication::CreateDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 2> pool_sizes{};
-    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes[0].descriptorCount = static_cast<uint32_t>(swapchain_images_.size());
-    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes[1].descriptorCount = static_cast<uint32_t>(swapchain_images_.size());
-
-    VkDescriptorPoolCreateInfo pool_create_info{};
-    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-    pool_create_info.pPoolSizes = pool_sizes.data();
-    pool_create_info.maxSets = static_cast<uint32_t>(swapchain_images_.size());
-    if (vkCreateDescriptorPool(device_, &pool_create_info, nullptr, &descriptor_pool_) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor pool!");
+void ModelApplication::CreateUniformBuffers() {
+    ubo_.model = glm::mat4(1.0f);
+    ubo_.view = glm::lookAt(glm::vec3(0.0f, 0.0f, -6.0f), glm::vec3(0.0f, 0.0f, 0.0f),
+                            glm::vec3(0.0f, 1.0f, 0.0f));
+    UpdateProjection();
+
+    CreateUniformRingBuffer(sizeof(UniformBufferObject), max_frames_in_flight_);
+    for (uint32_t i = 0; i < max_frames_in_flight_; i++) {
+        memcpy(GetUniformSlot(i), &ubo_, sizeof(ubo_));
     }
 }
 
 void ModelApplication::CreateDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(swapchain_images_.size(), descriptor_set_layout_);
-    VkDescriptorSetAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    alloc_info.descriptorPool = descriptor_pool_;
-    alloc_info.descriptorSetCount = static_cast<uint32_t>(swapchain_images_.size());
-    alloc_info.pSetLayouts = layouts.data();
-
-    descriptor_sets_.resize(swapchain_images_.size());
-    if (vkAllocateDescriptorSets(device_, &alloc_info, descriptor_sets_.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate descriptor sets!");
-    }
+    VulkanApplication::CreateDescriptorSets();
 
-    for (size_t i = 0; i < swapchain_images_.size(); i++) {
+    for (size_t i = 0; i < max_frames_in_flight_; i++) {
         VkDescriptorBufferInfo buffer_info{};
-        buffer_info.buffer = uniform_buffers_[i];
+        buffer_info.buffer = uniform_buffer_;
         buffer_info.offset = 0;
         buffer_info.range = sizeof(UniformBufferObject);
 
-        VkDescriptorImageInfo image_info{};
-        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_info.imageView = texture_image_view_;
-        image_info.sampler = texture_sampler_;
-
-        std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
+        std::array<VkWriteDescriptorSet, 1> descriptor_writes{};
 
         descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptor_writes[0].dstSet = descriptor_sets_[i];
         descriptor_writes[0].dstBinding = 0;
         descriptor_writes[0].dstArrayElement = 0;
-        descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptor_writes[0].descriptorCount = 1;
         descriptor_writes[0].pBufferInfo = &buffer_info;
 
-        descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptor_writes[1].dstSet = descriptor_sets_[i];
-        descriptor_writes[1].dstBinding = 1;
-        descriptor_writes[1].dstArrayElement = 0;
-        descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptor_writes[1].descriptorCount = 1;
-        descriptor_writes[1].pImageInfo = &image_info;
-
         vkUpdateDescriptorSets(device_, static_cast<uint32_t>(descriptor_writes.size()),
                                descriptor_writes.data(), 0, nullptr);
+        UpdateTextureDescriptor(descriptor_sets_[i]);
     }
+    stale_texture_descriptors_.assign(max_frames_in_flight_, false);
 }
 
-void ModelApplication::CreateCommandBuffers() {
-    command_buffers_.resize(framebuffers_.size());
-    VkCommandBufferAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.commandPool = command_pool_;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandBufferCount = (uint32_t) command_buffers_.size();
+void ModelApplication::RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                           uint32_t image_index) {
+    if (texture_file_ != nullptr) {
+        texture_residency_.Touch(texture_residency_id_, frame_count_);
+    }
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
+
+    VkBuffer vertex_buffers[] = {vertex_buffer_};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+    uint32_t dynamic_offset = GetUniformOffset(current_frame_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_,
+                            0, 1, &descriptor_sets_[current_frame_], 1, &dynamic_offset);
+
+    if (current_lod_ == 0 && !meshlets_.empty()) {
+        vkCmdBindIndexBuffer(command_buffer, culled_index_buffer_,
+                             culled_index_slice_size_ * current_frame_, index_type_);
+        vkCmdDrawIndexed(command_buffer, culled_index_counts_[current_frame_], 1, 0, 0, 0);
+        return;
+    }
 
-    if (vkAllocateCommandBuffers(device_, &alloc_info, command_buffers_.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
+    vkCmdBindIndexBuffer(command_buffer, index_buffer_, 0, index_type_);
+    if (current_lod_ > 0) {
+        const tiny_engine::MeshLod &lod = lods_[current_lod_];
+        vkCmdDrawIndexed(command_buffer, lod.index_count, 1, lod.first_index, 0, 0);
+        return;
     }
+    for (const auto &sub_mesh : sub_meshes_) {
+        vkCmdDrawIndexed(command_buffer, sub_mesh.index_count, 1, sub_mesh.first_index,
+                         sub_mesh.vertex_offset, 0);
+    }
+}
 
-    for (size_t i = 0; i < command_buffers_.size(); i++) {
-        VkCommandBufferBeginInfo begin_info{};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+void ModelApplication::OnSwapchainRecreated() {
+    UpdateProjection();
+}
 
-        if (vkBeginCommandBuffer(command_buffers_[i], &begin_info) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin recording command buffer!");
-        }
+void ModelApplication::UpdateProjection() {
+    ubo_.proj = glm::perspective(glm::radians(45.0f),
+                                 swapchain_extent_.width / (float) swapchain_extent_.height, 0.1f,
+                                 10.0f);
+    ubo_.proj[1][1] *= -1;
+}
 
-        VkRenderPassBeginInfo render_pass_begin_info{};
-        render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        render_pass_begin_info.renderPass = render_pass_;
-        render_pass_begin_info.framebuffer = framebuffers_[i];
-        render_pass_begin_info.renderArea.offset = {0, 0};
-        render_pass_begin_info.renderArea.extent = swapchain_extent_;
+void ModelApplication::UpdateFrame(uint32_t frame_index) {
+    if (stale_texture_descriptors_[frame_index]) {
+        UpdateTextureDescriptor(descriptor_sets_[frame_index]);
+        stale_texture_descriptors_[frame_index] = false;
+    }
 
-        std::array<VkClearValue, 2> clear_values{};
-        clear_values[0].color = {1.0f, 1.0f, 1.0f, 1.0f};
-        clear_values[1].depthStencil = {1.0f, 0};
+    UniformBufferObject ubo = ubo_;
+    ubo.model = ubo_.model * dequantize_;
+    memcpy(GetUniformSlot(frame_index), &ubo, sizeof(ubo));
+
+    if (lods_.size() > 1) {
+        // Distance to the nearest point of the bounding sphere, so no part of the model shows
+        // more than a pixel of error.
+        glm::vec4 center = ubo_.view * ubo_.model * glm::vec4(bounds_center_, 1.0f);
+        float distance = std::max(glm::length(glm::vec3(center)) - bounds_radius_, 0.1f);
+        current_lod_ = tiny_engine::SelectLod(lods_, distance, std::fabs(ubo_.proj[1][1]),
+                                              static_cast<float>(swapchain_extent_.height));
+    }
 
-        render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
-        render_pass_begin_info.pClearValues = clear_values.data();
+    if (current_lod_ == 0 && !meshlets_.empty()) {
+        // Meshlet bounds are in model space, so are the planes of proj * view * model and the
+        // camera position.
+        glm::mat4 model_view = ubo_.view * ubo_.model;
+        glm::mat4 model_view_proj = ubo_.proj * model_view;
+        float planes[6][4];
+        tiny_engine::ExtractFrustumPlanes(planes, &model_view_proj[0][0]);
+        glm::vec3 camera_position = glm::vec3(glm::inverse(model_view)[3]);
+
+        uint8_t *slice = static_cast<uint8_t *>(culled_index_buffer_memory_.mapped)
+                         + culled_index_slice_size_ * frame_index;
+        culled_index_counts_[frame_index] = static_cast<uint32_t>(tiny_engine::CullMeshlets(
+                slice, meshlets_, GetIndexData(),
+                index_type_ == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t),
+                planes, &camera_position.x));
+    }
+}
 
-        vkCmdBeginRenderPass(command_buffers_[i], &render_pass_begin_info,
-                             VK_SUBPASS_CONTENTS_INLINE);
+void ModelApplication::CreateModel() {
+    auto model_file = tiny_engine::Filesystem::GetInstance().Map(kModelFile);
+    // Caches baked with another vertex layout must not match, even if the stride is the same,
+    // nor caches split (or not) for 16-bit indices.
+    uint64_t layout_hash = tiny_engine::HashBytes(&vertex_layout_, sizeof(vertex_layout_));
+    layout_hash = tiny_engine::HashBytes(&split_for_16bit_indices_,
+                                         sizeof(split_for_16bit_indices_),
+                                         layout_hash);
+    uint64_t source_hash = tiny_engine::HashBytes(model_file.data(), model_file.size(),
+                                                  layout_hash);
+    mesh_cached_ = mesh_cache_.Load(kModelCacheFile, source_hash, vertex_layout_.stride);
+    if (mesh_cached_) {
+        sub_meshes_ = mesh_cache_.GetSubMeshes();
+        index_type_ = mesh_cache_.GetIndexType();
+        lods_ = mesh_cache_.GetLods();
+        meshlets_ = mesh_cache_.GetMeshlets();
+        SetBounds(mesh_cache_.GetBounds());
+        LOGI("Loaded %s from the mesh cache", kModelFile);
+        return;
+    }
 
-        vkCmdBindPipeline(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
+    tiny_engine::ObjModel model = tiny_engine::ParseObj(model_file.As<char>(), model_file.size());
 
-        VkBuffer vertex_buffers[] = {vertex_buffer_};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(command_buffers_[i], 0, 1, vertex_buffers, offsets);
-        vkCmdBindIndexBuffer(command_buffers_[i], index_buffer_, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipeline_layout_, 0, 1, &descriptor_sets_[i], 0, nullptr);
+    vertices_.resize(model.indices.size());
+    for (size_t i = 0; i < model.indices.size(); i++) {
+        const tiny_engine::ObjIndex &index = model.indices[i];
+        Vertex &vertex = vertices_[i];
 
+        vertex.pos = {
+                model.positions[3 * index.position + 0],
+                model.positions[3 * index.position + 1],
+                model.positions[3 * index.position + 2]
+        };
 
-        vkCmdDrawIndexed(command_buffers_[i], indices_.size(), 1, 0, 0, 0);
+        if (index.texcoord >= 0) {
+            vertex.tex_coord = {
+                    model.texcoords[2 * index.texcoord + 0],
+                    1.0f - model.texcoords[2 * index.texcoord + 1]
+            };
+        } else {
+            vertex.tex_coord = {0.0f, 0.0f};
+        }
 
-        vkCmdEndRenderPass(command_buffers_[i]);
+        vertex.color = {1.0f, 1.0f, 1.0f};
+    }
 
-        if (vkEndCommandBuffer(command_buffers_[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+    std::vector<uint32_t> indices = tiny_engine::WeldVertices(vertices_);
+    bool split = split_for_16bit_indices_ && vertices_.size() > UINT16_MAX + 1;
+    OptimizeModel(indices, !split);
+    if (split) {
+        sub_meshes_ = tiny_engine::SplitMesh(vertices_, indices);
+        lods_.clear();
+    } else {
+        lods_ = tiny_engine::GenerateLodChain(indices, &vertices_[0].pos.x, vertices_.size(),
+                                              sizeof(Vertex));
+        tiny_engine::SubMesh sub_mesh;
+        sub_mesh.index_count = lods_[0].index_count;
+        sub_meshes_ = {sub_mesh};
+        for (const auto &lod : lods_) {
+            LOGI("%s LOD: %u triangles, error %f", kModelFile, lod.index_count / 3, lod.error);
         }
     }
+    indices_.Assign(indices);
+    index_type_ = indices_.GetIndexType();
+
+    tiny_engine::MeshBounds bounds = tiny_engine::ComputeMeshBounds(vertices_.data(),
+                                                                   vertices_.size(),
+                                                                   sizeof(Vertex),
+                                                                   offsetof(Vertex, pos));
+    tiny_engine::PositionTransform transform = tiny_engine::ComputePositionTransform(
+            vertex_layout_, bounds.min, bounds.max);
+    vertex_data_.resize(vertices_.size() * vertex_layout_.stride);
+    tiny_engine::QuantizeVertices(vertex_data_.data(), vertex_layout_, transform,
+                                  vertices_.data(), vertices_.size(), sizeof(Vertex),
+                                  offsetof(Vertex, pos), offsetof(Vertex, color),
+                                  offsetof(Vertex, tex_coord));
+    SetBounds(bounds);
+
+    if (!tiny_engine::MeshCache::Save(kModelCacheFile, source_hash, vertex_data_.data(),
+                                      vertex_layout_.stride,
+                                      static_cast<uint32_t>(vertices_.size()),
+                                      indices_, sub_meshes_, lods_, meshlets_, bounds)) {
+        LOGW("failed to write the mesh cache for %s", kModelFile);
+    }
 }
 
-void ModelApplication::UpdateUniformBuffer(uint32_t current_image) {
-    void *data;
-    vkMapMemory(device_, uniform_buffers_memory_[current_image], 0, sizeof(ubo_), 0, &data);
-    memcpy(data, &ubo_, sizeof(ubo_));
-    vkUnmapMemory(device_, uniform_buffers_memory_[current_image]);
+void ModelApplication::SetBounds(const tiny_engine::MeshBounds &bounds) {
+    tiny_engine::PositionTransform transform = tiny_engine::ComputePositionTransform(
+            vertex_layout_, bounds.min, bounds.max);
+    dequantize_ = glm::scale(
+            glm::translate(glm::mat4(1.0f), glm::vec3(transform.offset[0], transform.offset[1],
+                                                      transform.offset[2])),
+            glm::vec3(transform.scale[0], transform.scale[1], transform.scale[2]));
+
+    glm::vec3 bounds_min(bounds.min[0], bounds.min[1], bounds.min[2]);
+    glm::vec3 bounds_max(bounds.max[0], bounds.max[1], bounds.max[2]);
+    bounds_center_ = 0.5f * (bounds_min + bounds_max);
+    bounds_radius_ = 0.5f * glm::length(bounds_max - bounds_min);
 }
 
-void ModelApplication::CreateModel() {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    std::string buffer;
-    tiny_engine::Filesystem::GetInstance().Read("models/viking_room.obj", buffer);
-
-    std::stringstream sstream(buffer);
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &sstream)) {
-        throw std::runtime_error(warn + err);
+void ModelApplication::OptimizeModel(std::vector<uint32_t> &indices, bool build_meshlets) {
+    tiny_engine::VertexCacheStatistics before = tiny_engine::AnalyzeVertexCache(indices.data(),
+                                                                              indices.size(),
+                                                                              vertices_.size());
+
+    std::vector<uint32_t> optimized(indices.size());
+    tiny_engine::OptimizeVertexCache(optimized.data(), indices.data(), indices.size(),
+                                     vertices_.size());
+    tiny_engine::OptimizeOverdraw(indices.data(), optimized.data(), optimized.size(),
+                                  &vertices_[0].pos.x, vertices_.size(), sizeof(Vertex));
+    if (build_meshlets) {
+        // Meshlets regroup the triangles into patches with tight normal cones, this replaces the
+        // overdraw order but keeps most of the vertex cache locality.
+        meshlets_ = tiny_engine::BuildMeshlets(indices.data(), indices.size(),
+                                               &vertices_[0].pos.x, vertices_.size(),
+                                               sizeof(Vertex));
+        LOGI("%s: %zu meshlets", kModelFile, meshlets_.size());
     }
+    tiny_engine::OptimizeVertexFetch(vertices_, indices);
 
-    std::unordered_map<Vertex, uint32_t> unique_vertices{};
-
-    for (const auto &shape : shapes) {
-        for (const auto &index : shape.mesh.indices) {
-            Vertex vertex{};
-
-            vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.tex_coord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.color = {1.0f, 1.0f, 1.0f};
-
-            if (unique_vertices.count(vertex) == 0) {
-                unique_vertices[vertex] = static_cast<uint32_t>(vertices_.size());
-                vertices_.push_back(vertex);
-            }
+    tiny_engine::VertexCacheStatistics after = tiny_engine::AnalyzeVertexCache(indices.data(),
+                                                                             indices.size(),
+                                                                             vertices_.size());
+    LOGI("%s vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", kModelFile, before.acmr,
+         after.acmr, before.atvr, after.atvr);
+}
 
-            indices_.push_back(unique_vertices[vertex]);
-        }
-    }
+const void *ModelApplication::GetIndexData() const {
+    return mesh_cached_ ? mesh_cache_.GetIndices() : indices_.GetData();
 }
\ No newline at end of file
@@ -2,59 +2,26 @@
 #define ANDROID_VULKAN_MODEL_APPLICATION_H
 
 #include <vulkan_application.h>
+#include <texture_loader.h>
+#include <mesh_indices.h>
+#include <mesh_cache.h>
+#include <vertex_format.h>
+#include <mesh_simplifier.h>
+#include <meshlet.h>
 
 #include <vulkan/vulkan_android.h>
+#include <memory>
 #include <vector>
 #define GLM_FORCE_RADIANS
 #define GLM_LANG_STL11_FORCED
 #include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
+// Vertex as imported, it is converted to vertex_layout_ before the upload.
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 color;
     glm::vec2 tex_coord;
-
-    static std::vector<VkVertexInputBindingDescription> GetBindingDescription() {
-        VkVertexInputBindingDescription binding_description{};
-        binding_description.binding = 0;
-        binding_description.stride = sizeof(Vertex);
-        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return {binding_description};
-    }
-
-    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() {
-        std::vector<VkVertexInputAttributeDescription> attribute_descriptions(3);
-        attribute_descriptions[0].binding = 0;
-        attribute_descriptions[0].location = 0;
-        attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[0].offset = offsetof(Vertex, pos);
-        attribute_descriptions[1].binding = 0;
-        attribute_descriptions[1].location = 1;
-        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[1].offset = offsetof(Vertex, color);
-        attribute_descriptions[2].binding = 0;
-        attribute_descriptions[2].location = 2;
-        attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attribute_descriptions[2].offset = offsetof(Vertex, tex_coord);
-        return attribute_descriptions;
-    }
-
-    bool operator==(const Vertex &other) const {
-        return pos == other.pos && color == other.color && tex_coord == other.tex_coord;
-    }
-};
-
-namespace std {
-template<>
-struct hash<Vertex> {
-    size_t operator()(Vertex const &vertex) const {
-        return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-               (hash<glm::vec2>()(vertex.tex_coord) << 1);
-    }
 };
-}
 
 struct UniformBufferObject {
     glm::mat4 model;
@@ -62,23 +29,29 @@ struct UniformBufferObject {
     glm::mat4 proj;
 };
 
+// CPU side of the streamed texture, filled by a decode worker and uploaded on the render thread.
+struct StreamedTexture : tiny_engine::TextureData {
+    // First level of the full chain wanted. levels starts there unless the chain is built on
+    // upload (from an RGBA8 level 0 or with generate_mipmaps), the upload then drops the levels
+    // above.
+    uint32_t first_level = 0;
+};
+
 class ModelApplication : public tiny_engine::VulkanApplication {
 public:
+    // split_for_16bit_indices draws meshes with more than 65536 vertices as several 16-bit
+    // indexed sub-meshes instead of one 32-bit indexed mesh, for GPUs which fetch 32-bit indices
+    // at a lower rate.
     ModelApplication(void *native_window,
                      std::vector<char> vert_shader_code,
-                     std::vector<char> frag_shader_code);
+                     std::vector<char> frag_shader_code,
+                     bool split_for_16bit_indices = false);
 
     virtual void Init() override;
 
-    virtual void Draw() override;
-
-    virtual void Cleanup() override;
-
     virtual void Rotate(float radius, float x, float y, float z);
 
 protected:
-    virtual void CreateDescriptorSetLayout() override;
-
     virtual void CreateTextureImage() override;
 
     virtual void CreateTextureImageView() override;
@@ -91,26 +64,108 @@ protected:
 
     virtual void CreateUniformBuffers() override;
 
-    virtual void CreateDescriptorPool() override;
-
     virtual void CreateDescriptorSets() override;
 
-    virtual void CreateCommandBuffers() override;
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) override;
+
+    virtual void UpdateFrame(uint32_t frame_index) override;
+
+    virtual void OnSwapchainRecreated() override;
+
+    virtual void DestroyResources() override;
 
 private:
-    void UpdateUniformBuffer(uint32_t current_image);
+    // Streams levels first_level and below of filename into texture_image_, falling back from
+    // KTX2 to the source image.
+    void RequestTexture(const char *filename, uint32_t first_level = 0);
+
+    // Drops texture from staged_textures_ once its request has uploaded or failed.
+    void ForgetStagedTexture(const std::shared_ptr<StreamedTexture> &texture);
+
+    void UploadStreamedTexture(const StreamedTexture &texture);
+
+    // Residency handlers of the streamed texture, see TextureResidencyHandlers.
+    void TrimTexture(uint32_t first_level);
+
+    void EvictTexture();
+
+    // Hands texture_image_ and its view to RetireResource, descriptor sets of frames in flight
+    // may still use them.
+    void RetireTexture();
+
+    // Points binding 1 of descriptor_set at the streamed texture, or the placeholder until then.
+    void UpdateTextureDescriptor(VkDescriptorSet descriptor_set);
+
+    void UpdateProjection();
 
     void CreateModel();
 
+    // Folds the dequantization of the stored positions into the model matrix and keeps the
+    // bounding sphere for LOD selection.
+    void SetBounds(const tiny_engine::MeshBounds &bounds);
+
+    // Reorders triangles for the post-transform cache and for overdraw (or into meshlets), then
+    // vertices for fetch.
+    void OptimizeModel(std::vector<uint32_t> &indices, bool build_meshlets);
+
+    const void *GetIndexData() const;
+
 private:
     std::vector<Vertex> vertices_;
-    std::vector<uint16_t> indices_;
-    size_t current_frame_ = 0;
-
-    VkImage texture_image_;
-    VkDeviceMemory texture_image_memory_;
-    VkImageView texture_image_view_;
+    // 16 bytes per vertex instead of 32: snorm16 position, unorm8 color and half float texture
+    // coordinates.
+    tiny_engine::VertexLayout vertex_layout_;
+    std::vector<uint8_t> vertex_data_;
+    glm::mat4 dequantize_ = glm::mat4(1.0f);
+    tiny_engine::MeshIndices indices_;
+    std::vector<tiny_engine::SubMesh> sub_meshes_;
+    VkIndexType index_type_ = VK_INDEX_TYPE_UINT16;
+    // Coarser levels share the vertex buffer and follow the full detail indices in the index
+    // buffer, level 0 is drawn through sub_meshes_. Empty if the mesh was split.
+    std::vector<tiny_engine::MeshLod> lods_;
+    size_t current_lod_ = 0;
+    glm::vec3 bounds_center_ = glm::vec3(0.0f);
+    float bounds_radius_ = 0.0f;
+    // Set when the model came from the baked cache, the vertex and index data are then read from
+    // its mapping (which stays alive for meshlet culling) and vertices_/indices_ stay empty.
+    tiny_engine::MeshCache mesh_cache_;
+    bool mesh_cached_ = false;
+    bool split_for_16bit_indices_ = false;
+
+    // Meshlets of the full detail level. While it is selected the visible meshlets are compacted
+    // into this frame's slice of culled_index_buffer_ every frame. Empty if the mesh was split.
+    std::vector<tiny_engine::Meshlet> meshlets_;
+    VkBuffer culled_index_buffer_ = VK_NULL_HANDLE;
+    tiny_engine::MemoryAllocation culled_index_buffer_memory_;
+    VkDeviceSize culled_index_slice_size_ = 0;
+    std::vector<uint32_t> culled_index_counts_;
+
+    // Bound until the streamed texture arrives, then kept until Cleanup as frames in flight may
+    // still sample it.
+    VkImage placeholder_image_ = VK_NULL_HANDLE;
+    tiny_engine::MemoryAllocation placeholder_image_memory_;
+    VkImageView placeholder_image_view_ = VK_NULL_HANDLE;
+    VkImage texture_image_ = VK_NULL_HANDLE;
+    tiny_engine::MemoryAllocation texture_image_memory_;
+    VkFormat texture_format_ = VK_FORMAT_R8G8B8A8_SRGB;
+    // Size and level count of the full chain, texture_image_ holds levels texture_first_level_
+    // and below of it.
+    uint32_t texture_width_ = 0;
+    uint32_t texture_height_ = 0;
+    uint32_t texture_mip_levels_ = 1;
+    uint32_t texture_first_level_ = 0;
+    VkImageView texture_image_view_ = VK_NULL_HANDLE;
+    // The file the texture was streamed from, restreams read it again. Null until the first
+    // upload, which also registers the texture with texture_residency_ as texture_residency_id_.
+    const char *texture_file_ = nullptr;
+    uint32_t texture_residency_id_ = 0;
     VkSampler texture_sampler_;
+    // Requests in flight which decode into staging memory, released by DestroyResources if the
+    // streamer stopped before they finished.
+    std::vector<std::shared_ptr<StreamedTexture>> staged_textures_;
+    // Frame slots whose descriptor set does not point at the current texture yet.
+    std::vector<bool> stale_texture_descriptors_;
 
     UniformBufferObject ubo_;
 };
@@ -7,11 +7,18 @@
 #include <filesystem.h>
 #include "model_application.h"
 
+namespace {
+
+const char *kAssetPackFile = "assets.pack";
+
+} // namespace
+
 std::shared_ptr<ModelApplication> application;
 
 extern "C"
 JNIEXPORT void JNICALL
-Java_com_ihuntto_android_1vulkan_model_MainActivity_init(JNIEnv *env, jobject thiz, jobject surface) {
+Java_com_ihuntto_android_1vulkan_model_MainActivity_init(JNIEnv *env, jobject thiz, jobject surface,
+                                                         jboolean split_for_16bit_indices) {
     if (application == nullptr) {
         auto vert_shader_code = tiny_engine::Filesystem::GetInstance().Read<char>(
                 "shaders/base.vert.spv");
@@ -20,7 +27,8 @@ Java_com_ihuntto_android_1vulkan_model_MainActivity_init(JNIEnv *env, jobject th
         ANativeWindow *native_window = ANativeWindow_fromSurface(env, surface);
         application = std::make_shared<ModelApplication>(native_window,
                                                         vert_shader_code,
-                                                        frag_shader_code);
+                                                        frag_shader_code,
+                                                        split_for_16bit_indices);
         application->Init();
     }
 }
@@ -41,6 +49,13 @@ Java_com_ihuntto_android_1vulkan_model_MainActivity_setAssetManager(JNIEnv *env,
                                                                 jstring data_path) {
     AAssetManager *asset_manager = AAssetManager_fromJava(env, asset_manager_obj);
     tiny_engine::Filesystem::GetInstance().Init(asset_manager);
+    // Assets baked into a pack are served from its mapping, loose assets remain the fallback.
+    if (tiny_engine::Filesystem::GetInstance().Exists(kAssetPackFile)) {
+        tiny_engine::Filesystem::GetInstance().Mount(kAssetPackFile);
+    }
+    const char *path = env->GetStringUTFChars(data_path, nullptr);
+    tiny_engine::Filesystem::GetInstance().SetDataPath(path);
+    env->ReleaseStringUTFChars(data_path, path);
 }
 
 extern "C"
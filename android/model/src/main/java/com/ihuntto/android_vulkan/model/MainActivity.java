@@ -17,6 +17,11 @@ public class MainActivity extends AppCompatActivity {
 
     private static final String TAG = MainActivity.class.getSimpleName();
 
+    // Boolean intent extra, draws large meshes as 16-bit indexed sub-meshes, e.g.
+    // adb shell am start --ez split_16bit_indices true \
+    //     -n com.ihuntto.android_vulkan.model/.MainActivity
+    private static final String EXTRA_SPLIT_16BIT_INDICES = "split_16bit_indices";
+
     // Used to load the 'native-lib' library on application startup.
     static {
         System.loadLibrary("native-lib");
@@ -68,7 +73,8 @@ public class MainActivity extends AppCompatActivity {
         @Override
         public void surfaceCreated(SurfaceHolder holder) {
             Log.d(TAG, "surfaceCreated");
-            init(holder.getSurface());
+            init(holder.getSurface(),
+                    getIntent().getBooleanExtra(EXTRA_SPLIT_16BIT_INDICES, false));
             draw();
         }
 
@@ -84,7 +90,7 @@ public class MainActivity extends AppCompatActivity {
         }
     };
 
-    private native void init(@NonNull Surface surface);
+    private native void init(@NonNull Surface surface, boolean splitFor16BitIndices);
 
     private native void cleanup();
 
@@ -2,6 +2,7 @@
 #define ANDROID_VULKAN_TEXTURE_APPLICATION_H
 
 #include <vulkan_application.h>
+#include <texture_loader.h>
 
 #include <vulkan/vulkan_android.h>
 #include <vector>
@@ -22,23 +23,6 @@ struct Vertex {
         return {binding_description};
     }
 
-    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() {
-        std::vector<VkVertexInputAttributeDescription> attribute_descriptions(3);
-        attribute_descriptions[0].binding = 0;
-        attribute_descriptions[0].location = 0;
-        attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[0].offset = offsetof(Vertex, pos);
-        attribute_descriptions[1].binding = 0;
-        attribute_descriptions[1].location = 1;
-        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[1].offset = offsetof(Vertex, color);
-        attribute_descriptions[2].binding = 0;
-        attribute_descriptions[2].location = 2;
-        attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attribute_descriptions[2].offset = offsetof(Vertex, tex_coord);
-        return attribute_descriptions;
-    }
-
     bool operator==(const Vertex &other) const {
         return pos == other.pos && color == other.color && tex_coord == other.tex_coord;
     }
@@ -56,13 +40,7 @@ public:
                        std::vector<char> vert_shader_code,
                        std::vector<char> frag_shader_code);
 
-    virtual void Draw() override;
-
-    virtual void Cleanup() override;
-
 protected:
-    virtual void CreateDescriptorSetLayout() override;
-
     virtual void CreateTextureImage() override;
 
     virtual void CreateTextureImageView() override;
@@ -75,11 +53,20 @@ protected:
 
     virtual void CreateUniformBuffers() override;
 
-    virtual void CreateDescriptorPool() override;
-
     virtual void CreateDescriptorSets() override;
 
-    virtual void CreateCommandBuffers() override;
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) override;
+
+    virtual void OnDeviceCreated() override;
+
+    virtual void OnSwapchainRecreated() override;
+
+    virtual void DestroyResources() override;
+
+private:
+    // Writes the projection for the current swapchain extent into every uniform slot.
+    void UpdateUniformBuffers();
 
 private:
     std::vector<Vertex> vertices_ = {
@@ -89,10 +76,12 @@ private:
             {{-1.0f, 1.0f,  0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f}},
     };
     std::vector<uint16_t> indices_ = {0, 1, 2, 2, 3, 0};
-    size_t current_frame_ = 0;
 
     VkImage texture_image_;
-    VkDeviceMemory texture_image_memory_;
+    tiny_engine::MemoryAllocation texture_image_memory_;
+    VkFormat texture_format_ = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t texture_mip_levels_ = 1;
+    tiny_engine::TextureSource texture_source_;
     VkImageView texture_image_view_;
     VkSampler texture_sampler_;
 };
@@ -7,6 +7,12 @@
 #include <filesystem.h>
 #include "touch_pointer_application.h"
 
+namespace {
+
+const char *kAssetPackFile = "assets.pack";
+
+} // namespace
+
 std::shared_ptr<TouchPointerApplication> application;
 
 extern "C"
@@ -41,6 +47,13 @@ Java_com_ihuntto_android_1vulkan_touch_1pointer_MainActivity_setAssetManager(JNI
                                                            jstring data_path) {
     AAssetManager *asset_manager = AAssetManager_fromJava(env, asset_manager_obj);
     tiny_engine::Filesystem::GetInstance().Init(asset_manager);
+    // Assets baked into a pack are served from its mapping, loose assets remain the fallback.
+    if (tiny_engine::Filesystem::GetInstance().Exists(kAssetPackFile)) {
+        tiny_engine::Filesystem::GetInstance().Mount(kAssetPackFile);
+    }
+    const char *path = env->GetStringUTFChars(data_path, nullptr);
+    tiny_engine::Filesystem::GetInstance().SetDataPath(path);
+    env->ReleaseStringUTFChars(data_path, path);
 }
 
 extern "C"
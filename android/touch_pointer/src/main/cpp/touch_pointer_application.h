@@ -24,23 +24,6 @@ struct Vertex {
         return {binding_description};
     }
 
-    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() {
-        std::vector<VkVertexInputAttributeDescription> attribute_descriptions(3);
-        attribute_descriptions[0].binding = 0;
-        attribute_descriptions[0].location = 0;
-        attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[0].offset = offsetof(Vertex, pos);
-        attribute_descriptions[1].binding = 0;
-        attribute_descriptions[1].location = 1;
-        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[1].offset = offsetof(Vertex, color);
-        attribute_descriptions[2].binding = 0;
-        attribute_descriptions[2].location = 2;
-        attribute_descriptions[2].format = VK_FORMAT_R32_SFLOAT;
-        attribute_descriptions[2].offset = offsetof(Vertex, size);
-        return attribute_descriptions;
-    }
-
     bool operator==(const Vertex &other) const {
         return pos == other.pos && color == other.color && size == other.size;
     }
@@ -64,28 +47,28 @@ public:
                             std::vector<char> vert_shader_code,
                             std::vector<char> frag_shader_code);
 
-    virtual void Draw() override;
-
     void UpdatePointer(int index, float x, float y, float size, Action action);
 
 protected:
-    virtual void CreateDescriptorSetLayout() override;
-
     virtual void CreateVertexBuffer() override;
 
     virtual void CreateUniformBuffers() override;
 
-    virtual void CreateDescriptorPool() override;
-
     virtual void CreateDescriptorSets() override;
 
-    virtual void CreateCommandBuffers() override;
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) override;
+
+    virtual void UpdateFrame(uint32_t frame_index) override;
 
-    void Update(uint32_t current_image);
+    virtual void OnSwapchainRecreated() override;
+
+private:
+    // Writes the projection for the current swapchain extent into every uniform slot.
+    void UpdateUniformBuffers();
 
 private:
     UniformBufferObject ubo_;
-    size_t current_frame_ = 0;
     std::array<Vertex, 20> vertices_;
 };
 
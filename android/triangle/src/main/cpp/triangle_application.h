@@ -21,19 +21,6 @@ struct Vertex {
         return {binding_description};
     }
 
-    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() {
-        std::vector<VkVertexInputAttributeDescription> attribute_descriptions(2);
-        attribute_descriptions[0].binding = 0;
-        attribute_descriptions[0].location = 0;
-        attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[0].offset = offsetof(Vertex, pos);
-        attribute_descriptions[1].binding = 0;
-        attribute_descriptions[1].location = 1;
-        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[1].offset = offsetof(Vertex, color);
-        return attribute_descriptions;
-    }
-
     bool operator==(const Vertex &other) const {
         return pos == other.pos && color == other.color;
     }
@@ -51,22 +38,23 @@ public:
                         std::vector<char> vert_shader_code,
                         std::vector<char> frag_shader_code);
 
-    virtual void Draw() override;
-
 protected:
-    virtual void CreateDescriptorSetLayout() override;
-
     virtual void CreateVertexBuffer() override;
 
     virtual void CreateIndexBuffer() override;
 
     virtual void CreateUniformBuffers() override;
 
-    virtual void CreateDescriptorPool() override;
-
     virtual void CreateDescriptorSets() override;
 
-    virtual void CreateCommandBuffers() override;
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) override;
+
+    virtual void OnSwapchainRecreated() override;
+
+private:
+    // Writes the projection for the current swapchain extent into every uniform slot.
+    void UpdateUniformBuffers();
 
 private:
     std::vector<Vertex> vertices_ = {
@@ -75,7 +63,6 @@ private:
             {{0.0f,  0.5f,  0.0f}, {0.0f, 0.0f, 1.0f}},
     };
     std::vector<uint16_t> indices_ = {0, 1, 2};
-    size_t current_frame_ = 0;
 };
 
 
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <asset_pack.h>
+#include <filesystem.h>
+
+namespace {
+
+bool EndsWith(const std::string &value, const std::string &suffix) {
+    return value.size() >= suffix.size()
+           && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Appends the files below directory as names relative to root, sorted so that the files of a
+// directory end up next to each other in the pack. Packs themselves are left out.
+bool ListFiles(const std::string &root, const std::string &directory,
+               std::vector<std::string> &names) {
+    DIR *dir = opendir((root + directory).c_str());
+    if (dir == nullptr) {
+        fprintf(stderr, "failed to open directory %s\n", (root + directory).c_str());
+        return false;
+    }
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            entries.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end());
+
+    for (const std::string &entry : entries) {
+        std::string name = directory.empty() ? entry : directory + "/" + entry;
+        struct stat info;
+        if (stat((root + name).c_str(), &info) != 0) {
+            fprintf(stderr, "failed to stat %s\n", (root + name).c_str());
+            return false;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            if (!ListFiles(root, name, names)) {
+                return false;
+            }
+        } else if (S_ISREG(info.st_mode) && !EndsWith(name, ".pack")) {
+            names.push_back(name);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// Usage: asset_packer <output pack> <asset directory>...
+// Packs every file below the asset directories (e.g. src/main/assets and the compiled shaders)
+// under its path relative to its directory, as the Filesystem names assets, then reads the pack
+// back and checks every asset against its file. A name in a later directory replaces the same
+// name in an earlier one.
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <output pack> <asset directory>...\n", argv[0]);
+        return 2;
+    }
+    std::string output = argv[1];
+
+    try {
+        tiny_engine::Filesystem &filesystem = tiny_engine::Filesystem::GetInstance();
+        filesystem.Init(nullptr);
+
+        std::vector<std::string> names;
+        std::vector<std::string> paths;
+        for (int i = 2; i < argc; i++) {
+            std::string root = argv[i];
+            if (!root.empty() && root.back() != '/') {
+                root += '/';
+            }
+            std::vector<std::string> directory_names;
+            if (!ListFiles(root, "", directory_names)) {
+                return 1;
+            }
+            for (const std::string &name : directory_names) {
+                auto it = std::find(names.begin(), names.end(), name);
+                if (it != names.end()) {
+                    paths[it - names.begin()] = root + name;
+                } else {
+                    names.push_back(name);
+                    paths.push_back(root + name);
+                }
+            }
+        }
+
+        tiny_engine::AssetPackWriter writer;
+        size_t total_size = 0;
+        for (size_t i = 0; i < names.size(); i++) {
+            tiny_engine::FileView file = filesystem.Map(paths[i]);
+            writer.Add(names[i], file.data(), file.size());
+            total_size += file.size();
+        }
+        if (!writer.Write(output)) {
+            fprintf(stderr, "failed to write %s\n", output.c_str());
+            return 1;
+        }
+
+        tiny_engine::AssetPack pack;
+        tiny_engine::FileView pack_file = filesystem.Map(output);
+        if (!pack.Load(pack_file) || pack.GetEntryCount() != names.size()) {
+            fprintf(stderr, "failed to read back %s\n", output.c_str());
+            return 1;
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            tiny_engine::FileView file = filesystem.Map(paths[i]);
+            tiny_engine::FileView packed;
+            if (!pack.Map(names[i], packed) || packed.size() != file.size()
+                || (file.size() != 0 && memcmp(packed.data(), file.data(), file.size()) != 0)) {
+                fprintf(stderr, "%s differs in %s\n", names[i].c_str(), output.c_str());
+                return 1;
+            }
+        }
+        printf("%s: %zu assets, %zu bytes packed into %zu\n", output.c_str(), names.size(),
+               total_size, pack_file.size());
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
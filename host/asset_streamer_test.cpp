@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asset_streamer.h>
+#include <filesystem.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
+
+const uint32_t kFileCount = 10;
+const size_t kFileSize = 5000;
+// Two files per frame.
+const size_t kFrameBudget = 12 * 1024;
+
+std::string GetFilename(uint32_t index) {
+    return "asset_streamer_test_" + std::to_string(index) + ".bin";
+}
+
+bool WriteFiles(const std::string &directory) {
+    std::vector<char> content(kFileSize);
+    for (uint32_t i = 0; i < kFileCount; i++) {
+        std::fill(content.begin(), content.end(), static_cast<char>(i));
+        std::string path = directory + "/" + GetFilename(i);
+        FILE *file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "failed to write %s\n", path.c_str());
+            return false;
+        }
+        size_t written = fwrite(content.data(), 1, content.size(), file);
+        fclose(file);
+        if (written != content.size()) {
+            fprintf(stderr, "failed to write %s\n", path.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Waits up to a few seconds for condition, which the streamer threads make true.
+template<typename Condition>
+bool WaitFor(Condition condition) {
+    for (int i = 0; i < 5000 && !condition(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+}
+
+// The files at three priorities: uploads arrive highest priority first, then in request order,
+// as many per frame as the budget allows.
+void TestOrder() {
+    tiny_engine::AssetStreamer streamer(1, 3);
+    std::atomic<uint32_t> decoded(0);
+    std::vector<uint32_t> uploads;
+    for (uint32_t i = 0; i < kFileCount; i++) {
+        tiny_engine::StreamRequest request;
+        request.filename = GetFilename(i);
+        request.priority = static_cast<int>(i % 3);
+        request.decode = [&decoded, i](const tiny_engine::FileView &file) {
+            if (file.size() != kFileSize || file.data()[0] != i) {
+                throw std::runtime_error("wrong file content!");
+            }
+            decoded++;
+            return file.size();
+        };
+        request.upload = [&uploads, i]() { uploads.push_back(i); };
+        request.fail = [i](const std::string &error) {
+            failures++;
+            fprintf(stderr, "%s failed: %s\n", GetFilename(i).c_str(), error.c_str());
+        };
+        streamer.Request(std::move(request));
+    }
+    CHECK(WaitFor([&decoded]() { return decoded == kFileCount; }), "%u", decoded.load());
+    // The last decode queues its upload right after returning.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<size_t> frame_uploads;
+    while (streamer.HasUploads() && frame_uploads.size() < kFileCount) {
+        size_t before = uploads.size();
+        size_t uploaded = streamer.Update(kFrameBudget);
+        frame_uploads.push_back(uploads.size() - before);
+        CHECK(uploaded == (uploads.size() - before) * kFileSize, "%zu", uploaded);
+    }
+    CHECK(streamer.IsIdle(), "uploads left");
+
+    std::vector<uint32_t> expected;
+    for (int priority = 2; priority >= 0; priority--) {
+        for (uint32_t i = 0; i < kFileCount; i++) {
+            if (static_cast<int>(i % 3) == priority) {
+                expected.push_back(i);
+            }
+        }
+    }
+    CHECK(uploads == expected, "%zu uploads out of order", uploads.size());
+    for (size_t count : frame_uploads) {
+        CHECK(count >= 1 && count <= 2, "%zu uploads in a frame", count);
+    }
+}
+
+// A file which cannot be mapped and a decode which throws both end up in fail.
+void TestFail() {
+    tiny_engine::AssetStreamer streamer(1, 3);
+    std::vector<std::string> errors;
+    int upload_count = 0;
+    auto add_request = [&](const std::string &filename,
+                           const std::function<size_t(const tiny_engine::FileView &)> &decode) {
+        tiny_engine::StreamRequest request;
+        request.filename = filename;
+        request.decode = decode;
+        request.upload = [&upload_count]() { upload_count++; };
+        request.fail = [&errors](const std::string &error) { errors.push_back(error); };
+        streamer.Request(std::move(request));
+    };
+    add_request("asset_streamer_test_missing.bin",
+                [](const tiny_engine::FileView &file) { return file.size(); });
+    add_request(GetFilename(0), [](const tiny_engine::FileView &) -> size_t {
+        throw std::runtime_error("failed to decode!");
+    });
+
+    CHECK(WaitFor([&]() {
+        streamer.Update(kFrameBudget);
+        return errors.size() == 2;
+    }), "%zu errors", errors.size());
+    CHECK(upload_count == 0, "%d", upload_count);
+    CHECK(std::find(errors.begin(), errors.end(), "failed to decode!") != errors.end(),
+          "decode error missing");
+    CHECK(streamer.IsIdle(), "requests left");
+}
+
+// Stop drops what has not been decoded yet and leaves nothing to upload.
+void TestStop() {
+    tiny_engine::AssetStreamer streamer(1, 1);
+    std::atomic<uint32_t> decoded(0);
+    int upload_count = 0;
+    const uint32_t request_count = 100;
+    for (uint32_t i = 0; i < request_count; i++) {
+        tiny_engine::StreamRequest request;
+        request.filename = GetFilename(i % kFileCount);
+        request.decode = [&decoded](const tiny_engine::FileView &file) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            decoded++;
+            return file.size();
+        };
+        request.upload = [&upload_count]() { upload_count++; };
+        streamer.Request(std::move(request));
+    }
+    streamer.Stop();
+    CHECK(streamer.IsIdle(), "requests left");
+    CHECK(decoded < request_count, "%u", decoded.load());
+    CHECK(streamer.Update(kFrameBudget) == 0 && upload_count == 0, "%d", upload_count);
+}
+
+} // namespace
+
+// Usage: asset_streamer_test <scratch directory>
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <scratch directory>\n", argv[0]);
+        return 2;
+    }
+    try {
+        if (!WriteFiles(argv[1])) {
+            return 1;
+        }
+        tiny_engine::Filesystem::GetInstance().Init(argv[1]);
+        TestOrder();
+        TestFail();
+        TestStop();
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("asset_streamer_test passed\n");
+    return 0;
+}
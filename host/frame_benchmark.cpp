@@ -0,0 +1,57 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include <filesystem.h>
+#include "headless_application.h"
+
+namespace {
+
+const int kWarmupFrames = 30;
+
+} // namespace
+
+// Usage: frame_benchmark <asset directory> [frames] [width] [height]
+// Times frames Draw calls of the headless application after a warm-up and prints the frame rate,
+// e.g. to compare frame pacing changes on lavapipe.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <asset directory> [frames] [width] [height]\n", argv[0]);
+        return 2;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 1000;
+    uint32_t width = argc > 3 ? (uint32_t) atoi(argv[3]) : 1280;
+    uint32_t height = argc > 4 ? (uint32_t) atoi(argv[4]) : 720;
+
+    try {
+        tiny_engine::Filesystem &filesystem = tiny_engine::Filesystem::GetInstance();
+        filesystem.Init(argv[1]);
+        HeadlessApplication application(filesystem.Read<char>("shaders/base.vert.spv"),
+                                        filesystem.Read<char>("shaders/base.frag.spv"),
+                                        width,
+                                        height);
+        application.Init();
+        for (int i = 0; i < kWarmupFrames; i++) {
+            application.Draw();
+        }
+
+        uint64_t first_frame = application.GetFrameCount();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            application.Draw();
+        }
+        auto end = std::chrono::steady_clock::now();
+        uint64_t drawn = application.GetFrameCount() - first_frame;
+        application.Cleanup();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        printf("%llu frames at %ux%u in %.3f s: %.1f fps, %.3f ms/frame\n",
+               (unsigned long long) drawn, width, height, seconds,
+               drawn / seconds, seconds * 1000.0 / (drawn > 0 ? drawn : 1));
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
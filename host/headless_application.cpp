@@ -0,0 +1,126 @@
+#include "headless_application.h"
+
+#include <array>
+#include <cstring>
+
+namespace {
+
+void SetIdentity(float *matrix) {
+    memset(matrix, 0, 16 * sizeof(float));
+    matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1.0f;
+}
+
+} // namespace
+
+HeadlessApplication::HeadlessApplication(std::vector<char> vert_shader_code,
+                                         std::vector<char> frag_shader_code,
+                                         uint32_t width,
+                                         uint32_t height) {
+    extensions_ = {
+            VK_KHR_SURFACE_EXTENSION_NAME,
+            VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
+    };
+    application_name_ = "Headless";
+    window_extent_ = {width, height};
+    vert_shader_code_ = vert_shader_code;
+    frag_shader_code_ = frag_shader_code;
+    max_frames_in_flight_ = 2;
+}
+
+void HeadlessApplication::CreateDeviceBuffer(const void *data,
+                                             VkDeviceSize size,
+                                             VkBufferUsageFlags usage,
+                                             VkBuffer &buffer,
+                                             tiny_engine::MemoryAllocation &buffer_memory) {
+    VkBuffer staging_buffer;
+    tiny_engine::MemoryAllocation staging_buffer_memory;
+    CreateBuffer(physical_device_,
+                 device_,
+                 size,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 staging_buffer,
+                 staging_buffer_memory);
+
+    memcpy(staging_buffer_memory.mapped, data, (size_t) size);
+
+    CreateBuffer(physical_device_,
+                 device_,
+                 size,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 buffer,
+                 buffer_memory);
+
+    CopyBuffer(device_, command_pool_, graphics_queue_, staging_buffer, buffer, size);
+
+    ReleaseStagingBuffer(device_, staging_buffer, staging_buffer_memory);
+}
+
+void HeadlessApplication::CreateVertexBuffer() {
+    CreateDeviceBuffer(vertices_.data(),
+                       sizeof(vertices_[0]) * vertices_.size(),
+                       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                       vertex_buffer_,
+                       vertex_buffer_memory_);
+}
+
+void HeadlessApplication::CreateIndexBuffer() {
+    CreateDeviceBuffer(indices_.data(),
+                       sizeof(indices_[0]) * indices_.size(),
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                       index_buffer_,
+                       index_buffer_memory_);
+}
+
+void HeadlessApplication::CreateUniformBuffers() {
+    CreateUniformRingBuffer(sizeof(UniformBufferObject), max_frames_in_flight_);
+
+    UniformBufferObject ubo{};
+    SetIdentity(ubo.model);
+    SetIdentity(ubo.view);
+    SetIdentity(ubo.proj);
+    ubo.proj[5] = -1.0f;
+    for (uint32_t i = 0; i < max_frames_in_flight_; i++) {
+        memcpy(GetUniformSlot(i), &ubo, sizeof(ubo));
+    }
+}
+
+void HeadlessApplication::CreateDescriptorSets() {
+    VulkanApplication::CreateDescriptorSets();
+
+    for (size_t i = 0; i < max_frames_in_flight_; i++) {
+        VkDescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = uniform_buffer_;
+        buffer_info.offset = 0;
+        buffer_info.range = sizeof(UniformBufferObject);
+
+        std::array<VkWriteDescriptorSet, 1> descriptor_writes{};
+
+        descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[0].dstSet = descriptor_sets_[i];
+        descriptor_writes[0].dstBinding = 0;
+        descriptor_writes[0].dstArrayElement = 0;
+        descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptor_writes[0].descriptorCount = 1;
+        descriptor_writes[0].pBufferInfo = &buffer_info;
+
+        vkUpdateDescriptorSets(device_, static_cast<uint32_t>(descriptor_writes.size()),
+                               descriptor_writes.data(), 0, nullptr);
+    }
+}
+
+void HeadlessApplication::RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                              uint32_t image_index) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
+
+    VkBuffer vertex_buffers[] = {vertex_buffer_};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer_, 0, VK_INDEX_TYPE_UINT16);
+    uint32_t dynamic_offset = GetUniformOffset(current_frame_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_,
+                            0, 1, &descriptor_sets_[current_frame_], 1, &dynamic_offset);
+
+    vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(indices_.size()), 1, 0, 0, 0);
+}
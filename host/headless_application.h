@@ -0,0 +1,60 @@
+#ifndef TINY_ENGINE_HEADLESS_APPLICATION_H
+#define TINY_ENGINE_HEADLESS_APPLICATION_H
+
+#include <vulkan_application.h>
+
+#include <cstdint>
+#include <vector>
+
+// The triangle sample on a VK_EXT_headless_surface swapchain, for running the engine without a
+// window system, e.g. on lavapipe on a CI machine.
+class HeadlessApplication : public tiny_engine::VulkanApplication {
+public:
+    HeadlessApplication(std::vector<char> vert_shader_code,
+                        std::vector<char> frag_shader_code,
+                        uint32_t width = 1280,
+                        uint32_t height = 720);
+
+    uint64_t GetFrameCount() const { return frame_count_; }
+
+protected:
+    virtual void CreateVertexBuffer() override;
+
+    virtual void CreateIndexBuffer() override;
+
+    virtual void CreateUniformBuffers() override;
+
+    virtual void CreateDescriptorSets() override;
+
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) override;
+
+private:
+    struct Vertex {
+        float pos[3];
+        float color[3];
+    };
+
+    struct UniformBufferObject {
+        float model[16];
+        float view[16];
+        float proj[16];
+    };
+
+    // Uploads size bytes of data into a new device local buffer with usage.
+    void CreateDeviceBuffer(const void *data,
+                            VkDeviceSize size,
+                            VkBufferUsageFlags usage,
+                            VkBuffer &buffer,
+                            tiny_engine::MemoryAllocation &buffer_memory);
+
+private:
+    std::vector<Vertex> vertices_ = {
+            {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f,  -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+            {{0.0f,  0.5f,  0.0f}, {0.0f, 0.0f, 1.0f}},
+    };
+    std::vector<uint16_t> indices_ = {0, 1, 2};
+};
+
+#endif //TINY_ENGINE_HEADLESS_APPLICATION_H
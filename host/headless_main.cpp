@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include <filesystem.h>
+#include "headless_application.h"
+
+// Usage: tiny_engine_headless <asset directory> [frames]
+// Runs Init, frames Draw calls and Cleanup, the asset directory holds shaders/base.*.spv.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <asset directory> [frames]\n", argv[0]);
+        return 2;
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : 60;
+
+    try {
+        tiny_engine::Filesystem &filesystem = tiny_engine::Filesystem::GetInstance();
+        filesystem.Init(argv[1]);
+        HeadlessApplication application(filesystem.Read<char>("shaders/base.vert.spv"),
+                                        filesystem.Read<char>("shaders/base.frag.spv"));
+        application.Init();
+        for (int i = 0; i < frames; i++) {
+            application.Draw();
+        }
+        application.Cleanup();
+        printf("presented %llu frames\n", (unsigned long long) application.GetFrameCount());
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
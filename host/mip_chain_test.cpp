@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <mip_chain.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
+
+const uint32_t kSizes[][2] = {
+        {1, 1}, {1, 2}, {2, 1}, {1, 7}, {9, 1}, {1, 64}, {2, 2}, {3, 3}, {5, 3}, {3, 5},
+        {4, 4}, {7, 2}, {16, 16}, {17, 9}, {31, 33}, {64, 1}, {100, 75}, {127, 128}
+};
+
+// DownsampleRgba16 as the plain loop its NEON and SSE2 paths have to match.
+void DownsampleRgba16Scalar(uint16_t *destination,
+                            const uint16_t *source,
+                            uint32_t width,
+                            uint32_t height) {
+    uint32_t destination_width = std::max(width / 2, 1u);
+    uint32_t destination_height = std::max(height / 2, 1u);
+    for (uint32_t y = 0; y < destination_height; y++) {
+        uint32_t y0 = std::min(y * 2, height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < destination_width; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = source[(y0 * width + x0) * 4 + c]
+                               + source[(y0 * width + x1) * 4 + c]
+                               + source[(y1 * width + x0) * 4 + c]
+                               + source[(y1 * width + x1) * 4 + c];
+                destination[(y * destination_width + x) * 4 + c] = (sum + 2) >> 2;
+            }
+        }
+    }
+}
+
+double DecodeSrgb(double c) {
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+double EncodeSrgb(double linear) {
+    return linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+// GenerateMipChain in double precision: each level is the 2x2 box filter of the exact level
+// above, with the same handling of odd and 1 pixel dimensions.
+std::vector<uint8_t> GenerateMipChainReference(const std::vector<uint8_t> &pixels,
+                                               uint32_t width,
+                                               uint32_t height,
+                                               uint32_t mip_levels,
+                                               bool srgb) {
+    std::vector<tiny_engine::MipLevel> levels = tiny_engine::GetMipChainLayout(width,
+                                                                                height,
+                                                                                mip_levels,
+                                                                                4);
+    std::vector<uint8_t> chain(tiny_engine::GetMipChainSize(width, height, mip_levels, 4));
+    std::copy(pixels.begin(), pixels.end(), chain.begin());
+    std::vector<double> current(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+        double c = pixels[i] / 255.0;
+        current[i] = srgb && i % 4 != 3 ? DecodeSrgb(c) : c;
+    }
+    for (uint32_t level = 1; level < mip_levels; level++) {
+        uint32_t source_width = levels[level - 1].width;
+        uint32_t source_height = levels[level - 1].height;
+        std::vector<double> next(static_cast<size_t>(levels[level].width)
+                                 * levels[level].height * 4);
+        for (uint32_t y = 0; y < levels[level].height; y++) {
+            uint32_t y0 = std::min(y * 2, source_height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, source_height - 1);
+            for (uint32_t x = 0; x < levels[level].width; x++) {
+                uint32_t x0 = std::min(x * 2, source_width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, source_width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    double value = (current[(y0 * source_width + x0) * 4 + c]
+                                    + current[(y0 * source_width + x1) * 4 + c]
+                                    + current[(y1 * source_width + x0) * 4 + c]
+                                    + current[(y1 * source_width + x1) * 4 + c]) / 4.0;
+                    size_t index = (y * levels[level].width + x) * 4 + c;
+                    next[index] = value;
+                    double encoded = srgb && c != 3 ? EncodeSrgb(value) : value;
+                    chain[levels[level].offset + index] =
+                            static_cast<uint8_t>(std::lround(encoded * 255.0));
+                }
+            }
+        }
+        current.swap(next);
+    }
+    return chain;
+}
+
+std::vector<uint8_t> RandomPixels(std::mt19937 &random, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (uint8_t &value : pixels) {
+        value = static_cast<uint8_t>(random());
+    }
+    return pixels;
+}
+
+void TestDownsampleMatchesScalar() {
+    std::mt19937 random(1);
+    for (const uint32_t *size : kSizes) {
+        uint32_t width = size[0];
+        uint32_t height = size[1];
+        std::vector<uint16_t> source(static_cast<size_t>(width) * height * 4);
+        for (int pattern = 0; pattern < 3; pattern++) {
+            // Random values, all maximum (the SSE2 pack bias) and all zero.
+            for (uint16_t &value : source) {
+                value = pattern == 0 ? static_cast<uint16_t>(random())
+                                     : pattern == 1 ? 65535 : 0;
+            }
+            size_t destination_size = static_cast<size_t>(std::max(width / 2, 1u))
+                                      * std::max(height / 2, 1u) * 4;
+            std::vector<uint16_t> expected(destination_size);
+            std::vector<uint16_t> actual(destination_size);
+            DownsampleRgba16Scalar(expected.data(), source.data(), width, height);
+            tiny_engine::DownsampleRgba16(actual.data(), source.data(), width, height);
+            CHECK(actual == expected, "%ux%u pattern %d", width, height, pattern);
+        }
+    }
+}
+
+void TestLayout() {
+    CHECK(tiny_engine::GetMipLevelCount(1, 1) == 1, "1x1");
+    CHECK(tiny_engine::GetMipLevelCount(1, 64) == 7, "1x64");
+    CHECK(tiny_engine::GetMipLevelCount(100, 75) == 7, "100x75");
+    std::vector<tiny_engine::MipLevel> levels = tiny_engine::GetMipChainLayout(5, 3, 3, 4);
+    CHECK(levels[1].offset == 60 && levels[1].width == 2 && levels[1].height == 1, "5x3 level 1");
+    CHECK(levels[2].offset == 68 && levels[2].width == 1 && levels[2].height == 1, "5x3 level 2");
+    CHECK(tiny_engine::GetMipChainSize(5, 3, 3, 4) == 72, "5x3 size");
+}
+
+void TestGenerateMatchesReference() {
+    std::mt19937 random(2);
+    for (const uint32_t *size : kSizes) {
+        uint32_t width = size[0];
+        uint32_t height = size[1];
+        uint32_t mip_levels = tiny_engine::GetMipLevelCount(width, height);
+        std::vector<uint8_t> pixels = RandomPixels(random, width, height);
+        for (bool srgb : {false, true}) {
+            std::vector<uint8_t> expected = GenerateMipChainReference(pixels,
+                                                                      width,
+                                                                      height,
+                                                                      mip_levels,
+                                                                      srgb);
+            std::vector<uint8_t> actual(expected.size());
+            tiny_engine::GenerateMipChain(actual.data(),
+                                          pixels.data(),
+                                          width,
+                                          height,
+                                          mip_levels,
+                                          srgb);
+            int max_error = 0;
+            for (size_t i = 0; i < expected.size(); i++) {
+                max_error = std::max(max_error, std::abs(actual[i] - expected[i]));
+            }
+            CHECK(max_error <= 1, "%ux%u srgb %d: off by %d", width, height, srgb, max_error);
+
+            // In place, with level 0 already at the start of the chain.
+            std::vector<uint8_t> in_place(expected.size());
+            std::copy(pixels.begin(), pixels.end(), in_place.begin());
+            tiny_engine::GenerateMipChain(in_place.data(),
+                                          in_place.data(),
+                                          width,
+                                          height,
+                                          mip_levels,
+                                          srgb);
+            CHECK(in_place == actual, "%ux%u srgb %d in place", width, height, srgb);
+        }
+    }
+}
+
+void TestSrgbFiltersInLinearSpace() {
+    // A black and white checkerboard averages to half the light, which is 188 in sRGB.
+    std::vector<uint8_t> pixels(2 * 2 * 4, 255);
+    for (int i : {0, 3}) {
+        pixels[i * 4] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4 + 3] = 0;
+    }
+    uint8_t chain[20];
+    tiny_engine::GenerateMipChain(chain, pixels.data(), 2, 2, 2, true);
+    CHECK(chain[16] == 188 && chain[17] == 188 && chain[18] == 188, "srgb %u", chain[16]);
+    CHECK(chain[19] == 128, "srgb alpha %u", chain[19]);
+    tiny_engine::GenerateMipChain(chain, pixels.data(), 2, 2, 2, false);
+    CHECK(chain[16] == 128 && chain[17] == 128 && chain[18] == 128, "unorm %u", chain[16]);
+    CHECK(chain[19] == 128, "unorm alpha %u", chain[19]);
+}
+
+} // namespace
+
+int main() {
+    TestDownsampleMatchesScalar();
+    TestLayout();
+    TestGenerateMatchesReference();
+    TestSrgbFiltersInLinearSpace();
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("mip_chain_test passed\n");
+    return 0;
+}
@@ -0,0 +1,369 @@
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#include <spirv_reflection.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
+
+// The opcodes, enums and decorations of the SPIR-V specification the modules below use.
+const uint32_t kOpEntryPoint = 15;
+const uint32_t kOpTypeVoid = 19;
+const uint32_t kOpTypeInt = 21;
+const uint32_t kOpTypeFloat = 22;
+const uint32_t kOpTypeVector = 23;
+const uint32_t kOpTypeImage = 25;
+const uint32_t kOpTypeSampledImage = 27;
+const uint32_t kOpTypeArray = 28;
+const uint32_t kOpTypeRuntimeArray = 29;
+const uint32_t kOpTypeStruct = 30;
+const uint32_t kOpTypePointer = 32;
+const uint32_t kOpTypeFunction = 33;
+const uint32_t kOpConstant = 43;
+const uint32_t kOpFunction = 54;
+const uint32_t kOpVariable = 59;
+const uint32_t kOpDecorate = 71;
+const uint32_t kOpFunctionEnd = 56;
+
+const uint32_t kVertex = 0;
+const uint32_t kFragment = 4;
+
+const uint32_t kBuiltIn = 11;
+const uint32_t kLocation = 30;
+const uint32_t kBinding = 33;
+const uint32_t kDescriptorSet = 34;
+
+const uint32_t kUniformConstant = 0;
+const uint32_t kInput = 1;
+const uint32_t kUniform = 2;
+const uint32_t kStorageBuffer = 12;
+
+const uint32_t kDim2D = 1;
+
+// Assembles a module word by word, ids are handed out in order.
+class Module {
+public:
+    Module() : words_{0x07230203, 0x00010000, 0, 0, 0} {}
+
+    uint32_t NewId() { return next_id_++; }
+
+    void Add(uint32_t op, std::vector<uint32_t> operands) {
+        words_.push_back(static_cast<uint32_t>(operands.size() + 1) << 16 | op);
+        words_.insert(words_.end(), operands.begin(), operands.end());
+    }
+
+    uint32_t AddType(uint32_t op, std::vector<uint32_t> operands) {
+        uint32_t id = NewId();
+        operands.insert(operands.begin(), id);
+        Add(op, operands);
+        return id;
+    }
+
+    uint32_t AddVariable(uint32_t storage_class, uint32_t type) {
+        uint32_t pointer = AddType(kOpTypePointer, {storage_class, type});
+        uint32_t id = NewId();
+        Add(kOpVariable, {pointer, id, storage_class});
+        return id;
+    }
+
+    void Decorate(uint32_t id, uint32_t decoration, uint32_t literal) {
+        Add(kOpDecorate, {id, decoration, literal});
+    }
+
+    void DecorateBinding(uint32_t id, uint32_t set, uint32_t binding) {
+        Decorate(id, kDescriptorSet, set);
+        Decorate(id, kBinding, binding);
+    }
+
+    // An empty main function and the final id bound, after which nothing is added.
+    const std::vector<uint32_t> &Finish(uint32_t main) {
+        uint32_t void_type = AddType(kOpTypeVoid, {});
+        uint32_t function_type = AddType(kOpTypeFunction, {void_type});
+        Add(kOpFunction, {void_type, main, 0, function_type});
+        Add(kOpFunctionEnd, {});
+        words_[3] = next_id_;
+        return words_;
+    }
+
+private:
+    std::vector<uint32_t> words_;
+    uint32_t next_id_ = 1;
+};
+
+// OpEntryPoint with the name "main".
+void AddEntryPoint(Module &module, uint32_t execution_model, uint32_t main) {
+    uint32_t name[2] = {};
+    memcpy(name, "main", 4);
+    module.Add(kOpEntryPoint, {execution_model, main, name[0], name[1]});
+}
+
+// A vertex shader with inputs at locations 2 (int), 0 (vec3) and 1 (vec2), the gl_VertexIndex
+// built-in, a uniform block at set 0 binding 0, a storage buffer at set 0 binding 1 and an
+// array of 4 combined image samplers at set 1 binding 2.
+std::vector<uint32_t> MakeVertexModule() {
+    Module module;
+    uint32_t main = module.NewId();
+    AddEntryPoint(module, kVertex, main);
+    uint32_t float_type = module.AddType(kOpTypeFloat, {32});
+    uint32_t int_type = module.AddType(kOpTypeInt, {32, 1});
+    uint32_t uint_type = module.AddType(kOpTypeInt, {32, 0});
+    uint32_t vec2_type = module.AddType(kOpTypeVector, {float_type, 2});
+    uint32_t vec3_type = module.AddType(kOpTypeVector, {float_type, 3});
+    uint32_t block_type = module.AddType(kOpTypeStruct, {vec3_type});
+    uint32_t image_type = module.AddType(kOpTypeImage, {float_type, kDim2D, 0, 0, 0, 1, 0});
+    uint32_t sampled_image_type = module.AddType(kOpTypeSampledImage, {image_type});
+    uint32_t four = module.NewId();
+    module.Add(kOpConstant, {uint_type, four, 4});
+    uint32_t sampler_array_type = module.AddType(kOpTypeArray, {sampled_image_type, four});
+
+    uint32_t index = module.AddVariable(kInput, int_type);
+    module.Decorate(index, kLocation, 2);
+    uint32_t position = module.AddVariable(kInput, vec3_type);
+    module.Decorate(position, kLocation, 0);
+    uint32_t texture_coordinate = module.AddVariable(kInput, vec2_type);
+    module.Decorate(texture_coordinate, kLocation, 1);
+    uint32_t vertex_index = module.AddVariable(kInput, int_type);
+    module.Decorate(vertex_index, kBuiltIn, 42);
+
+    uint32_t uniforms = module.AddVariable(kUniform, block_type);
+    module.DecorateBinding(uniforms, 0, 0);
+    uint32_t storage = module.AddVariable(kStorageBuffer, block_type);
+    module.DecorateBinding(storage, 0, 1);
+    uint32_t samplers = module.AddVariable(kUniformConstant, sampler_array_type);
+    module.DecorateBinding(samplers, 1, 2);
+    return module.Finish(main);
+}
+
+// A fragment shader with the combined image sampler array of the vertex module, or a single
+// one if sampler_count is 1.
+std::vector<uint32_t> MakeFragmentModule(uint32_t sampler_count) {
+    Module module;
+    uint32_t main = module.NewId();
+    AddEntryPoint(module, kFragment, main);
+    uint32_t float_type = module.AddType(kOpTypeFloat, {32});
+    uint32_t uint_type = module.AddType(kOpTypeInt, {32, 0});
+    uint32_t image_type = module.AddType(kOpTypeImage, {float_type, kDim2D, 0, 0, 0, 1, 0});
+    uint32_t sampler_type = module.AddType(kOpTypeSampledImage, {image_type});
+    if (sampler_count != 1) {
+        uint32_t count = module.NewId();
+        module.Add(kOpConstant, {uint_type, count, sampler_count});
+        sampler_type = module.AddType(kOpTypeArray, {sampler_type, count});
+    }
+    uint32_t samplers = module.AddVariable(kUniformConstant, sampler_type);
+    module.DecorateBinding(samplers, 1, 2);
+    return module.Finish(main);
+}
+
+bool Reflect(const std::vector<uint32_t> &words, tiny_engine::ShaderReflection &reflection) {
+    return tiny_engine::ReflectShader(words.data(), words.size() * sizeof(uint32_t), reflection);
+}
+
+void TestBindings() {
+    tiny_engine::ShaderReflection reflection;
+    CHECK(Reflect(MakeVertexModule(), reflection), "vertex module rejected");
+    CHECK(reflection.stages == VK_SHADER_STAGE_VERTEX_BIT, "%u", reflection.stages);
+
+    const std::vector<tiny_engine::ShaderBinding> &bindings = reflection.bindings;
+    CHECK(bindings.size() == 3, "%zu bindings", bindings.size());
+    if (bindings.size() != 3) {
+        return;
+    }
+    CHECK(bindings[0].set == 0 && bindings[0].binding == 0
+          && bindings[0].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && bindings[0].count == 1,
+          "binding 0: %u %u %d %u", bindings[0].set, bindings[0].binding, bindings[0].type,
+          bindings[0].count);
+    CHECK(bindings[1].set == 0 && bindings[1].binding == 1
+          && bindings[1].type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && bindings[1].count == 1,
+          "binding 1: %u %u %d %u", bindings[1].set, bindings[1].binding, bindings[1].type,
+          bindings[1].count);
+    CHECK(bindings[2].set == 1 && bindings[2].binding == 2
+          && bindings[2].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+          && bindings[2].count == 4,
+          "binding 2: %u %u %d %u", bindings[2].set, bindings[2].binding, bindings[2].type,
+          bindings[2].count);
+
+    std::vector<VkDescriptorSetLayoutBinding> layout_bindings =
+            tiny_engine::GetDescriptorSetLayoutBindings(reflection, 1);
+    CHECK(layout_bindings.size() == 1 && layout_bindings[0].binding == 2
+          && layout_bindings[0].descriptorCount == 4
+          && layout_bindings[0].stageFlags == VK_SHADER_STAGE_VERTEX_BIT,
+          "%zu set 1 bindings", layout_bindings.size());
+
+    // Merged with a fragment stage declaring the same array, which then has both stages.
+    tiny_engine::ShaderReflection fragment;
+    CHECK(Reflect(MakeFragmentModule(4), fragment), "fragment module rejected");
+    CHECK(fragment.inputs.empty(), "%zu fragment inputs", fragment.inputs.size());
+    tiny_engine::ShaderReflection merged;
+    CHECK(tiny_engine::MergeShaderReflections(reflection, fragment, merged), "merge failed");
+    CHECK(merged.bindings.size() == 3
+          && merged.bindings[2].stages
+             == (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+          "%zu merged bindings", merged.bindings.size());
+    CHECK(merged.inputs.size() == reflection.inputs.size(), "%zu", merged.inputs.size());
+
+    // A stage declaring the binding with another count does not merge.
+    tiny_engine::ShaderReflection single;
+    CHECK(Reflect(MakeFragmentModule(1), single), "fragment module rejected");
+    CHECK(!tiny_engine::MergeShaderReflections(reflection, single, merged), "merged a conflict");
+}
+
+void TestPoolSizes() {
+    tiny_engine::ShaderReflection reflection;
+    CHECK(Reflect(MakeVertexModule(), reflection), "vertex module rejected");
+    tiny_engine::UseDynamicBuffers(reflection);
+
+    std::vector<VkDescriptorPoolSize> pool_sizes =
+            tiny_engine::GetDescriptorPoolSizes(reflection, 0, 3);
+    CHECK(pool_sizes.size() == 2, "%zu set 0 pool sizes", pool_sizes.size());
+    if (pool_sizes.size() == 2) {
+        CHECK(pool_sizes[0].type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+              && pool_sizes[0].descriptorCount == 3,
+              "%d %u", pool_sizes[0].type, pool_sizes[0].descriptorCount);
+        CHECK(pool_sizes[1].type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+              && pool_sizes[1].descriptorCount == 3,
+              "%d %u", pool_sizes[1].type, pool_sizes[1].descriptorCount);
+    }
+
+    pool_sizes = tiny_engine::GetDescriptorPoolSizes(reflection, 1, 3);
+    CHECK(pool_sizes.size() == 1 && pool_sizes[0].type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+          && pool_sizes[0].descriptorCount == 12,
+          "%zu set 1 pool sizes", pool_sizes.size());
+    CHECK(tiny_engine::GetDescriptorPoolSizes(reflection, 2, 3).empty(), "set 2 has descriptors");
+}
+
+void TestVertexAttributes() {
+    tiny_engine::ShaderReflection reflection;
+    CHECK(Reflect(MakeVertexModule(), reflection), "vertex module rejected");
+
+    // Sorted by location and tightly packed, the built-in left out.
+    std::vector<VkVertexInputAttributeDescription> attributes =
+            tiny_engine::GetVertexAttributeDescriptions(reflection);
+    const VkFormat formats[] = {VK_FORMAT_R32G32B32_SFLOAT,
+                                VK_FORMAT_R32G32_SFLOAT,
+                                VK_FORMAT_R32_SINT};
+    const uint32_t offsets[] = {0, 12, 20};
+    CHECK(attributes.size() == 3, "%zu attributes", attributes.size());
+    for (uint32_t i = 0; i < attributes.size() && i < 3; i++) {
+        CHECK(attributes[i].location == i && attributes[i].binding == 0
+              && attributes[i].format == formats[i] && attributes[i].offset == offsets[i],
+              "attribute %u: %u %d %u", i, attributes[i].location, attributes[i].format,
+              attributes[i].offset);
+    }
+
+    std::vector<VkVertexInputBindingDescription> vertex_bindings =
+            tiny_engine::GetVertexBindingDescriptions(reflection);
+    CHECK(vertex_bindings.size() == 1 && vertex_bindings[0].binding == 0
+          && vertex_bindings[0].stride == 24
+          && vertex_bindings[0].inputRate == VK_VERTEX_INPUT_RATE_VERTEX,
+          "%zu vertex bindings", vertex_bindings.size());
+}
+
+void TestRejection() {
+    tiny_engine::ShaderReflection reflection;
+    std::vector<uint32_t> words = MakeVertexModule();
+
+    // Every prefix, e.g. of a module read only partially, whether it ends inside an instruction
+    // or between two.
+    for (size_t size = 0; size < words.size(); size++) {
+        CHECK(!Reflect(std::vector<uint32_t>(words.begin(), words.begin() + size), reflection),
+              "accepted %zu of %zu words", size, words.size());
+    }
+    CHECK(!tiny_engine::ReflectShader(words.data(), words.size() * sizeof(uint32_t) - 1,
+                                      reflection),
+          "accepted a partial word");
+
+    std::vector<uint32_t> malformed = words;
+    malformed[0] = 0x03022307;
+    CHECK(!Reflect(malformed, reflection), "accepted a wrong magic");
+
+    malformed = words;
+    malformed[3] = 1u << 30;
+    CHECK(!Reflect(malformed, reflection), "accepted an id bound out of range");
+
+    // A zero word count would never advance.
+    malformed = words;
+    malformed[5] = 15;
+    CHECK(!Reflect(malformed, reflection), "accepted a zero word count");
+
+    // What the reflection does not cover.
+    {
+        Module module;
+        uint32_t main = module.NewId();
+        AddEntryPoint(module, kFragment, main);
+        uint32_t float_type = module.AddType(kOpTypeFloat, {32});
+        uint32_t block_type = module.AddType(kOpTypeStruct, {float_type});
+        uint32_t array_type = module.AddType(kOpTypeRuntimeArray, {block_type});
+        uint32_t buffers = module.AddVariable(kStorageBuffer, array_type);
+        module.DecorateBinding(buffers, 0, 0);
+        CHECK(!Reflect(module.Finish(main), reflection), "accepted a runtime array");
+    }
+    {
+        Module module;
+        uint32_t main = module.NewId();
+        AddEntryPoint(module, kVertex, main);
+        uint32_t half_type = module.AddType(kOpTypeFloat, {16});
+        uint32_t input = module.AddVariable(kInput, half_type);
+        module.Decorate(input, kLocation, 0);
+        CHECK(!Reflect(module.Finish(main), reflection), "accepted a 16-bit input");
+    }
+    {
+        Module module;
+        uint32_t main = module.NewId();
+        uint32_t float_type = module.AddType(kOpTypeFloat, {32});
+        module.AddVariable(kInput, float_type);
+        CHECK(!Reflect(module.Finish(main), reflection), "accepted no entry point");
+    }
+
+    // GetShaderReflection throws rather than caching a failure.
+    bool threw = false;
+    try {
+        tiny_engine::GetShaderReflection(malformed.data(), malformed.size() * sizeof(uint32_t));
+    } catch (const std::exception &) {
+        threw = true;
+    }
+    CHECK(threw, "GetShaderReflection accepted a malformed module");
+}
+
+// The cache goes by content, not by address.
+void TestCache() {
+    std::vector<uint32_t> a = MakeVertexModule();
+    std::vector<uint32_t> b = a;
+    std::vector<uint32_t> fragment = MakeFragmentModule(4);
+    auto reflection_a = tiny_engine::GetShaderReflection(a.data(), a.size() * sizeof(uint32_t));
+    auto reflection_b = tiny_engine::GetShaderReflection(b.data(), b.size() * sizeof(uint32_t));
+    auto reflection_fragment =
+            tiny_engine::GetShaderReflection(fragment.data(), fragment.size() * sizeof(uint32_t));
+    CHECK(reflection_a == reflection_b, "equal code parsed twice");
+    CHECK(reflection_a != reflection_fragment, "different code shares a reflection");
+    CHECK(reflection_fragment->stages == VK_SHADER_STAGE_FRAGMENT_BIT, "%u",
+          reflection_fragment->stages);
+}
+
+} // namespace
+
+int main() {
+    TestBindings();
+    TestPoolSizes();
+    TestVertexAttributes();
+    TestRejection();
+    TestCache();
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("spirv_reflection_test passed\n");
+    return 0;
+}
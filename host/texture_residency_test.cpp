@@ -0,0 +1,195 @@
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <mip_chain.h>
+#include <texture_residency.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
+
+const size_t kMiB = 1024 * 1024;
+const uint32_t kTextureCount = 3;
+const uint32_t kTextureSize = 4096;
+
+// What the handlers of a texture were asked to do, reset by each step.
+struct Calls {
+    int trims = 0;
+    int evicts = 0;
+    int restreams = 0;
+    uint32_t restream_level = 0;
+};
+
+// Level sizes of a tightly packed RGBA8 chain of size x size.
+std::vector<size_t> GetLevelSizes(uint32_t size) {
+    uint32_t mip_levels = tiny_engine::GetMipLevelCount(size, size);
+    std::vector<size_t> level_sizes;
+    for (const tiny_engine::MipLevel &level :
+            tiny_engine::GetMipChainLayout(size, size, mip_levels, 4)) {
+        level_sizes.push_back(static_cast<size_t>(level.width) * level.height * 4);
+    }
+    return level_sizes;
+}
+
+// Bytes of levels first_level and below.
+size_t GetTailSize(const std::vector<size_t> &level_sizes, uint32_t first_level) {
+    size_t size = 0;
+    for (size_t i = first_level; i < level_sizes.size(); i++) {
+        size += level_sizes[i];
+    }
+    return size;
+}
+
+// Three 4096x4096 chains (85 MiB each in full), resident from level 1 (21 MiB each, 64 MiB in
+// all), taken through the budget going down to 40 and 24 MiB and back up to 40 MiB.
+void TestBudget() {
+    tiny_engine::TextureResidency residency;
+    std::vector<size_t> level_sizes = GetLevelSizes(kTextureSize);
+    auto level_count = static_cast<uint32_t>(level_sizes.size());
+    size_t level1 = GetTailSize(level_sizes, 1);
+    size_t level2 = GetTailSize(level_sizes, 2);
+
+    std::vector<Calls> calls(kTextureCount);
+    std::vector<uint32_t> ids(kTextureCount);
+    for (uint32_t i = 0; i < kTextureCount; i++) {
+        tiny_engine::TextureResidencyHandlers handlers;
+        // Trims are carried out right away, as TrimTextureImage copies within the device.
+        handlers.trim = [&residency, &calls, &ids, i](uint32_t first_level) {
+            calls[i].trims++;
+            residency.SetResident(ids[i], first_level);
+        };
+        handlers.evict = [&calls, i]() { calls[i].evicts++; };
+        // Restreams arrive later, when the test calls SetResident.
+        handlers.restream = [&calls, i](uint32_t first_level) {
+            calls[i].restreams++;
+            calls[i].restream_level = first_level;
+        };
+        ids[i] = residency.Add(level_sizes, std::move(handlers));
+        residency.SetResident(ids[i], 1);
+    }
+    CHECK(residency.GetResidentSize() == 3 * level1, "%zu", residency.GetResidentSize());
+    CHECK(level1 + 2 * level2 <= 32 * kMiB, "%zu", level1 + 2 * level2);
+
+    auto touch = [&](uint64_t frame, const std::vector<uint32_t> &used) {
+        for (uint32_t i : used) {
+            residency.Touch(ids[i], frame);
+        }
+    };
+    auto update = [&](uint64_t frame) {
+        calls.assign(kTextureCount, Calls());
+        residency.Update(frame);
+    };
+
+    // All used at 40 MiB: the top levels of two are dropped, the largest first, which fits
+    // (64 -> 32 MiB). Nothing is evicted.
+    uint64_t frame = 1;
+    residency.SetBudget(40 * kMiB);
+    touch(frame, {0, 1, 2});
+    update(frame);
+    CHECK(calls[0].trims == 1 && calls[1].trims == 1 && calls[2].trims == 0,
+          "trims %d %d %d", calls[0].trims, calls[1].trims, calls[2].trims);
+    CHECK(calls[0].evicts + calls[1].evicts + calls[2].evicts == 0, "evicted while used");
+    CHECK(residency.GetFirstLevel(ids[0]) == 2 && residency.GetFirstLevel(ids[1]) == 2
+          && residency.GetFirstLevel(ids[2]) == 1,
+          "levels %u %u %u", residency.GetFirstLevel(ids[0]), residency.GetFirstLevel(ids[1]),
+          residency.GetFirstLevel(ids[2]));
+    CHECK(residency.GetResidentSize() == level1 + 2 * level2, "%zu", residency.GetResidentSize());
+
+    // The next frame at the same budget changes nothing, trimmed textures wait before growing.
+    frame++;
+    touch(frame, {0, 1, 2});
+    update(frame);
+    for (uint32_t i = 0; i < kTextureCount; i++) {
+        CHECK(calls[i].trims + calls[i].evicts + calls[i].restreams == 0, "texture %u", i);
+    }
+
+    // Texture 2 goes idle and the budget drops to 24 MiB: it is evicted, which is enough, so the
+    // used two stay at level 2.
+    for (uint64_t end = frame + tiny_engine::TextureResidency::kIdleFrames + 1; frame < end;) {
+        frame++;
+        touch(frame, {0, 1});
+    }
+    residency.SetBudget(24 * kMiB);
+    update(frame);
+    CHECK(calls[2].evicts == 1, "%d", calls[2].evicts);
+    CHECK(calls[0].trims + calls[1].trims + calls[0].evicts + calls[1].evicts == 0,
+          "used textures changed");
+    CHECK(residency.GetFirstLevel(ids[2]) == level_count, "%u", residency.GetFirstLevel(ids[2]));
+    CHECK(residency.GetResidentSize() == 2 * level2, "%zu", residency.GetResidentSize());
+
+    // Back at 40 MiB with texture 2 used again: texture 0 grows to level 1 and texture 2 streams
+    // back at the finest level which fits next to that, level 2. Texture 1 would not fit at
+    // level 1 any more (21 + 21 + 5 > 40 MiB).
+    frame++;
+    residency.SetBudget(40 * kMiB);
+    touch(frame, {0, 1, 2});
+    update(frame);
+    CHECK(calls[0].restreams == 1 && calls[0].restream_level == 1,
+          "%d %u", calls[0].restreams, calls[0].restream_level);
+    CHECK(calls[1].restreams == 0, "%d", calls[1].restreams);
+    CHECK(calls[2].restreams == 1 && calls[2].restream_level == 2,
+          "%d %u", calls[2].restreams, calls[2].restream_level);
+
+    // Restreams in flight count as resident, nothing is asked for twice.
+    frame++;
+    touch(frame, {0, 1, 2});
+    update(frame);
+    for (uint32_t i = 0; i < kTextureCount; i++) {
+        CHECK(calls[i].trims + calls[i].evicts + calls[i].restreams == 0, "texture %u", i);
+    }
+
+    residency.SetResident(ids[0], 1);
+    residency.SetResident(ids[2], 2);
+    CHECK(residency.GetResidentSize() == level1 + 2 * level2, "%zu", residency.GetResidentSize());
+    CHECK(residency.GetResidentSize() <= 40 * kMiB, "%zu", residency.GetResidentSize());
+
+    // Settled: nothing more fits, nothing has to go.
+    frame++;
+    touch(frame, {0, 1, 2});
+    update(frame);
+    for (uint32_t i = 0; i < kTextureCount; i++) {
+        CHECK(calls[i].trims + calls[i].evicts + calls[i].restreams == 0, "texture %u", i);
+    }
+}
+
+// Without a budget, used textures below their full size are streamed back at level 0.
+void TestUnlimited() {
+    tiny_engine::TextureResidency residency;
+    uint32_t restream_level = 1;
+    tiny_engine::TextureResidencyHandlers handlers;
+    handlers.trim = [](uint32_t) {};
+    handlers.evict = []() {};
+    handlers.restream = [&restream_level](uint32_t first_level) { restream_level = first_level; };
+    uint32_t id = residency.Add(GetLevelSizes(kTextureSize), std::move(handlers));
+    residency.SetResident(id, 2);
+    residency.Touch(id, 1);
+    residency.Update(1);
+    CHECK(restream_level == 0, "%u", restream_level);
+
+    residency.Remove(id);
+    CHECK(residency.GetResidentSize() == 0, "%zu", residency.GetResidentSize());
+}
+
+} // namespace
+
+int main() {
+    TestBudget();
+    TestUnlimited();
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("texture_residency_test passed\n");
+    return 0;
+}
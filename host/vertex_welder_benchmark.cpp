@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <filesystem.h>
+#include <obj_loader.h>
+#include <vertex_welder.h>
+
+namespace {
+
+// The layout of the model sample's vertex.
+struct Vertex {
+    float pos[3];
+    float color[3];
+    float tex_coord[2];
+
+    bool operator==(const Vertex &other) const {
+        return memcmp(this, &other, sizeof(Vertex)) == 0;
+    }
+};
+
+size_t HashFloats(const float *values, size_t count) {
+    size_t seed = 0;
+    for (size_t i = 0; i < count; i++) {
+        seed ^= std::hash<float>()(values[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
+
+// The glm::hash based hash the model sample used before GenerateVertexRemap.
+struct VertexHash {
+    size_t operator()(const Vertex &vertex) const {
+        return ((HashFloats(vertex.pos, 3) ^ (HashFloats(vertex.color, 3) << 1)) >> 1)
+               ^ (HashFloats(vertex.tex_coord, 2) << 1);
+    }
+};
+
+// One vertex per corner of a grid of width x height quads, two triangles per quad, like the
+// stream an OBJ loader produces before welding.
+std::vector<Vertex> CreateGrid(uint32_t width, uint32_t height) {
+    std::vector<Vertex> corners;
+    corners.reserve((size_t) width * height * 6);
+    const uint32_t quad[6][2] = {{0, 0}, {1, 0}, {1, 1}, {1, 1}, {0, 1}, {0, 0}};
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            for (const uint32_t *corner : quad) {
+                float u = (float) (x + corner[0]) / width;
+                float v = (float) (y + corner[1]) / height;
+                corners.push_back({{u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f},
+                                   {1.0f, 1.0f, 1.0f},
+                                   {u, v}});
+            }
+        }
+    }
+    return corners;
+}
+
+// One vertex per face corner of an OBJ file, built as ModelApplication::CreateModel does.
+std::vector<Vertex> LoadObjCorners(const std::string &filename) {
+    tiny_engine::FileView file = tiny_engine::Filesystem::GetInstance().Map(filename);
+    tiny_engine::ObjModel model = tiny_engine::ParseObj(file.As<char>(), file.size());
+    std::vector<Vertex> corners(model.indices.size());
+    for (size_t i = 0; i < model.indices.size(); i++) {
+        const tiny_engine::ObjIndex &index = model.indices[i];
+        Vertex &vertex = corners[i];
+        for (int k = 0; k < 3; k++) {
+            vertex.pos[k] = model.positions[3 * index.position + k];
+            vertex.color[k] = 1.0f;
+        }
+        if (index.texcoord >= 0) {
+            vertex.tex_coord[0] = model.texcoords[2 * index.texcoord + 0];
+            vertex.tex_coord[1] = 1.0f - model.texcoords[2 * index.texcoord + 1];
+        } else {
+            vertex.tex_coord[0] = vertex.tex_coord[1] = 0.0f;
+        }
+    }
+    return corners;
+}
+
+std::vector<uint32_t> WeldWithUnorderedMap(const std::vector<Vertex> &corners,
+                                           std::vector<Vertex> &vertices) {
+    std::unordered_map<Vertex, uint32_t, VertexHash> unique_vertices;
+    std::vector<uint32_t> indices;
+    indices.reserve(corners.size());
+    for (const Vertex &vertex : corners) {
+        if (unique_vertices.count(vertex) == 0) {
+            unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vertex);
+        }
+        indices.push_back(unique_vertices[vertex]);
+    }
+    return indices;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+}
+
+} // namespace
+
+// Usage: vertex_welder_benchmark [OBJ file]
+//        vertex_welder_benchmark --grid [width] [height]
+// Welds the face corners of an OBJ file (the model sample's viking_room.obj by default) or of a
+// grid mesh with GenerateVertexRemap and with the unordered_map loop it replaced, checks that
+// both give the same result and prints the best of a few runs.
+int main(int argc, char **argv) {
+    const int runs = 5;
+    std::vector<Vertex> corners;
+    if (argc > 1 && strcmp(argv[1], "--grid") == 0) {
+        uint32_t width = argc > 2 ? (uint32_t) atoi(argv[2]) : 1000;
+        uint32_t height = argc > 3 ? (uint32_t) atoi(argv[3]) : 600;
+        corners = CreateGrid(width, height);
+    } else {
+        std::string filename = argc > 1 ? argv[1] : DEFAULT_OBJ_FILE;
+        try {
+            tiny_engine::Filesystem::GetInstance().Init(nullptr);
+            corners = LoadObjCorners(filename);
+        } catch (const std::exception &e) {
+            fprintf(stderr, "%s: %s\n", filename.c_str(), e.what());
+            return 1;
+        }
+        printf("%s\n", filename.c_str());
+    }
+
+    double map_time = 0.0;
+    double welder_time = 0.0;
+    std::vector<Vertex> map_vertices;
+    std::vector<uint32_t> map_indices;
+    std::vector<Vertex> welded_vertices;
+    std::vector<uint32_t> welded_indices;
+    for (int run = 0; run < runs; run++) {
+        map_vertices.clear();
+        auto start = std::chrono::steady_clock::now();
+        map_indices = WeldWithUnorderedMap(corners, map_vertices);
+        double time = Milliseconds(start);
+        map_time = run == 0 ? time : std::min(map_time, time);
+
+        welded_vertices = corners;
+        start = std::chrono::steady_clock::now();
+        welded_indices = tiny_engine::WeldVertices(welded_vertices);
+        time = Milliseconds(start);
+        welder_time = run == 0 ? time : std::min(welder_time, time);
+    }
+
+    if (map_indices != welded_indices || !(map_vertices == welded_vertices)) {
+        fprintf(stderr, "GenerateVertexRemap and unordered_map disagree\n");
+        return 1;
+    }
+    printf("%zu corners -> %zu vertices\n", corners.size(), welded_vertices.size());
+    printf("unordered_map:       %8.2f ms\n", map_time);
+    printf("GenerateVertexRemap: %8.2f ms (%.2fx)\n", welder_time, map_time / welder_time);
+    return 0;
+}
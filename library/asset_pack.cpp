@@ -0,0 +1,242 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "lz4_block.h"
+
+namespace tiny_engine {
+
+namespace {
+
+const char kAssetPackMagic[4] = {'T', 'E', 'P', 'K'};
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool LessEntry(const AssetPackEntry &entry, const char *names, uint64_t hash,
+               const std::string &name) {
+    if (entry.name_hash != hash) {
+        return entry.name_hash < hash;
+    }
+    return std::string(names + entry.name_offset, entry.name_length) < name;
+}
+
+} // namespace
+
+uint64_t HashAssetName(const std::string &name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool AssetPack::Load(const FileView &file) {
+    file_ = FileView();
+    entries_ = nullptr;
+    entry_count_ = 0;
+    names_ = nullptr;
+
+    if (file.size() < sizeof(AssetPackHeader)) {
+        LOGW("Asset pack is truncated");
+        return false;
+    }
+    const auto *header = file.As<AssetPackHeader>();
+    if (memcmp(header->magic, kAssetPackMagic, sizeof(kAssetPackMagic)) != 0
+        || header->version != kVersion) {
+        LOGW("Asset pack has an unknown format or version");
+        return false;
+    }
+    uint64_t entries_size = static_cast<uint64_t>(header->entry_count) * sizeof(AssetPackEntry);
+    if (header->entry_offset > file.size() || entries_size > file.size() - header->entry_offset
+        || header->names_offset > file.size()
+        || header->names_size > file.size() - header->names_offset) {
+        LOGW("Asset pack has a corrupt table of contents");
+        return false;
+    }
+
+    const auto *entries = reinterpret_cast<const AssetPackEntry *>(file.data()
+                                                                   + header->entry_offset);
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const AssetPackEntry &entry = entries[i];
+        bool valid = entry.name_offset <= header->names_size
+                     && entry.name_length <= header->names_size - entry.name_offset
+                     && entry.offset <= file.size()
+                     && entry.stored_size <= file.size() - entry.offset;
+        if (entry.compression == static_cast<uint32_t>(AssetCompression::kNone)) {
+            valid = valid && entry.stored_size == entry.size;
+        } else if (entry.compression != static_cast<uint32_t>(AssetCompression::kLz4)) {
+            valid = false;
+        }
+        if (!valid) {
+            LOGW("Asset pack entry %u is corrupt", i);
+            return false;
+        }
+    }
+
+    file_ = file;
+    entries_ = entries;
+    entry_count_ = header->entry_count;
+    names_ = file.As<char>() + header->names_offset;
+    return true;
+}
+
+const AssetPackEntry *AssetPack::Find(const std::string &name) const {
+    uint64_t hash = HashAssetName(name);
+    const AssetPackEntry *end = entries_ + entry_count_;
+    const AssetPackEntry *entry = std::lower_bound(
+            entries_, end, name,
+            [this, hash](const AssetPackEntry &entry, const std::string &name) {
+                return LessEntry(entry, names_, hash, name);
+            });
+    if (entry == end || entry->name_hash != hash || entry->name_length != name.size()
+        || memcmp(names_ + entry->name_offset, name.data(), name.size()) != 0) {
+        return nullptr;
+    }
+    return entry;
+}
+
+bool AssetPack::Map(const std::string &name, FileView &view) const {
+    const AssetPackEntry *entry = Find(name);
+    if (entry == nullptr) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(entry->size);
+    if (entry->compression == static_cast<uint32_t>(AssetCompression::kNone)) {
+        view = file_.Slice(static_cast<size_t>(entry->offset), size);
+        return true;
+    }
+
+    const uint8_t *stored = file_.data() + entry->offset;
+
+    auto buffer = std::make_shared<std::vector<uint8_t>>(size);
+    if (!Lz4DecompressBlock(stored, static_cast<size_t>(entry->stored_size), buffer->data(),
+                            size)) {
+        throw std::runtime_error("failed to decompress asset " + name + "!");
+    }
+    const uint8_t *data = buffer->data();
+    view = FileView(std::move(buffer), data, size);
+    return true;
+}
+
+void AssetPack::Prefetch(const std::vector<std::string> &names) const {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (const std::string &name : names) {
+        const AssetPackEntry *entry = Find(name);
+        if (entry != nullptr && entry->stored_size != 0) {
+            ranges.emplace_back(static_cast<size_t>(entry->offset),
+                                static_cast<size_t>(entry->offset + entry->stored_size));
+        }
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    // The mapping itself need not be page aligned (it is an offset into the APK on Android).
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto base = reinterpret_cast<uintptr_t>(file_.data());
+    for (size_t i = 0; i < ranges.size();) {
+        size_t begin = ranges[i].first;
+        size_t end = ranges[i].second;
+        // Entries are aligned, so neighbours of the same run only differ by their padding.
+        for (i++; i < ranges.size() && ranges[i].first <= AlignUp(end, kAlignment); i++) {
+            end = std::max(end, ranges[i].second);
+        }
+        uintptr_t first_page = (base + begin) / page_size * page_size;
+        madvise(reinterpret_cast<void *>(first_page), base + end - first_page, MADV_WILLNEED);
+    }
+}
+
+void AssetPackWriter::Add(const std::string &name, const void *data, size_t size, bool compress) {
+    Asset asset;
+    asset.name = name;
+    asset.size = size;
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    if (compress && size != 0) {
+        std::vector<uint8_t> compressed = Lz4CompressBlock(bytes, size);
+        if (compressed.size() <= size - size / 8) {
+            asset.data = std::move(compressed);
+            asset.compression = AssetCompression::kLz4;
+        }
+    }
+    if (asset.compression == AssetCompression::kNone) {
+        asset.data.assign(bytes, bytes + size);
+    }
+    assets_.push_back(std::move(asset));
+}
+
+std::vector<uint8_t> AssetPackWriter::Build() const {
+    std::vector<AssetPackEntry> entries(assets_.size());
+    std::string names;
+    for (size_t i = 0; i < assets_.size(); i++) {
+        AssetPackEntry &entry = entries[i];
+        entry = AssetPackEntry();
+        entry.name_hash = HashAssetName(assets_[i].name);
+        entry.name_offset = static_cast<uint32_t>(names.size());
+        entry.name_length = static_cast<uint32_t>(assets_[i].name.size());
+        entry.size = assets_[i].size;
+        entry.stored_size = assets_[i].data.size();
+        entry.compression = static_cast<uint32_t>(assets_[i].compression);
+        names += assets_[i].name;
+    }
+
+    AssetPackHeader header{};
+    memcpy(header.magic, kAssetPackMagic, sizeof(kAssetPackMagic));
+    header.version = AssetPack::kVersion;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.entry_offset = sizeof(AssetPackHeader);
+    header.names_offset = header.entry_offset + entries.size() * sizeof(AssetPackEntry);
+    header.names_size = names.size();
+
+    // Data in the order of Add, the table sorted for lookup.
+    size_t offset = static_cast<size_t>(header.names_offset + header.names_size);
+    for (AssetPackEntry &entry : entries) {
+        offset = AlignUp(offset, AssetPack::kAlignment);
+        entry.offset = offset;
+        offset += static_cast<size_t>(entry.stored_size);
+    }
+    std::vector<uint8_t> pack(offset);
+    for (size_t i = 0; i < assets_.size(); i++) {
+        if (!assets_[i].data.empty()) {
+            memcpy(pack.data() + entries[i].offset, assets_[i].data.data(),
+                   assets_[i].data.size());
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [&names](const AssetPackEntry &a, const AssetPackEntry &b) {
+                  return LessEntry(a, names.data(), b.name_hash,
+                                   names.substr(b.name_offset, b.name_length));
+              });
+    for (size_t i = 1; i < entries.size(); i++) {
+        if (!LessEntry(entries[i - 1], names.data(), entries[i].name_hash,
+                       names.substr(entries[i].name_offset, entries[i].name_length))) {
+            throw std::runtime_error("failed to build asset pack, duplicate asset "
+                                     + names.substr(entries[i].name_offset,
+                                                    entries[i].name_length) + "!");
+        }
+    }
+
+    memcpy(pack.data(), &header, sizeof(header));
+    memcpy(pack.data() + header.entry_offset, entries.data(),
+           entries.size() * sizeof(AssetPackEntry));
+    memcpy(pack.data() + header.names_offset, names.data(), names.size());
+    return pack;
+}
+
+bool AssetPackWriter::Write(const std::string &path) const {
+    std::vector<uint8_t> pack = Build();
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(pack.data(), 1, pack.size(), file) == pack.size();
+    return fclose(file) == 0 && written;
+}
+
+} // namespace tiny_engine
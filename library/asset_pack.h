@@ -0,0 +1,108 @@
+#ifndef TINY_ENGINE_ASSET_PACK_H
+#define TINY_ENGINE_ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+
+namespace tiny_engine {
+
+enum class AssetCompression : uint32_t {
+    kNone = 0,
+    // One raw LZ4 block, see Lz4CompressBlock.
+    kLz4 = 1
+};
+
+// Header of a pack file. It is followed by entry_count entries sorted by name hash and name, the
+// names blob, then the entry data, every entry starting at a multiple of
+// AssetPack::kAlignment from the start of the pack.
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+    uint64_t entry_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+};
+
+struct AssetPackEntry {
+    // HashAssetName of the name.
+    uint64_t name_hash;
+    // The name, without terminator, in the names blob.
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint64_t offset;
+    // Size of the asset, and of what is stored at offset (smaller if compressed).
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+// FNV-1a of an asset path, the sort key of the table of contents.
+uint64_t HashAssetName(const std::string &name);
+
+// Read side of a pack: many assets in one file, looked up by binary search in its table of
+// contents and served from the single mapping of the pack, so opening an asset costs no system
+// call. Stored entries are handed out in place, LZ4 entries are decompressed on each Map.
+class AssetPack {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    static constexpr size_t kAlignment = 4096;
+
+    // Returns false, with the reason logged, if file is not a valid pack.
+    bool Load(const FileView &file);
+
+    bool Contains(const std::string &name) const { return Find(name) != nullptr; }
+
+    // Sets view to the content of name, returns false if the pack has no such asset. Throws if a
+    // compressed entry is corrupt.
+    bool Map(const std::string &name, FileView &view) const;
+
+    // Asks the kernel to start reading the stored data of names, merged into contiguous runs, so
+    // the first Map of each does not fault page by page. Unknown names are ignored.
+    void Prefetch(const std::vector<std::string> &names) const;
+
+    size_t GetEntryCount() const { return entry_count_; }
+
+private:
+    const AssetPackEntry *Find(const std::string &name) const;
+
+private:
+    FileView file_;
+    const AssetPackEntry *entries_ = nullptr;
+    size_t entry_count_ = 0;
+    const char *names_ = nullptr;
+};
+
+// Builds a pack file offline. Data is laid out in the order assets are added, so adding the
+// assets of a scene one after another lets AssetPack::Prefetch read them as one run.
+class AssetPackWriter {
+public:
+    // With compress the asset is stored LZ4 compressed if that saves at least an eighth.
+    void Add(const std::string &name, const void *data, size_t size, bool compress = true);
+
+    std::vector<uint8_t> Build() const;
+
+    // Returns false if the file could not be written.
+    bool Write(const std::string &path) const;
+
+private:
+    struct Asset {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint64_t size = 0;
+        AssetCompression compression = AssetCompression::kNone;
+    };
+
+    std::vector<Asset> assets_;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_ASSET_PACK_H
@@ -0,0 +1,190 @@
+#include "asset_streamer.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "log.h"
+
+namespace tiny_engine {
+
+namespace {
+
+const size_t kPageSize = 4096;
+
+// Reads one byte of every page so the decode worker does not stall on the disk (or, for
+// compressed APK assets, the inflate already happened in Map).
+void FaultIn(const FileView &file) {
+    volatile uint8_t sink = 0;
+    for (size_t offset = 0; offset < file.size(); offset += kPageSize) {
+        sink ^= file.data()[offset];
+    }
+    (void) sink;
+}
+
+} // namespace
+
+AssetStreamer::AssetStreamer(uint32_t io_thread_count, uint32_t decode_thread_count)
+        : io_thread_count_(std::max(io_thread_count, 1u)),
+          decode_thread_count_(decode_thread_count) {
+    if (decode_thread_count_ == 0) {
+        decode_thread_count_ = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+}
+
+AssetStreamer::~AssetStreamer() {
+    Stop();
+}
+
+void AssetStreamer::Request(StreamRequest request) {
+    auto job = std::make_shared<Job>();
+    job->request = std::move(request);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        job->sequence = next_sequence_++;
+        io_queue_.push(std::move(job));
+        if (threads_.empty()) {
+            for (uint32_t i = 0; i < io_thread_count_; i++) {
+                threads_.emplace_back(&AssetStreamer::RunIo, this);
+            }
+            for (uint32_t i = 0; i < decode_thread_count_; i++) {
+                threads_.emplace_back(&AssetStreamer::RunDecode, this);
+            }
+        }
+    }
+    io_condition_.notify_one();
+}
+
+size_t AssetStreamer::Update(size_t budget) {
+    size_t uploaded = 0;
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (upload_queue_.empty()) {
+                break;
+            }
+            const std::shared_ptr<Job> &next = upload_queue_.top();
+            if (uploaded != 0 && uploaded + next->upload_size > budget) {
+                break;
+            }
+            job = next;
+            upload_queue_.pop();
+        }
+        // Outside the lock, the callbacks may request more assets.
+        if (!job->error.empty()) {
+            if (job->request.fail) {
+                job->request.fail(job->error);
+            } else {
+                LOGE("failed to stream %s: %s", job->request.filename.c_str(),
+                     job->error.c_str());
+            }
+            continue;
+        }
+        job->request.upload();
+        uploaded += job->upload_size;
+    }
+    return uploaded;
+}
+
+bool AssetStreamer::HasUploads() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !upload_queue_.empty();
+}
+
+bool AssetStreamer::IsIdle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return io_queue_.empty() && decode_queue_.empty() && upload_queue_.empty()
+           && active_count_ == 0;
+}
+
+void AssetStreamer::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        io_queue_ = JobQueue();
+        decode_queue_ = JobQueue();
+    }
+    io_condition_.notify_all();
+    decode_condition_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    // Callbacks may hold on to resources of the caller, release them now.
+    upload_queue_ = JobQueue();
+}
+
+void AssetStreamer::RunIo() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            io_condition_.wait(lock, [this]() { return stopping_ || !io_queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = io_queue_.top();
+            io_queue_.pop();
+            active_count_++;
+        }
+
+        try {
+            job->file = Filesystem::GetInstance().Map(job->request.filename);
+            FaultIn(job->file);
+        } catch (const std::exception &e) {
+            job->error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_count_--;
+            if (stopping_) {
+                return;
+            }
+            if (job->error.empty()) {
+                decode_queue_.push(std::move(job));
+            } else {
+                upload_queue_.push(std::move(job));
+            }
+        }
+        decode_condition_.notify_one();
+    }
+}
+
+void AssetStreamer::RunDecode() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            decode_condition_.wait(lock, [this]() {
+                return stopping_ || !decode_queue_.empty();
+            });
+            if (stopping_) {
+                return;
+            }
+            job = decode_queue_.top();
+            decode_queue_.pop();
+            active_count_++;
+        }
+
+        try {
+            job->upload_size = job->request.decode(job->file);
+        } catch (const std::exception &e) {
+            job->error = e.what();
+        }
+        // The decoded data is all the upload needs.
+        job->file = FileView();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_count_--;
+        if (stopping_) {
+            return;
+        }
+        upload_queue_.push(std::move(job));
+    }
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,107 @@
+#ifndef TINY_ENGINE_ASSET_STREAMER_H
+#define TINY_ENGINE_ASSET_STREAMER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "filesystem.h"
+
+namespace tiny_engine {
+
+struct StreamRequest {
+    std::string filename;
+    // Higher priorities go first through every stage, equal ones in request order.
+    int priority = 0;
+    // Runs on a decode worker with the mapped file and prepares everything the upload needs.
+    // Returns the number of bytes the upload copies to the GPU, which is charged against the
+    // per-frame budget. Throwing fails the request.
+    std::function<size_t(const FileView &file)> decode;
+    // Runs on the render thread from AssetStreamer::Update.
+    std::function<void()> upload;
+    // Runs on the render thread instead of upload if the file could not be read or decode threw.
+    // Without it the error is logged.
+    std::function<void(const std::string &error)> fail;
+};
+
+// Loads assets in the background in three stages: I/O threads map the file through Filesystem
+// and fault it in, decode workers turn it into upload ready data, and the render thread runs the
+// uploads a few per frame under a byte budget. Requests may be made from any thread, threads
+// start with the first one.
+class AssetStreamer {
+public:
+    // decode_thread_count 0 means one per core but the one of the render thread.
+    explicit AssetStreamer(uint32_t io_thread_count = 1, uint32_t decode_thread_count = 0);
+
+    ~AssetStreamer();
+
+    void Request(StreamRequest request);
+
+    // Render thread, once per frame. Runs the uploads of decoded requests, highest priority
+    // first, while they fit into budget bytes; the first always runs so that an asset larger
+    // than the budget still arrives. Returns the bytes uploaded.
+    size_t Update(size_t budget);
+
+    // Whether Update has anything to run.
+    bool HasUploads();
+
+    // Whether no request is in any stage.
+    bool IsIdle();
+
+    // Drops the requests which have not been decoded yet and joins the threads, decodes in
+    // progress are finished first. Nothing is uploaded afterwards.
+    void Stop();
+
+private:
+    struct Job {
+        StreamRequest request;
+        uint64_t sequence = 0;
+        FileView file;
+        size_t upload_size = 0;
+        std::string error;
+    };
+
+    struct JobOrder {
+        bool operator()(const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b) const {
+            if (a->request.priority != b->request.priority) {
+                return a->request.priority < b->request.priority;
+            }
+            return a->sequence > b->sequence;
+        }
+    };
+
+    using JobQueue = std::priority_queue<std::shared_ptr<Job>,
+                                         std::vector<std::shared_ptr<Job>>,
+                                         JobOrder>;
+
+    void RunIo();
+
+    void RunDecode();
+
+private:
+    uint32_t io_thread_count_;
+    uint32_t decode_thread_count_;
+
+    std::mutex mutex_;
+    std::condition_variable io_condition_;
+    std::condition_variable decode_condition_;
+    JobQueue io_queue_;
+    JobQueue decode_queue_;
+    JobQueue upload_queue_;
+    // Jobs a thread is working on.
+    size_t active_count_ = 0;
+    uint64_t next_sequence_ = 0;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_ASSET_STREAMER_H
@@ -0,0 +1,377 @@
+#include "etc2_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+namespace tiny_engine {
+
+namespace {
+
+// Intensity modifiers of the ETC1 compatible modes, a pixel index selects +small, +large,
+// -small or -large.
+const int kColorModifiers[8][2] = {
+        {2,  8},
+        {5,  17},
+        {9,  29},
+        {13, 42},
+        {18, 60},
+        {24, 80},
+        {33, 106},
+        {47, 183}
+};
+
+const int kAlphaModifiers[16][8] = {
+        {-3, -6, -9,  -15, 2, 5, 8, 14},
+        {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8,  -13, 1, 4, 7, 12},
+        {-2, -4, -6,  -13, 1, 3, 5, 12},
+        {-3, -6, -8,  -12, 2, 5, 7, 11},
+        {-3, -7, -9,  -11, 2, 6, 8, 10},
+        {-4, -7, -8,  -11, 3, 6, 7, 10},
+        {-3, -5, -8,  -11, 2, 4, 7, 10},
+        {-2, -6, -8,  -10, 1, 5, 7, 9},
+        {-2, -5, -8,  -10, 1, 4, 7, 9},
+        {-2, -4, -8,  -10, 1, 3, 7, 9},
+        {-2, -5, -7,  -10, 1, 4, 6, 9},
+        {-3, -4, -7,  -10, 2, 3, 6, 9},
+        {-1, -2, -3,  -10, 0, 1, 2, 9},
+        {-4, -6, -8,  -9,  3, 5, 7, 8},
+        {-3, -5, -7,  -9,  2, 4, 6, 8}
+};
+
+int Clamp255(int value) {
+    return std::min(std::max(value, 0), 255);
+}
+
+// Best modifier table and per pixel modifiers of an 8 pixel half block around base.
+struct HalfBlockFit {
+    uint32_t error = UINT_MAX;
+    int table = 0;
+    int modifiers[8] = {};
+};
+
+HalfBlockFit FitHalfBlock(const int pixels[8][3], const int base[3]) {
+    HalfBlockFit best;
+    for (int table = 0; table < 8; table++) {
+        HalfBlockFit fit;
+        fit.error = 0;
+        fit.table = table;
+        for (int i = 0; i < 8 && fit.error < best.error; i++) {
+            uint32_t best_error = UINT_MAX;
+            for (int modifier = 0; modifier < 4; modifier++) {
+                int delta = kColorModifiers[table][modifier & 1] * (modifier & 2 ? -1 : 1);
+                uint32_t error = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = Clamp255(base[c] + delta) - pixels[i][c];
+                    error += static_cast<uint32_t>(d * d);
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    fit.modifiers[i] = modifier;
+                }
+            }
+            fit.error += best_error;
+        }
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+int Expand4(int value) {
+    return (value << 4) | value;
+}
+
+int Expand5(int value) {
+    return (value << 3) | (value >> 2);
+}
+
+int Quantize(float value, int max) {
+    return std::min(std::max(static_cast<int>(value * max / 255.0f + 0.5f), 0), max);
+}
+
+// Pixel index j of the block selector bits is x * 4 + y.
+void WriteColorBlock(uint8_t *destination,
+                     const uint8_t header[4],
+                     const int pixel_index[2][8],
+                     const HalfBlockFit fits[2]) {
+    uint32_t msb = 0;
+    uint32_t lsb = 0;
+    for (int half = 0; half < 2; half++) {
+        for (int i = 0; i < 8; i++) {
+            int modifier = fits[half].modifiers[i];
+            msb |= static_cast<uint32_t>(modifier >> 1) << pixel_index[half][i];
+            lsb |= static_cast<uint32_t>(modifier & 1) << pixel_index[half][i];
+        }
+    }
+    memcpy(destination, header, 4);
+    destination[4] = static_cast<uint8_t>(msb >> 8);
+    destination[5] = static_cast<uint8_t>(msb);
+    destination[6] = static_cast<uint8_t>(lsb >> 8);
+    destination[7] = static_cast<uint8_t>(lsb);
+}
+
+void ReadBlock(uint8_t *block,
+               const uint8_t *pixels,
+               uint32_t width,
+               uint32_t height,
+               uint32_t block_x,
+               uint32_t block_y) {
+    for (uint32_t y = 0; y < kEtc2BlockDimension; y++) {
+        uint32_t source_y = std::min(block_y * kEtc2BlockDimension + y, height - 1);
+        for (uint32_t x = 0; x < kEtc2BlockDimension; x++) {
+            uint32_t source_x = std::min(block_x * kEtc2BlockDimension + x, width - 1);
+            memcpy(block + (y * kEtc2BlockDimension + x) * 4,
+                   pixels + (static_cast<size_t>(source_y) * width + source_x) * 4,
+                   4);
+        }
+    }
+}
+
+struct EncodeJob {
+    uint8_t *destination;
+    const uint8_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_row;
+};
+
+// Encodes the block rows of all jobs, which are numbered consecutively, on thread_count threads.
+void EncodeJobs(const std::vector<EncodeJob> &jobs,
+                uint32_t row_count,
+                bool alpha,
+                uint32_t thread_count) {
+    std::atomic<uint32_t> next_row(0);
+    auto worker = [&]() {
+        uint8_t block[kEtc2BlockDimension * kEtc2BlockDimension * 4];
+        size_t block_size = GetEtc2BlockSize(alpha);
+        for (uint32_t row = next_row++; row < row_count; row = next_row++) {
+            size_t j = jobs.size() - 1;
+            while (jobs[j].first_row > row) {
+                j--;
+            }
+            const EncodeJob &job = jobs[j];
+            uint32_t block_y = row - job.first_row;
+            uint32_t blocks_x = (job.width + kEtc2BlockDimension - 1) / kEtc2BlockDimension;
+            uint8_t *destination = job.destination + block_y * blocks_x * block_size;
+            for (uint32_t block_x = 0; block_x < blocks_x; block_x++) {
+                ReadBlock(block, job.pixels, job.width, job.height, block_x, block_y);
+                if (alpha) {
+                    EncodeEacAlphaBlock(destination, block);
+                    destination += 8;
+                }
+                EncodeEtc2ColorBlock(destination, block);
+                destination += 8;
+            }
+        }
+    };
+
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    thread_count = std::min(thread_count, row_count);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+} // namespace
+
+bool HasAlpha(const uint8_t *pixels, size_t pixel_count) {
+    for (size_t i = 0; i < pixel_count; i++) {
+        if (pixels[i * 4 + 3] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void EncodeEtc2ColorBlock(uint8_t *destination, const uint8_t *block) {
+    uint32_t best_error = UINT_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        // Without flip the halves are the left and right 2x4 columns, with it the top and
+        // bottom 4x2 rows.
+        int pixels[2][8][3];
+        int pixel_index[2][8];
+        float average[2][3] = {};
+        int count[2] = {};
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int half = flip ? y / 2 : x / 2;
+                int i = count[half]++;
+                pixel_index[half][i] = x * 4 + y;
+                for (int c = 0; c < 3; c++) {
+                    pixels[half][i][c] = block[(y * 4 + x) * 4 + c];
+                    average[half][c] += pixels[half][i][c] / 8.0f;
+                }
+            }
+        }
+
+        // Differential mode: 5-bit base colors, the second one within -4..3 of the first.
+        int base5[2][3];
+        int delta[3];
+        for (int c = 0; c < 3; c++) {
+            base5[0][c] = Quantize(average[0][c], 31);
+            delta[c] = std::min(std::max(Quantize(average[1][c], 31) - base5[0][c], -4), 3);
+            base5[1][c] = base5[0][c] + delta[c];
+        }
+        int base[2][3];
+        for (int half = 0; half < 2; half++) {
+            for (int c = 0; c < 3; c++) {
+                base[half][c] = Expand5(base5[half][c]);
+            }
+        }
+        HalfBlockFit fits[2] = {FitHalfBlock(pixels[0], base[0]),
+                                FitHalfBlock(pixels[1], base[1])};
+        if (fits[0].error + fits[1].error < best_error) {
+            best_error = fits[0].error + fits[1].error;
+            uint8_t header[4];
+            for (int c = 0; c < 3; c++) {
+                header[c] = static_cast<uint8_t>((base5[0][c] << 3) | (delta[c] & 7));
+            }
+            header[3] = static_cast<uint8_t>((fits[0].table << 5) | (fits[1].table << 2) | 2
+                                             | flip);
+            WriteColorBlock(destination, header, pixel_index, fits);
+        }
+
+        // Individual mode: independent 4-bit base colors.
+        int base4[2][3];
+        for (int half = 0; half < 2; half++) {
+            for (int c = 0; c < 3; c++) {
+                base4[half][c] = Quantize(average[half][c], 15);
+                base[half][c] = Expand4(base4[half][c]);
+            }
+        }
+        fits[0] = FitHalfBlock(pixels[0], base[0]);
+        fits[1] = FitHalfBlock(pixels[1], base[1]);
+        if (fits[0].error + fits[1].error < best_error) {
+            best_error = fits[0].error + fits[1].error;
+            uint8_t header[4];
+            for (int c = 0; c < 3; c++) {
+                header[c] = static_cast<uint8_t>((base4[0][c] << 4) | base4[1][c]);
+            }
+            header[3] = static_cast<uint8_t>((fits[0].table << 5) | (fits[1].table << 2) | flip);
+            WriteColorBlock(destination, header, pixel_index, fits);
+        }
+    }
+}
+
+void EncodeEacAlphaBlock(uint8_t *destination, const uint8_t *block) {
+    // Alpha values in selector order, pixel j is x * 4 + y.
+    int alpha[16];
+    int min_alpha = 255;
+    int max_alpha = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            alpha[x * 4 + y] = block[(y * 4 + x) * 4 + 3];
+            min_alpha = std::min(min_alpha, alpha[x * 4 + y]);
+            max_alpha = std::max(max_alpha, alpha[x * 4 + y]);
+        }
+    }
+
+    uint32_t best_error = UINT_MAX;
+    int best_base = min_alpha;
+    int best_multiplier = 1;
+    int best_table = 13;
+    uint64_t best_selectors = 0;
+    for (int table = 0; table < 16 && best_error > 0; table++) {
+        const int *modifiers = kAlphaModifiers[table];
+        int span = modifiers[7] - modifiers[3];
+        int multiplier = std::max((max_alpha - min_alpha + span - 1) / span, 1);
+        // The multiplier covering the range exactly and its neighbors, a zero multiplier is
+        // not allowed.
+        for (int m = std::max(multiplier - 1, 1); m <= std::min(multiplier + 1, 15); m++) {
+            int center = (min_alpha + max_alpha + 1) / 2 - (modifiers[3] + modifiers[7]) * m / 2;
+            for (int b = center - 2; b <= center + 2; b++) {
+                int base = Clamp255(b);
+                uint32_t error = 0;
+                uint64_t selectors = 0;
+                for (int i = 0; i < 16 && error < best_error; i++) {
+                    uint32_t pixel_error = UINT_MAX;
+                    int selector = 0;
+                    for (int s = 0; s < 8; s++) {
+                        int d = Clamp255(base + modifiers[s] * m) - alpha[i];
+                        if (static_cast<uint32_t>(d * d) < pixel_error) {
+                            pixel_error = static_cast<uint32_t>(d * d);
+                            selector = s;
+                        }
+                    }
+                    error += pixel_error;
+                    selectors |= static_cast<uint64_t>(selector) << (45 - 3 * i);
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    best_base = base;
+                    best_multiplier = m;
+                    best_table = table;
+                    best_selectors = selectors;
+                }
+            }
+        }
+    }
+
+    destination[0] = static_cast<uint8_t>(best_base);
+    destination[1] = static_cast<uint8_t>((best_multiplier << 4) | best_table);
+    for (int i = 0; i < 6; i++) {
+        destination[2 + i] = static_cast<uint8_t>(best_selectors >> (40 - 8 * i));
+    }
+}
+
+void EncodeEtc2Image(uint8_t *destination,
+                     const uint8_t *pixels,
+                     uint32_t width,
+                     uint32_t height,
+                     bool alpha,
+                     uint32_t thread_count) {
+    std::vector<EncodeJob> jobs = {{destination, pixels, width, height, 0}};
+    EncodeJobs(jobs,
+               (height + kEtc2BlockDimension - 1) / kEtc2BlockDimension,
+               alpha,
+               thread_count);
+}
+
+std::vector<uint8_t> EncodeEtc2MipChain(const uint8_t *pixels,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        uint32_t mip_levels,
+                                        bool alpha,
+                                        bool srgb,
+                                        uint32_t thread_count) {
+    std::vector<uint8_t> chain(GetMipChainSize(width, height, mip_levels, 4));
+    GenerateMipChain(chain.data(), pixels, width, height, mip_levels, srgb);
+
+    std::vector<MipLevel> levels = GetMipChainLayout(width, height, mip_levels, 4);
+    std::vector<MipLevel> blocks = GetMipChainLayout(width,
+                                                     height,
+                                                     mip_levels,
+                                                     GetEtc2BlockSize(alpha),
+                                                     kEtc2BlockDimension);
+    std::vector<uint8_t> encoded(GetMipChainSize(width,
+                                                 height,
+                                                 mip_levels,
+                                                 GetEtc2BlockSize(alpha),
+                                                 kEtc2BlockDimension));
+    std::vector<EncodeJob> jobs;
+    uint32_t row_count = 0;
+    for (uint32_t i = 0; i < mip_levels; i++) {
+        jobs.push_back({encoded.data() + blocks[i].offset,
+                        chain.data() + levels[i].offset,
+                        levels[i].width,
+                        levels[i].height,
+                        row_count});
+        row_count += (levels[i].height + kEtc2BlockDimension - 1) / kEtc2BlockDimension;
+    }
+    EncodeJobs(jobs, row_count, alpha, thread_count);
+    return encoded;
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,52 @@
+#ifndef TINY_ENGINE_ETC2_ENCODER_H
+#define TINY_ENGINE_ETC2_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mip_chain.h"
+
+namespace tiny_engine {
+
+// ETC2 and EAC work on 4x4 pixel blocks.
+const uint32_t kEtc2BlockDimension = 4;
+
+// Bytes per block of VK_FORMAT_ETC2_R8G8B8A8_* (with alpha) or VK_FORMAT_ETC2_R8G8B8_*.
+inline size_t GetEtc2BlockSize(bool alpha) { return alpha ? 16 : 8; }
+
+// Whether any of the pixel_count RGBA8 pixels is not opaque.
+bool HasAlpha(const uint8_t *pixels, size_t pixel_count);
+
+// Encodes one 4x4 block of RGBA8 pixels (row major, 64 bytes) with the ETC1 compatible
+// individual and differential modes of ETC2, choosing block split, base colors and modifier
+// tables for the least squared error. Writes 8 bytes.
+void EncodeEtc2ColorBlock(uint8_t *destination, const uint8_t *block);
+
+// Encodes the alpha channel of one 4x4 RGBA8 block as an EAC alpha block. Writes 8 bytes.
+void EncodeEacAlphaBlock(uint8_t *destination, const uint8_t *block);
+
+// Encodes an RGBA8 image to ETC2 RGB8 or, with alpha, ETC2 RGBA8 blocks in row major block
+// order. Partial blocks at the right and bottom edges repeat the last column or row. The blocks
+// are spread over thread_count threads (0 means one per core).
+void EncodeEtc2Image(uint8_t *destination,
+                     const uint8_t *pixels,
+                     uint32_t width,
+                     uint32_t height,
+                     bool alpha,
+                     uint32_t thread_count = 0);
+
+// Builds the mip chain of an RGBA8 image with GenerateMipChain and encodes every level, all
+// levels sharing the worker threads. The result is laid out as
+// GetMipChainLayout(width, height, mip_levels, GetEtc2BlockSize(alpha), kEtc2BlockDimension).
+std::vector<uint8_t> EncodeEtc2MipChain(const uint8_t *pixels,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        uint32_t mip_levels,
+                                        bool alpha,
+                                        bool srgb,
+                                        uint32_t thread_count = 0);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_ETC2_ENCODER_H
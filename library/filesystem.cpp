@@ -1,26 +1,163 @@
 #include "filesystem.h"
 
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "asset_pack.h"
+
 namespace tiny_engine {
 
+static FileView MapFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file " + path + "!");
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("failed to stat file " + path + "!");
+    }
+    size_t file_length = static_cast<size_t>(file_stat.st_size);
+    if (file_length == 0) {
+        close(fd);
+        return FileView();
+    }
+
+    void *mapping = mmap(nullptr, file_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("failed to map file " + path + "!");
+    }
+    std::shared_ptr<const void> holder(mapping, [file_length](const void *address) {
+        munmap(const_cast<void *>(address), file_length);
+    });
+    return FileView(holder, mapping, file_length);
+}
+
 std::unique_ptr<Filesystem> Filesystem::instance_;
 
 void Filesystem::Init(void *context) {
     context_ = context;
+    packs_.clear();
+#ifndef ANDROID
+    root_ = context == nullptr ? "" : static_cast<const char *>(context);
+    if (!root_.empty() && root_.back() != '/') {
+        root_ += '/';
+    }
+#endif
 }
 
-void Filesystem::Read(const std::string &filename, std::string &content) {
+FileView Filesystem::Map(const std::string &filename) {
+    FileView view;
+    for (const std::shared_ptr<AssetPack> &pack : packs_) {
+        if (pack->Map(filename, view)) {
+            return view;
+        }
+    }
 #ifdef ANDROID
     if (context_ == nullptr) {
         throw std::runtime_error("Call function Init first on Android platform!");
     }
     auto   *asset_manager = static_cast<AAssetManager *>(context_);
     AAsset *file          = AAssetManager_open(asset_manager, filename.c_str(), AASSET_MODE_BUFFER);
-    size_t file_length    = AAsset_getLength(file);
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open asset " + filename + "!");
+    }
+    std::shared_ptr<AAsset> asset(file, AAsset_close);
+    size_t file_length = AAsset_getLength(file);
 
-    content.resize(file_length);
+    // Uncompressed assets are mmapped straight out of the APK, compressed ones are inflated
+    // once into a buffer owned by the asset, either way no extra copy is made here.
+    const void *buffer = AAsset_getBuffer(file);
+    if (buffer == nullptr) {
+        throw std::runtime_error("failed to read asset " + filename + "!");
+    }
+    return FileView(asset, buffer, file_length);
+#else
+    return MapFile(root_ + filename);
+#endif
+}
 
-    AAsset_read(file, &content[0], file_length);
+bool Filesystem::Exists(const std::string &filename) {
+    for (const std::shared_ptr<AssetPack> &pack : packs_) {
+        if (pack->Contains(filename)) {
+            return true;
+        }
+    }
+#ifdef ANDROID
+    if (context_ == nullptr) {
+        throw std::runtime_error("Call function Init first on Android platform!");
+    }
+    AAsset *file = AAssetManager_open(static_cast<AAssetManager *>(context_),
+                                      filename.c_str(),
+                                      AASSET_MODE_UNKNOWN);
+    if (file == nullptr) {
+        return false;
+    }
+    AAsset_close(file);
+    return true;
+#else
+    return access((root_ + filename).c_str(), R_OK) == 0;
 #endif
 }
 
+bool Filesystem::Mount(const std::string &filename) {
+    auto pack = std::make_shared<AssetPack>();
+    if (!pack->Load(Map(filename))) {
+        return false;
+    }
+    packs_.insert(packs_.begin(), pack);
+    return true;
+}
+
+void Filesystem::Prefetch(const std::vector<std::string> &filenames) {
+    for (const std::shared_ptr<AssetPack> &pack : packs_) {
+        pack->Prefetch(filenames);
+    }
+}
+
+void Filesystem::SetDataPath(const std::string &data_path) {
+    data_path_ = data_path;
+    if (!data_path_.empty() && data_path_.back() != '/') {
+        data_path_ += '/';
+    }
+}
+
+FileView Filesystem::MapData(const std::string &filename) {
+    if (data_path_.empty()) return FileView();
+
+    std::string path = data_path_ + filename;
+    if (access(path.c_str(), R_OK) != 0) {
+        return FileView();
+    }
+    return MapFile(path);
+}
+
+bool Filesystem::WriteData(const std::string &filename, const void *data, size_t size) {
+    if (data_path_.empty()) return false;
+
+    std::string path = data_path_ + filename;
+    std::string temp_path = path + ".tmp";
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = fwrite(data, 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void Filesystem::Read(const std::string &filename, std::string &content) {
+    FileView view = Map(filename);
+    content.assign(view.As<char>(), view.size());
+}
+
 }
@@ -3,8 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <cstdint>
+#include <cstring>
 
 #ifdef ANDROID
 
@@ -15,6 +18,39 @@
 
 namespace tiny_engine {
 
+// Read-only view of a whole file. The bytes stay valid as long as any copy of the view is alive,
+// they are backed by a memory mapping (or the asset buffer on Android) instead of a heap copy.
+class FileView {
+public:
+    FileView() = default;
+
+    FileView(std::shared_ptr<const void> holder, const void *data, size_t size)
+            : holder_(std::move(holder)),
+              data_(static_cast<const uint8_t *>(data)),
+              size_(size) {}
+
+    const uint8_t *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    template<typename T>
+    const T *As() const { return reinterpret_cast<const T *>(data_); }
+
+    // View of size bytes at offset which keeps the whole file alive.
+    FileView Slice(size_t offset, size_t size) const {
+        return FileView(holder_, data_ + offset, size);
+    }
+
+private:
+    std::shared_ptr<const void> holder_;
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class AssetPack;
+
 class Filesystem {
 public:
     ~Filesystem() {}
@@ -28,26 +64,42 @@ public:
         return *instance_;
     }
 
+    // On Android context is the AAssetManager, elsewhere it is the asset root directory
+    // as a C string (nullptr means the working directory). Unmounts all packs.
     virtual void Init(void *context);
 
+    FileView Map(const std::string &filename);
+
+    // Whether Map would find filename, for optional assets.
+    bool Exists(const std::string &filename);
+
+    // Serves the assets of the pack file filename (see AssetPack) ahead of loose assets, all
+    // from one mapping of the pack. Later mounts take precedence. Mount before other threads
+    // use the Filesystem. Returns false if filename is not a valid pack.
+    bool Mount(const std::string &filename);
+
+    // Starts reading the mounted data of filenames ahead of their Map, e.g. the assets of a
+    // scene which are stored next to each other in a pack.
+    void Prefetch(const std::vector<std::string> &filenames);
+
+    // Writable per-install directory (Context.getDataDir() on Android) for caches which are
+    // produced at runtime, e.g. the pipeline cache. Unset means nothing is persisted.
+    void SetDataPath(const std::string &data_path);
+
+    // Maps filename from the data directory, returns an empty view if it does not exist yet.
+    FileView MapData(const std::string &filename);
+
+    // Replaces filename in the data directory, the old content stays intact if writing fails
+    // half way. Returns false if there is no data directory or the write failed.
+    bool WriteData(const std::string &filename, const void *data, size_t size);
 
     void Read(const std::string &filename, std::string &content);
 
     template<typename T>
     auto Read(const std::string &filename) -> std::vector<T> {
-        std::vector<T> file_content;
-#ifdef ANDROID
-        if (context_ == nullptr) {
-            throw std::runtime_error("Call function Init first on Android platform!");
-        }
-        auto   *asset_manager = static_cast<AAssetManager *>(context_);
-        AAsset *file          = AAssetManager_open(asset_manager, filename.c_str(),
-                                                   AASSET_MODE_BUFFER);
-        size_t file_length    = AAsset_getLength(file);
-        file_content.resize(file_length / sizeof(T));
-
-        AAsset_read(file, file_content.data(), file_length);
-#endif
+        FileView view = Map(filename);
+        std::vector<T> file_content(view.size() / sizeof(T));
+        memcpy(file_content.data(), view.data(), file_content.size() * sizeof(T));
         return file_content;
     }
 
@@ -61,7 +113,10 @@ private:
 
     static std::unique_ptr<Filesystem> instance_;
 
-    void *context_;
+    void *context_ = nullptr;
+    std::string root_;
+    std::string data_path_;
+    std::vector<std::shared_ptr<AssetPack>> packs_;
 };
 
 } // namespace tiny_engine
@@ -0,0 +1,108 @@
+#include "image_decode_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "image_decoder.h"
+
+namespace tiny_engine {
+
+namespace {
+
+DecodedImage GetDecodedImage(const FileView &file, ImageInfo &info) {
+    if (!GetImageInfo(file.data(), file.size(), info)) {
+        throw std::runtime_error("failed to decode image!");
+    }
+    DecodedImage image;
+    image.width = info.width;
+    image.height = info.height;
+    image.alpha = info.alpha;
+    return image;
+}
+
+} // namespace
+
+DecodedImage DecodeImageFile(const FileView &file) {
+    ImageInfo info;
+    DecodedImage image = GetDecodedImage(file, info);
+    image.pixels.resize(GetDecodeBufferSize(info));
+    if (!DecodeImage(file.data(), file.size(), image.pixels.data(), image.pixels.size())) {
+        throw std::runtime_error("failed to decode image!");
+    }
+    return image;
+}
+
+DecodedImage DecodeImageFile(const FileView &file, uint8_t *destination, size_t destination_size) {
+    ImageInfo info;
+    DecodedImage image = GetDecodedImage(file, info);
+    if (destination_size < GetDecodeBufferSize(info)
+        || !DecodeImage(file.data(), file.size(), destination, destination_size)) {
+        throw std::runtime_error("failed to decode image!");
+    }
+    return image;
+}
+
+ImageDecodePool::ImageDecodePool(uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads_.emplace_back(&ImageDecodePool::Run, this);
+    }
+}
+
+ImageDecodePool::~ImageDecodePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+}
+
+ImageDecodePool &ImageDecodePool::GetInstance() {
+    static ImageDecodePool s_pool;
+    return s_pool;
+}
+
+std::future<DecodedImage> ImageDecodePool::Submit(FileView file) {
+    return Submit(std::packaged_task<DecodedImage()>([file]() { return DecodeImageFile(file); }));
+}
+
+std::future<DecodedImage> ImageDecodePool::Submit(FileView file,
+                                                  uint8_t *destination,
+                                                  size_t destination_size) {
+    return Submit(std::packaged_task<DecodedImage()>([file, destination, destination_size]() {
+        return DecodeImageFile(file, destination, destination_size);
+    }));
+}
+
+std::future<DecodedImage> ImageDecodePool::Submit(std::packaged_task<DecodedImage()> job) {
+    std::future<DecodedImage> result = job.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    condition_.notify_one();
+    return result;
+}
+
+void ImageDecodePool::Run() {
+    for (;;) {
+        std::packaged_task<DecodedImage()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,76 @@
+#ifndef TINY_ENGINE_IMAGE_DECODE_POOL_H
+#define TINY_ENGINE_IMAGE_DECODE_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "filesystem.h"
+
+namespace tiny_engine {
+
+struct DecodedImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Whether the file has an alpha channel, see ImageInfo.
+    bool alpha = false;
+    // RGBA8, row major. May be a few bytes longer than width * height * 4. Empty if the image
+    // was decoded to a destination of the caller.
+    std::vector<uint8_t> pixels;
+};
+
+// Decodes file on the calling thread. Throws std::runtime_error if file is not an image
+// stb_image can decode.
+DecodedImage DecodeImageFile(const FileView &file);
+
+// Decodes file on the calling thread straight into the destination_size bytes at destination,
+// e.g. mapped staging memory, which needs GetDecodeBufferSize bytes for the image. Throws
+// std::runtime_error if file is not an image stb_image can decode or does not fit.
+DecodedImage DecodeImageFile(const FileView &file, uint8_t *destination, size_t destination_size);
+
+// Worker threads decoding encoded images (anything DecodeImage reads) in the background, so
+// several textures decode at once and while the device and pipelines are created. Jobs run in
+// submission order.
+class ImageDecodePool {
+public:
+    // thread_count 0 means one worker per core.
+    explicit ImageDecodePool(uint32_t thread_count = 0);
+
+    // Finishes the queued jobs, then joins the workers.
+    ~ImageDecodePool();
+
+    // Pool shared by the application, created on first use.
+    static ImageDecodePool &GetInstance();
+
+    // Decodes file on a worker, the view keeps the bytes alive until then. The future throws
+    // std::runtime_error if file is not an image stb_image can decode.
+    std::future<DecodedImage> Submit(FileView file);
+
+    // Decodes file on a worker into destination, see DecodeImageFile. destination must stay
+    // valid until the future is ready.
+    std::future<DecodedImage> Submit(FileView file, uint8_t *destination, size_t destination_size);
+
+private:
+    ImageDecodePool(const ImageDecodePool &) = delete;
+
+    ImageDecodePool &operator=(const ImageDecodePool &) = delete;
+
+    std::future<DecodedImage> Submit(std::packaged_task<DecodedImage()> job);
+
+    void Run();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<std::packaged_task<DecodedImage()>> jobs_;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_IMAGE_DECODE_POOL_H
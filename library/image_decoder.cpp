@@ -0,0 +1,125 @@
+#include "image_decoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "log.h"
+
+namespace tiny_engine {
+
+namespace {
+
+// Output buffer of the decode running on this thread. The first allocation stb makes with the
+// size of the RGBA8 result (JPEG adds one byte) is served from it; that is the buffer stb returns
+// for every layout it decodes to 8-bit RGBA directly or converts at the end.
+struct DecodeTarget {
+    uint8_t *destination = nullptr;
+    size_t capacity = 0;
+    size_t result_size = 0;
+    size_t served_size = 0;
+};
+
+thread_local DecodeTarget t_target;
+
+void *DecodeMalloc(size_t size) {
+    DecodeTarget &target = t_target;
+    if (target.destination != nullptr && target.served_size == 0
+        && size >= target.result_size && size <= target.capacity) {
+        target.served_size = size;
+        return target.destination;
+    }
+    return malloc(size);
+}
+
+void *DecodeRealloc(void *pointer, size_t size) {
+    DecodeTarget &target = t_target;
+    if (pointer != nullptr && pointer == target.destination && target.served_size != 0) {
+        // Not the result after all, move it to the heap.
+        void *moved = malloc(size);
+        if (moved != nullptr) {
+            memcpy(moved, pointer, std::min(size, target.served_size));
+            target.served_size = 0;
+            target.destination = nullptr;
+        }
+        return moved;
+    }
+    return realloc(pointer, size);
+}
+
+void DecodeFree(void *pointer) {
+    if (pointer != nullptr && pointer == t_target.destination) {
+        return;
+    }
+    free(pointer);
+}
+
+} // namespace
+
+} // namespace tiny_engine
+
+#define STBI_MALLOC(size) tiny_engine::DecodeMalloc(size)
+#define STBI_REALLOC(pointer, size) tiny_engine::DecodeRealloc(pointer, size)
+#define STBI_FREE(pointer) tiny_engine::DecodeFree(pointer)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace tiny_engine {
+
+bool GetImageInfo(const void *data, size_t size, ImageInfo &info) {
+    int width, height, channels;
+    if (!stbi_info_from_memory(static_cast<const stbi_uc *>(data),
+                               static_cast<int>(size),
+                               &width,
+                               &height,
+                               &channels)) {
+        return false;
+    }
+    info.width = static_cast<uint32_t>(width);
+    info.height = static_cast<uint32_t>(height);
+    info.alpha = channels == 2 || channels == 4;
+    return true;
+}
+
+size_t GetDecodeBufferSize(const ImageInfo &info) {
+    return static_cast<size_t>(info.width) * info.height * 4 + 1;
+}
+
+bool DecodeImage(const void *data, size_t size, uint8_t *destination, size_t destination_size) {
+    int width, height, channels;
+    if (!stbi_info_from_memory(static_cast<const stbi_uc *>(data),
+                               static_cast<int>(size),
+                               &width,
+                               &height,
+                               &channels)) {
+        return false;
+    }
+    size_t result_size = static_cast<size_t>(width) * height * 4;
+    if (destination_size < result_size) {
+        return false;
+    }
+
+    t_target.destination = destination;
+    t_target.capacity = destination_size;
+    t_target.result_size = result_size;
+    t_target.served_size = 0;
+    stbi_uc *pixels = stbi_load_from_memory(static_cast<const stbi_uc *>(data),
+                                            static_cast<int>(size),
+                                            &width,
+                                            &height,
+                                            &channels,
+                                            STBI_rgb_alpha);
+    bool in_place = pixels == destination;
+    t_target = DecodeTarget();
+    if (pixels == nullptr) {
+        return false;
+    }
+    if (!in_place) {
+        LOGD("Image decoded to a separate buffer, copying");
+        memcpy(destination, pixels, result_size);
+        stbi_image_free(pixels);
+    }
+    return true;
+}
+
+} // namespace tiny_engine
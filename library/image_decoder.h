@@ -0,0 +1,32 @@
+#ifndef TINY_ENGINE_IMAGE_DECODER_H
+#define TINY_ENGINE_IMAGE_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tiny_engine {
+
+struct ImageInfo {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Whether the file has an alpha channel, its pixels may still all be opaque.
+    bool alpha = false;
+};
+
+// Reads the size of an encoded image (any format stb_image supports) without decoding it.
+bool GetImageInfo(const void *data, size_t size, ImageInfo &info);
+
+// Bytes DecodeImage needs at destination: the RGBA8 pixels plus the byte stb_image reserves past
+// the end of JPEG output.
+size_t GetDecodeBufferSize(const ImageInfo &info);
+
+// Decodes an image to tightly packed RGBA8 pixels at destination, which needs
+// GetDecodeBufferSize bytes and may be mapped staging memory. stb_image allocates its result
+// through hooks which hand out destination itself, so no heap image is made and nothing is
+// copied; images stb finishes in a buffer of its own are copied over instead. Safe to call on
+// several threads at once.
+bool DecodeImage(const void *data, size_t size, uint8_t *destination, size_t destination_size);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_IMAGE_DECODER_H
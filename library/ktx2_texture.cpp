@@ -0,0 +1,341 @@
+#include "ktx2_texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "log.h"
+
+namespace tiny_engine {
+
+namespace {
+
+const uint8_t kIdentifier[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// Identifier, 13 32-bit header and index fields and the two 64-bit supercompression global
+// data fields, the level index follows.
+const size_t kLevelIndexOffset = 80;
+
+// Larger than maxImageDimension2D of any mobile GPU, bounds the level sizes a header can claim.
+const uint32_t kMaxDimension = 16384;
+
+// zlib cannot compress by more than this, a larger inflated length is a corrupted file.
+const uint64_t kMaxZlibRatio = 1032;
+
+struct LevelIndex {
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+// Bytes per texel block and block width and height.
+struct FormatBlock {
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// The uncompressed and block compressed color formats a KTX2 texture may have, false for
+// depth/stencil, multi-planar and formats not listed.
+bool GetFormatBlock(VkFormat format, FormatBlock &block) {
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SNORM:
+        case VK_FORMAT_R8_UINT:
+        case VK_FORMAT_R8_SINT:
+        case VK_FORMAT_R8_SRGB:
+            block = {1, 1, 1};
+            return true;
+        case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
+        case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
+        case VK_FORMAT_R5G6B5_UNORM_PACK16:
+        case VK_FORMAT_B5G6R5_UNORM_PACK16:
+        case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
+        case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
+        case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SNORM:
+        case VK_FORMAT_R8G8_UINT:
+        case VK_FORMAT_R8G8_SINT:
+        case VK_FORMAT_R8G8_SRGB:
+        case VK_FORMAT_R16_UNORM:
+        case VK_FORMAT_R16_SNORM:
+        case VK_FORMAT_R16_UINT:
+        case VK_FORMAT_R16_SINT:
+        case VK_FORMAT_R16_SFLOAT:
+            block = {2, 1, 1};
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SNORM:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_R8G8B8A8_SINT:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_R16G16_UNORM:
+        case VK_FORMAT_R16G16_SNORM:
+        case VK_FORMAT_R16G16_UINT:
+        case VK_FORMAT_R16G16_SINT:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32_SINT:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+            block = {4, 1, 1};
+            return true;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R16G16B16A16_SNORM:
+        case VK_FORMAT_R16G16B16A16_UINT:
+        case VK_FORMAT_R16G16B16A16_SINT:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_UINT:
+        case VK_FORMAT_R32G32_SINT:
+        case VK_FORMAT_R32G32_SFLOAT:
+            block = {8, 1, 1};
+            return true;
+        case VK_FORMAT_R32G32B32A32_UINT:
+        case VK_FORMAT_R32G32B32A32_SINT:
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            block = {16, 1, 1};
+            return true;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+        case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+        case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+            block = {8, 4, 4};
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+        case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+            block = {16, 4, 4};
+            return true;
+        case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:
+            block = {16, 5, 4};
+            return true;
+        case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+            block = {16, 5, 5};
+            return true;
+        case VK_FORMAT_ASTC_6x5_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:
+            block = {16, 6, 5};
+            return true;
+        case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+            block = {16, 6, 6};
+            return true;
+        case VK_FORMAT_ASTC_8x5_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:
+            block = {16, 8, 5};
+            return true;
+        case VK_FORMAT_ASTC_8x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:
+            block = {16, 8, 6};
+            return true;
+        case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+            block = {16, 8, 8};
+            return true;
+        case VK_FORMAT_ASTC_10x5_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:
+            block = {16, 10, 5};
+            return true;
+        case VK_FORMAT_ASTC_10x6_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:
+            block = {16, 10, 6};
+            return true;
+        case VK_FORMAT_ASTC_10x8_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:
+            block = {16, 10, 8};
+            return true;
+        case VK_FORMAT_ASTC_10x10_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
+            block = {16, 10, 10};
+            return true;
+        case VK_FORMAT_ASTC_12x10_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
+            block = {16, 12, 10};
+            return true;
+        case VK_FORMAT_ASTC_12x12_UNORM_BLOCK:
+        case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+            block = {16, 12, 12};
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Size of a level of width x height pixels, partial blocks at the edges take a whole block.
+uint64_t GetLevelSize(const FormatBlock &block, uint32_t width, uint32_t height) {
+    uint64_t blocks_x = (width + block.width - 1) / block.width;
+    uint64_t blocks_y = (height + block.height - 1) / block.height;
+    return blocks_x * blocks_y * block.size;
+}
+
+uint32_t ReadUint32(const uint8_t *data, size_t offset) {
+    uint32_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool Ktx2Texture::Load(const FileView &file) {
+    file_ = FileView();
+    inflated_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    format_ = VK_FORMAT_UNDEFINED;
+    levels_.clear();
+    generate_mipmaps_ = false;
+    if (file.size() < kLevelIndexOffset || memcmp(file.data(), kIdentifier, sizeof(kIdentifier))) {
+        LOGW("Not a KTX2 file");
+        return false;
+    }
+
+    const uint8_t *data = file.data();
+    auto format = static_cast<VkFormat>(ReadUint32(data, 12));
+    uint32_t width = ReadUint32(data, 20);
+    uint32_t height = std::max(ReadUint32(data, 24), 1u);
+    uint32_t depth = ReadUint32(data, 28);
+    uint32_t layer_count = ReadUint32(data, 32);
+    uint32_t face_count = ReadUint32(data, 36);
+    uint32_t level_count = ReadUint32(data, 40);
+    auto scheme = static_cast<Ktx2Supercompression>(ReadUint32(data, 44));
+
+    if (format == VK_FORMAT_UNDEFINED || scheme == Ktx2Supercompression::kBasisLz) {
+        LOGW("KTX2 Basis Universal textures are not supported");
+        return false;
+    }
+    if (scheme == Ktx2Supercompression::kZstandard) {
+        LOGW("KTX2 Zstandard supercompression is not supported");
+        return false;
+    }
+    if (scheme != Ktx2Supercompression::kNone && scheme != Ktx2Supercompression::kZlib) {
+        LOGW("Unknown KTX2 supercompression scheme %u", static_cast<uint32_t>(scheme));
+        return false;
+    }
+    if (width == 0 || depth > 1 || layer_count > 1 || face_count != 1) {
+        LOGW("Only 2D KTX2 textures are supported");
+        return false;
+    }
+    FormatBlock block;
+    if (!GetFormatBlock(format, block)) {
+        LOGW("KTX2 format %d is not supported", format);
+        return false;
+    }
+    if (width > kMaxDimension || height > kMaxDimension) {
+        LOGW("KTX2 texture of %ux%u is too large", width, height);
+        return false;
+    }
+
+    generate_mipmaps_ = level_count == 0;
+    level_count = std::max(level_count, 1u);
+    if (level_count > GetMipLevelCount(width, height)
+        || kLevelIndexOffset + level_count * sizeof(LevelIndex) > file.size()) {
+        LOGW("KTX2 level index is corrupted");
+        return false;
+    }
+    std::vector<LevelIndex> index(level_count);
+    memcpy(index.data(), data + kLevelIndexOffset, level_count * sizeof(LevelIndex));
+
+    // Every level must hold exactly the blocks of its extent, so the copy to the image never
+    // reads past it. Levels without supercompression are aligned to the least common multiple
+    // of the block size and 4, which is the larger of the two for the power of two block sizes
+    // above, and so are their offsets from the first level once it is aligned.
+    levels_ = GetMipChainLayout(width, height, level_count, 1);
+    uint64_t alignment = std::max(block.size, 4u);
+    for (uint32_t i = 0; i < level_count; i++) {
+        const LevelIndex &level = index[i];
+        uint64_t expected = GetLevelSize(block, levels_[i].width, levels_[i].height);
+        bool valid = level.byte_length != 0 && level.byte_offset <= file.size()
+                     && level.byte_length <= file.size() - level.byte_offset;
+        if (scheme == Ktx2Supercompression::kNone) {
+            valid = valid && level.byte_length == expected && level.byte_offset % alignment == 0;
+        } else {
+            valid = valid && level.uncompressed_byte_length == expected
+                    && expected <= level.byte_length * kMaxZlibRatio;
+        }
+        if (!valid) {
+            LOGW("KTX2 level %u is corrupted", i);
+            levels_.clear();
+            return false;
+        }
+    }
+
+    if (scheme == Ktx2Supercompression::kNone) {
+        // The levels are used in place, smallest first as the specification lays them out.
+        uint64_t begin = file.size();
+        uint64_t end = 0;
+        for (const LevelIndex &level : index) {
+            begin = std::min(begin, level.byte_offset);
+            end = std::max(end, level.byte_offset + level.byte_length);
+        }
+        for (uint32_t i = 0; i < level_count; i++) {
+            levels_[i].offset = static_cast<size_t>(index[i].byte_offset - begin);
+        }
+        file_ = file;
+        data_ = data + begin;
+        size_ = static_cast<size_t>(end - begin);
+    } else {
+        // Inflated level 0 first, 16-byte aligned which satisfies the buffer offset alignment
+        // of vkCmdCopyBufferToImage for every format.
+        uint64_t size = 0;
+        for (uint32_t i = 0; i < level_count; i++) {
+            levels_[i].offset = static_cast<size_t>(size);
+            size = AlignUp(size + index[i].uncompressed_byte_length, 16);
+        }
+        inflated_.resize(static_cast<size_t>(size));
+        for (uint32_t i = 0; i < level_count; i++) {
+            uLongf length = static_cast<uLongf>(index[i].uncompressed_byte_length);
+            if (uncompress(inflated_.data() + levels_[i].offset,
+                           &length,
+                           data + index[i].byte_offset,
+                           static_cast<uLong>(index[i].byte_length)) != Z_OK
+                || length != index[i].uncompressed_byte_length) {
+                LOGW("KTX2 level %u failed to inflate", i);
+                inflated_.clear();
+                levels_.clear();
+                return false;
+            }
+        }
+        data_ = inflated_.data();
+        size_ = inflated_.size();
+    }
+
+    format_ = format;
+    return true;
+}
+
+} // namespace tiny_engine
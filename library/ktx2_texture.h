@@ -0,0 +1,63 @@
+#ifndef TINY_ENGINE_KTX2_TEXTURE_H
+#define TINY_ENGINE_KTX2_TEXTURE_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "filesystem.h"
+#include "mip_chain.h"
+
+namespace tiny_engine {
+
+// Supercompression schemes of the KTX2 header.
+enum class Ktx2Supercompression : uint32_t {
+    kNone = 0,
+    kBasisLz = 1,
+    kZstandard = 2,
+    kZlib = 3
+};
+
+// A 2D texture from a KTX2 container, ready to be copied to an image of its VkFormat. Levels
+// without supercompression are used in place from the file, zlib supercompressed levels are
+// inflated once. BasisLZ and Zstandard are not supported (there is no transcoder or zstd in the
+// tree), neither are arrays, cube maps, 3D textures, VK_FORMAT_UNDEFINED payloads or formats
+// other than uncompressed and BC/ETC2/EAC/ASTC color formats. Every level has to hold exactly
+// the blocks of its extent, so a copy of the levels never reads past the data.
+class Ktx2Texture {
+public:
+    // Returns false, with the reason logged, if file is not a KTX2 texture this class supports.
+    bool Load(const FileView &file);
+
+    VkFormat GetFormat() const { return format_; }
+
+    uint32_t GetWidth() const { return levels_.empty() ? 0 : levels_[0].width; }
+
+    uint32_t GetHeight() const { return levels_.empty() ? 0 : levels_[0].height; }
+
+    // Level data of GetLevels, level 0 is the largest. Offsets are relative to GetData and the
+    // levels need not be in order.
+    const uint8_t *GetData() const { return data_; }
+
+    size_t GetDataSize() const { return size_; }
+
+    const std::vector<MipLevel> &GetLevels() const { return levels_; }
+
+    // Set for files with a level count of 0, which hold only the base level and ask the loader
+    // to generate the rest.
+    bool GetGenerateMipmaps() const { return generate_mipmaps_; }
+
+private:
+    FileView file_;
+    std::vector<uint8_t> inflated_;
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    VkFormat format_ = VK_FORMAT_UNDEFINED;
+    std::vector<MipLevel> levels_;
+    bool generate_mipmaps_ = false;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_KTX2_TEXTURE_H
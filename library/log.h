@@ -18,6 +18,19 @@
 #define LOGW(fmt, ...) LOG_PRINT(ANDROID_LOG_WARN, fmt, ##__VA_ARGS__)
 #define LOGE(fmt, ...) LOG_PRINT(ANDROID_LOG_ERROR, fmt, ##__VA_ARGS__)
 #define LOGF(fmt, ...) LOG_PRINT(ANDROID_LOG_FATAL, fmt, ##__VA_ARGS__)
+#else
+#include <cstdio>
+
+#define LOG_PRINT(level, fmt, ...) \
+    fprintf(stderr, "%s (%s:%u) %s(*): " fmt "\n", \
+        level, __FILE__, __LINE__, __FUNCTION__, ##__VA_ARGS__)
+
+#define LOGV(fmt, ...) LOG_PRINT("V", fmt, ##__VA_ARGS__)
+#define LOGD(fmt, ...) LOG_PRINT("D", fmt, ##__VA_ARGS__)
+#define LOGI(fmt, ...) LOG_PRINT("I", fmt, ##__VA_ARGS__)
+#define LOGW(fmt, ...) LOG_PRINT("W", fmt, ##__VA_ARGS__)
+#define LOGE(fmt, ...) LOG_PRINT("E", fmt, ##__VA_ARGS__)
+#define LOGF(fmt, ...) LOG_PRINT("F", fmt, ##__VA_ARGS__)
 #endif // ANDROID
 
 #endif //__LOG_H__
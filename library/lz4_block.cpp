@@ -0,0 +1,166 @@
+#include "lz4_block.h"
+
+#include <cstring>
+
+namespace tiny_engine {
+
+namespace {
+
+const size_t kMinMatch = 4;
+// The format requires the last match to start 12 bytes and end 5 bytes before the block end.
+const size_t kMatchStartLimit = 12;
+const size_t kLastLiterals = 5;
+const size_t kMaxOffset = 65535;
+const int kHashBits = 16;
+
+uint32_t HashSequence(const uint8_t *bytes) {
+    uint32_t sequence;
+    memcpy(&sequence, bytes, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+void WriteLength(std::vector<uint8_t> &output, size_t length) {
+    for (; length >= 255; length -= 255) {
+        output.push_back(255);
+    }
+    output.push_back(static_cast<uint8_t>(length));
+}
+
+void WriteSequence(std::vector<uint8_t> &output,
+                   const uint8_t *literals,
+                   size_t literal_length,
+                   size_t offset,
+                   size_t match_length) {
+    size_t match_code = match_length == 0 ? 0 : match_length - kMinMatch;
+    output.push_back(static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4
+                                          | (match_code < 15 ? match_code : 15)));
+    if (literal_length >= 15) {
+        WriteLength(output, literal_length - 15);
+    }
+    output.insert(output.end(), literals, literals + literal_length);
+    if (match_length == 0) {
+        return;
+    }
+    output.push_back(static_cast<uint8_t>(offset));
+    output.push_back(static_cast<uint8_t>(offset >> 8));
+    if (match_code >= 15) {
+        WriteLength(output, match_code - 15);
+    }
+}
+
+// Adds the length extension bytes following a nibble of 15, false if they run past end.
+bool ReadLength(const uint8_t *&input, const uint8_t *end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (input == end) {
+            return false;
+        }
+        byte = *input++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+std::vector<uint8_t> Lz4CompressBlock(const uint8_t *source, size_t size) {
+    std::vector<uint8_t> output;
+    output.reserve(size + size / 255 + 16);
+    size_t anchor = 0;
+    if (size > kMatchStartLimit) {
+        // Positions are stored plus one so that zero means empty.
+        std::vector<uint32_t> table(static_cast<size_t>(1) << kHashBits, 0);
+        size_t match_end_limit = size - kLastLiterals;
+        size_t i = 0;
+        while (i < size - kMatchStartLimit) {
+            uint32_t hash = HashSequence(source + i);
+            size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > kMaxOffset
+                || memcmp(source + candidate - 1, source + i, kMinMatch) != 0) {
+                i++;
+                continue;
+            }
+            candidate--;
+            size_t length = kMinMatch;
+            while (i + length < match_end_limit
+                   && source[candidate + length] == source[i + length]) {
+                length++;
+            }
+            WriteSequence(output, source + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    WriteSequence(output, source + anchor, size - anchor, 0, 0);
+    return output;
+}
+
+bool Lz4DecompressBlock(const uint8_t *source,
+                        size_t source_size,
+                        uint8_t *destination,
+                        size_t destination_size) {
+    const uint8_t *input = source;
+    const uint8_t *input_end = source + source_size;
+    uint8_t *output = destination;
+    uint8_t *output_end = destination + destination_size;
+    while (input < input_end) {
+        uint8_t token = *input++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !ReadLength(input, input_end, literal_length)) {
+            return false;
+        }
+        if (literal_length > static_cast<size_t>(input_end - input)
+            || literal_length > static_cast<size_t>(output_end - output)) {
+            return false;
+        }
+        if (literal_length <= 16 && input_end - input >= 16 && output_end - output >= 16) {
+            // Short runs are the common case, copy a fixed 16 bytes instead of calling memcpy
+            // with a variable size; the bytes past the run are overwritten later.
+            memcpy(output, input, 16);
+        } else {
+            memcpy(output, input, literal_length);
+        }
+        input += literal_length;
+        output += literal_length;
+        if (input == input_end) {
+            // The last sequence has literals only.
+            break;
+        }
+
+        if (input_end - input < 2) {
+            return false;
+        }
+        size_t offset = input[0] | static_cast<size_t>(input[1]) << 8;
+        input += 2;
+        if (offset == 0 || offset > static_cast<size_t>(output - destination)) {
+            return false;
+        }
+        size_t match_length = token & 15;
+        if (match_length == 15 && !ReadLength(input, input_end, match_length)) {
+            return false;
+        }
+        match_length += kMinMatch;
+        if (match_length > static_cast<size_t>(output_end - output)) {
+            return false;
+        }
+        const uint8_t *match = output - offset;
+        if (offset >= 8 && static_cast<size_t>(output_end - output) >= match_length + 8) {
+            // Eight bytes at a time, each chunk only reads bytes that are already final.
+            for (size_t i = 0; i < match_length; i += 8) {
+                memcpy(output + i, match + i, 8);
+            }
+        } else if (offset >= match_length) {
+            memcpy(output, match, match_length);
+        } else {
+            // Overlapping matches repeat the last offset bytes.
+            for (size_t i = 0; i < match_length; i++) {
+                output[i] = match[i];
+            }
+        }
+        output += match_length;
+    }
+    return output == output_end;
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,24 @@
+#ifndef TINY_ENGINE_LZ4_BLOCK_H
+#define TINY_ENGINE_LZ4_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Compresses size bytes into one raw LZ4 block (no frame header or checksum), readable by
+// Lz4DecompressBlock or LZ4_decompress_safe. Greedy matching with a single hash probe, meant for
+// baking assets offline.
+std::vector<uint8_t> Lz4CompressBlock(const uint8_t *source, size_t size);
+
+// Decompresses a raw LZ4 block which must expand to exactly destination_size bytes. Returns
+// false for malformed input, never reading or writing outside the two buffers.
+bool Lz4DecompressBlock(const uint8_t *source,
+                        size_t source_size,
+                        uint8_t *destination,
+                        size_t destination_size);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_LZ4_BLOCK_H
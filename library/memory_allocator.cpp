@@ -0,0 +1,198 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace tiny_engine {
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+void MemoryAllocator::Init(VkPhysicalDevice physical_device,
+                           VkDevice device,
+                           VkDeviceSize block_size) {
+    device_ = device;
+    block_size_ = block_size;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties_);
+}
+
+void MemoryAllocator::Destroy() {
+    for (auto &block : blocks_) {
+        if (block != nullptr) {
+            vkFreeMemory(device_, block->memory, nullptr);
+        }
+    }
+    blocks_.clear();
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements &requirements,
+                                           VkMemoryPropertyFlags properties,
+                                           bool linear) {
+    MemoryAllocation allocation;
+    allocation.memory_type = FindMemoryType(requirements.memoryTypeBits, properties);
+    allocation.size = requirements.size;
+
+    VkDeviceSize block_size = GetBlockSize(allocation.memory_type);
+    if (requirements.size > block_size / 2) {
+        allocation.memory = AllocateDeviceMemory(requirements.size, allocation.memory_type,
+                                                 &allocation.mapped);
+        return allocation;
+    }
+
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        Block *block = blocks_[i].get();
+        if (block == nullptr || block->memory_type != allocation.memory_type
+            || block->linear != linear) {
+            continue;
+        }
+        if (AllocateFromBlock(*block, requirements, allocation.offset)) {
+            allocation.memory = block->memory;
+            allocation.block = static_cast<int32_t>(i);
+            if (block->mapped != nullptr) {
+                allocation.mapped = static_cast<uint8_t *>(block->mapped) + allocation.offset;
+            }
+            return allocation;
+        }
+    }
+
+    std::unique_ptr<Block> block(new Block);
+    block->memory = AllocateDeviceMemory(block_size, allocation.memory_type, &block->mapped);
+    block->size = block_size;
+    block->memory_type = allocation.memory_type;
+    block->linear = linear;
+    block->free_ranges[0] = block_size;
+    AllocateFromBlock(*block, requirements, allocation.offset);
+
+    allocation.memory = block->memory;
+    if (block->mapped != nullptr) {
+        allocation.mapped = static_cast<uint8_t *>(block->mapped) + allocation.offset;
+    }
+
+    size_t index = 0;
+    while (index < blocks_.size() && blocks_[index] != nullptr) {
+        index++;
+    }
+    if (index == blocks_.size()) {
+        blocks_.emplace_back();
+    }
+    blocks_[index] = std::move(block);
+    allocation.block = static_cast<int32_t>(index);
+    return allocation;
+}
+
+void MemoryAllocator::Free(MemoryAllocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+
+    if (allocation.block < 0) {
+        vkFreeMemory(device_, allocation.memory, nullptr);
+        allocation = MemoryAllocation();
+        return;
+    }
+
+    Block &block = *blocks_[allocation.block];
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize size = allocation.size;
+
+    auto next = block.free_ranges.lower_bound(offset);
+    if (next != block.free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block.free_ranges.erase(next);
+    }
+    if (next != block.free_ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            block.free_ranges.erase(prev);
+        }
+    }
+    block.free_ranges[offset] = size;
+    block.used -= allocation.size;
+
+    // Give empty blocks back to the driver, but keep the last one of its kind around so that
+    // a stream of short lived staging buffers does not allocate and free a block every time.
+    if (block.used == 0) {
+        for (size_t i = 0; i < blocks_.size(); i++) {
+            if (i != static_cast<size_t>(allocation.block) && blocks_[i] != nullptr
+                && blocks_[i]->memory_type == block.memory_type
+                && blocks_[i]->linear == block.linear) {
+                vkFreeMemory(device_, block.memory, nullptr);
+                blocks_[allocation.block].reset();
+                break;
+            }
+        }
+    }
+    allocation = MemoryAllocation();
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; i++) {
+        if (type_filter & (1 << i) &&
+            (memory_properties_.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceMemory MemoryAllocator::AllocateDeviceMemory(VkDeviceSize size,
+                                                     uint32_t memory_type,
+                                                     void **mapped) {
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(device_, &alloc_info, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    *mapped = nullptr;
+    if (memory_properties_.memoryTypes[memory_type].propertyFlags
+        & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(device_, memory, nullptr);
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+    return memory;
+}
+
+bool MemoryAllocator::AllocateFromBlock(Block &block,
+                                        const VkMemoryRequirements &requirements,
+                                        VkDeviceSize &offset) {
+    for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it) {
+        VkDeviceSize range_offset = it->first;
+        VkDeviceSize range_end = it->first + it->second;
+        VkDeviceSize aligned_offset = AlignUp(range_offset, requirements.alignment);
+        if (aligned_offset + requirements.size > range_end) {
+            continue;
+        }
+
+        block.free_ranges.erase(it);
+        if (aligned_offset > range_offset) {
+            block.free_ranges[range_offset] = aligned_offset - range_offset;
+        }
+        VkDeviceSize allocation_end = aligned_offset + requirements.size;
+        if (allocation_end < range_end) {
+            block.free_ranges[allocation_end] = range_end - allocation_end;
+        }
+        block.used += requirements.size;
+        offset = aligned_offset;
+        return true;
+    }
+    return false;
+}
+
+VkDeviceSize MemoryAllocator::GetBlockSize(uint32_t memory_type) {
+    // Small heaps (e.g. the 256MB device local + host visible heap on some GPUs) would be eaten
+    // by a couple of default sized blocks.
+    uint32_t heap_index = memory_properties_.memoryTypes[memory_type].heapIndex;
+    VkDeviceSize heap_size = memory_properties_.memoryHeaps[heap_index].size;
+    return std::min(block_size_, heap_size / 8);
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,72 @@
+#ifndef TINY_ENGINE_MEMORY_ALLOCATOR_H
+#define TINY_ENGINE_MEMORY_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace tiny_engine {
+
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Host address of offset, only set for host visible memory which stays mapped for its lifetime.
+    void *mapped = nullptr;
+    uint32_t memory_type = 0;
+    // Index of the owning block, -1 for a dedicated VkDeviceMemory.
+    int32_t block = -1;
+};
+
+// Carves buffers and images out of a few large VkDeviceMemory blocks instead of calling
+// vkAllocateMemory per resource. Linear resources (buffers, linear images) and optimal images
+// never share a block, so bufferImageGranularity can not be violated between neighbours.
+class MemoryAllocator {
+public:
+    static constexpr VkDeviceSize kDefaultBlockSize = 64 * 1024 * 1024;
+
+    void Init(VkPhysicalDevice physical_device,
+              VkDevice device,
+              VkDeviceSize block_size = kDefaultBlockSize);
+
+    void Destroy();
+
+    MemoryAllocation Allocate(const VkMemoryRequirements &requirements,
+                              VkMemoryPropertyFlags properties,
+                              bool linear);
+
+    void Free(MemoryAllocation &allocation);
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+        uint32_t memory_type = 0;
+        bool linear = true;
+        void *mapped = nullptr;
+        // offset -> size of every free range, neighbours are merged on free.
+        std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+    };
+
+    uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
+
+    VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memory_type, void **mapped);
+
+    bool AllocateFromBlock(Block &block,
+                           const VkMemoryRequirements &requirements,
+                           VkDeviceSize &offset);
+
+    VkDeviceSize GetBlockSize(uint32_t memory_type);
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memory_properties_{};
+    VkDeviceSize block_size_ = kDefaultBlockSize;
+    std::vector<std::unique_ptr<Block>> blocks_;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MEMORY_ALLOCATOR_H
@@ -0,0 +1,178 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "log.h"
+
+namespace tiny_engine {
+
+namespace {
+
+const char kMagic[4] = {'T', 'E', 'M', 'C'};
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t GetIndexTypeSize(uint32_t index_type) {
+    return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+} // namespace
+
+MeshBounds ComputeMeshBounds(const void *vertices,
+                             size_t vertex_count,
+                             size_t vertex_stride,
+                             size_t position_offset) {
+    MeshBounds bounds;
+    const uint8_t *data = static_cast<const uint8_t *>(vertices) + position_offset;
+    for (size_t i = 0; i < vertex_count; i++) {
+        float position[3];
+        memcpy(position, data + i * vertex_stride, sizeof(position));
+        for (int j = 0; j < 3; j++) {
+            bounds.min[j] = i == 0 ? position[j] : std::min(bounds.min[j], position[j]);
+            bounds.max[j] = i == 0 ? position[j] : std::max(bounds.max[j], position[j]);
+        }
+    }
+    return bounds;
+}
+
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = seed ^ (size * m);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t k;
+        memcpy(&k, bytes + i, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    if (i < size) {
+        uint64_t tail = 0;
+        memcpy(&tail, bytes + i, size - i);
+        h ^= tail;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+bool MeshCache::Load(const std::string &filename, uint64_t source_hash, uint32_t vertex_stride) {
+    file_ = Filesystem::GetInstance().MapData(filename);
+    header_ = nullptr;
+    if (file_.size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+
+    const auto *header = file_.As<MeshCacheHeader>();
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion
+        || header->source_hash != source_hash || header->vertex_stride != vertex_stride) {
+        LOGI("Mesh cache %s is stale", filename.c_str());
+        file_ = FileView();
+        return false;
+    }
+
+    uint64_t vertex_end = header->vertex_offset
+                          + static_cast<uint64_t>(header->vertex_count) * vertex_stride;
+    uint64_t index_end = header->index_offset
+                         + static_cast<uint64_t>(header->index_count)
+                           * GetIndexTypeSize(header->index_type);
+    uint64_t sub_mesh_end = header->sub_mesh_offset
+                            + static_cast<uint64_t>(header->sub_mesh_count) * sizeof(SubMesh);
+    uint64_t lod_end = header->lod_offset
+                       + static_cast<uint64_t>(header->lod_count) * sizeof(MeshLod);
+    uint64_t meshlet_end = header->meshlet_offset
+                           + static_cast<uint64_t>(header->meshlet_count) * sizeof(Meshlet);
+    uint64_t end = std::max(std::max(vertex_end, index_end),
+                            std::max(std::max(sub_mesh_end, lod_end), meshlet_end));
+    if (end > file_.size()
+        || HashBytes(file_.data() + sizeof(MeshCacheHeader), file_.size() - sizeof(MeshCacheHeader))
+           != header->content_hash) {
+        LOGW("Mesh cache %s is corrupted", filename.c_str());
+        file_ = FileView();
+        return false;
+    }
+
+    header_ = header;
+    return true;
+}
+
+bool MeshCache::Save(const std::string &filename,
+                     uint64_t source_hash,
+                     const void *vertices,
+                     uint32_t vertex_stride,
+                     uint32_t vertex_count,
+                     const MeshIndices &indices,
+                     const std::vector<SubMesh> &sub_meshes,
+                     const std::vector<MeshLod> &lods,
+                     const std::vector<Meshlet> &meshlets,
+                     const MeshBounds &bounds) {
+    MeshCacheHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.source_hash = source_hash;
+    header.vertex_stride = vertex_stride;
+    header.vertex_count = vertex_count;
+    header.index_type = indices.GetIndexType();
+    header.index_count = static_cast<uint32_t>(indices.GetCount());
+    header.sub_mesh_count = static_cast<uint32_t>(sub_meshes.size());
+    header.lod_count = static_cast<uint32_t>(lods.size());
+    header.meshlet_count = static_cast<uint32_t>(meshlets.size());
+    header.bounds = bounds;
+
+    uint64_t vertex_size = static_cast<uint64_t>(vertex_count) * vertex_stride;
+    header.vertex_offset = AlignUp(sizeof(MeshCacheHeader), 16);
+    header.index_offset = AlignUp(header.vertex_offset + vertex_size, 16);
+    header.sub_mesh_offset = AlignUp(header.index_offset + indices.GetSize(), 16);
+    header.lod_offset = AlignUp(header.sub_mesh_offset + sub_meshes.size() * sizeof(SubMesh),
+                                16);
+    header.meshlet_offset = AlignUp(header.lod_offset + lods.size() * sizeof(MeshLod), 16);
+    uint64_t file_size = header.meshlet_offset + meshlets.size() * sizeof(Meshlet);
+
+    std::vector<uint8_t> data(file_size, 0);
+    memcpy(data.data() + header.vertex_offset, vertices, vertex_size);
+    memcpy(data.data() + header.index_offset, indices.GetData(), indices.GetSize());
+    memcpy(data.data() + header.sub_mesh_offset, sub_meshes.data(),
+           sub_meshes.size() * sizeof(SubMesh));
+    memcpy(data.data() + header.lod_offset, lods.data(), lods.size() * sizeof(MeshLod));
+    memcpy(data.data() + header.meshlet_offset, meshlets.data(),
+           meshlets.size() * sizeof(Meshlet));
+    header.content_hash = HashBytes(data.data() + sizeof(MeshCacheHeader),
+                                    data.size() - sizeof(MeshCacheHeader));
+    memcpy(data.data(), &header, sizeof(header));
+
+    return Filesystem::GetInstance().WriteData(filename, data.data(), data.size());
+}
+
+VkDeviceSize MeshCache::GetIndexSize() const {
+    return static_cast<VkDeviceSize>(header_->index_count) * GetIndexTypeSize(header_->index_type);
+}
+
+std::vector<SubMesh> MeshCache::GetSubMeshes() const {
+    const auto *sub_meshes = reinterpret_cast<const SubMesh *>(file_.data()
+                                                               + header_->sub_mesh_offset);
+    return std::vector<SubMesh>(sub_meshes, sub_meshes + header_->sub_mesh_count);
+}
+
+std::vector<MeshLod> MeshCache::GetLods() const {
+    const auto *lods = reinterpret_cast<const MeshLod *>(file_.data() + header_->lod_offset);
+    return std::vector<MeshLod>(lods, lods + header_->lod_count);
+}
+
+std::vector<Meshlet> MeshCache::GetMeshlets() const {
+    const auto *meshlets = reinterpret_cast<const Meshlet *>(file_.data()
+                                                             + header_->meshlet_offset);
+    return std::vector<Meshlet>(meshlets, meshlets + header_->meshlet_count);
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,109 @@
+#ifndef TINY_ENGINE_MESH_CACHE_H
+#define TINY_ENGINE_MESH_CACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+#include "mesh_indices.h"
+#include "meshlet.h"
+
+namespace tiny_engine {
+
+struct MeshBounds {
+    float min[3] = {0.0f, 0.0f, 0.0f};
+    float max[3] = {0.0f, 0.0f, 0.0f};
+};
+
+// Bounds of float3 positions stored position_offset bytes into each vertex.
+MeshBounds ComputeMeshBounds(const void *vertices,
+                             size_t vertex_count,
+                             size_t vertex_stride,
+                             size_t position_offset);
+
+// MurmurHash64A, used for the source and content hashes of cache files.
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+// On-disk layout of a baked mesh, every section starts 16-byte aligned so the vertex and index
+// data can be copied straight out of the mapping.
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    // Hash of the source asset, a cache baked from another version of it is ignored.
+    uint64_t source_hash;
+    // Hash of everything after the header, catches truncated or corrupted files.
+    uint64_t content_hash;
+    uint32_t vertex_stride;
+    uint32_t vertex_count;
+    uint32_t index_type;
+    uint32_t index_count;
+    uint32_t sub_mesh_count;
+    uint32_t lod_count;
+    uint32_t meshlet_count;
+    uint32_t reserved;
+    MeshBounds bounds;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t sub_mesh_offset;
+    uint64_t lod_offset;
+    uint64_t meshlet_offset;
+};
+
+// Final interleaved vertex buffer, index buffer, draw ranges, levels of detail and meshlets of a
+// mesh, memory mapped from the
+// Filesystem data directory so a cached load costs no parsing and no copies besides the upload.
+class MeshCache {
+public:
+    // Bump whenever the import pipeline (welding, optimization, vertex layout) changes.
+    static constexpr uint32_t kVersion = 4;
+
+    // Returns false if the file is missing, was baked from a different source or vertex layout,
+    // or fails validation; the caller then imports the source and calls Save.
+    bool Load(const std::string &filename, uint64_t source_hash, uint32_t vertex_stride);
+
+    static bool Save(const std::string &filename,
+                     uint64_t source_hash,
+                     const void *vertices,
+                     uint32_t vertex_stride,
+                     uint32_t vertex_count,
+                     const MeshIndices &indices,
+                     const std::vector<SubMesh> &sub_meshes,
+                     const std::vector<MeshLod> &lods,
+                     const std::vector<Meshlet> &meshlets,
+                     const MeshBounds &bounds);
+
+    const void *GetVertices() const { return file_.data() + header_->vertex_offset; }
+
+    uint32_t GetVertexCount() const { return header_->vertex_count; }
+
+    VkDeviceSize GetVertexSize() const {
+        return static_cast<VkDeviceSize>(header_->vertex_count) * header_->vertex_stride;
+    }
+
+    const void *GetIndices() const { return file_.data() + header_->index_offset; }
+
+    VkIndexType GetIndexType() const { return static_cast<VkIndexType>(header_->index_type); }
+
+    uint32_t GetIndexCount() const { return header_->index_count; }
+
+    VkDeviceSize GetIndexSize() const;
+
+    std::vector<SubMesh> GetSubMeshes() const;
+
+    std::vector<MeshLod> GetLods() const;
+
+    std::vector<Meshlet> GetMeshlets() const;
+
+    const MeshBounds &GetBounds() const { return header_->bounds; }
+
+private:
+    FileView file_;
+    const MeshCacheHeader *header_ = nullptr;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MESH_CACHE_H
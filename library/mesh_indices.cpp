@@ -0,0 +1,94 @@
+#include "mesh_indices.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace tiny_engine {
+
+void MeshIndices::Assign(const std::vector<uint32_t> &indices) {
+    uint32_t max_index = 0;
+    for (uint32_t index : indices) {
+        max_index = std::max(max_index, index);
+    }
+
+    count_ = indices.size();
+    if (max_index <= UINT16_MAX) {
+        index_type_ = VK_INDEX_TYPE_UINT16;
+        data_.resize(count_ * sizeof(uint16_t));
+        auto *data = reinterpret_cast<uint16_t *>(data_.data());
+        for (size_t i = 0; i < count_; i++) {
+            data[i] = static_cast<uint16_t>(indices[i]);
+        }
+    } else {
+        index_type_ = VK_INDEX_TYPE_UINT32;
+        data_.resize(count_ * sizeof(uint32_t));
+        memcpy(data_.data(), indices.data(), data_.size());
+    }
+}
+
+uint32_t MeshIndices::Get(size_t i) const {
+    if (index_type_ == VK_INDEX_TYPE_UINT16) {
+        return reinterpret_cast<const uint16_t *>(data_.data())[i];
+    }
+    return reinterpret_cast<const uint32_t *>(data_.data())[i];
+}
+
+std::vector<SubMesh> SplitMesh(std::vector<uint32_t> &indices,
+                               size_t vertex_count,
+                               std::vector<uint32_t> &vertex_remap,
+                               uint32_t max_vertices) {
+    if (max_vertices < 3) {
+        throw std::invalid_argument("sub-meshes need room for at least one triangle!");
+    }
+
+    std::vector<SubMesh> sub_meshes;
+    vertex_remap.clear();
+    vertex_remap.reserve(vertex_count);
+
+    // local_index[v] is only valid while local_stamp[v] equals the current sub-mesh number, so
+    // starting a new sub-mesh does not have to clear the table.
+    std::vector<uint32_t> local_index(vertex_count);
+    std::vector<uint32_t> local_stamp(vertex_count, UINT32_MAX);
+
+    SubMesh current;
+    uint32_t current_vertices = 0;
+    uint32_t stamp = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t new_vertices = 0;
+        for (size_t j = 0; j < 3; j++) {
+            uint32_t v = indices[i + j];
+            bool seen = local_stamp[v] == stamp;
+            for (size_t k = 0; k < j && !seen; k++) {
+                seen = indices[i + k] == v;
+            }
+            new_vertices += seen ? 0 : 1;
+        }
+
+        if (current_vertices + new_vertices > max_vertices) {
+            sub_meshes.push_back(current);
+            current.first_index = static_cast<uint32_t>(i);
+            current.index_count = 0;
+            current.vertex_offset = static_cast<int32_t>(vertex_remap.size());
+            current_vertices = 0;
+            stamp++;
+        }
+
+        for (size_t j = 0; j < 3; j++) {
+            uint32_t v = indices[i + j];
+            if (local_stamp[v] != stamp) {
+                local_stamp[v] = stamp;
+                local_index[v] = current_vertices++;
+                vertex_remap.push_back(v);
+            }
+            indices[i + j] = local_index[v];
+        }
+        current.index_count += 3;
+    }
+    if (current.index_count > 0) {
+        sub_meshes.push_back(current);
+    }
+    return sub_meshes;
+}
+
+} // namespace tiny_engine
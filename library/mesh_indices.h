@@ -0,0 +1,80 @@
+#ifndef TINY_ENGINE_MESH_INDICES_H
+#define TINY_ENGINE_MESH_INDICES_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Index list stored with the narrowest VkIndexType that can address every vertex it refers to,
+// 16-bit indices halve the index fetch bandwidth and the buffer size.
+class MeshIndices {
+public:
+    MeshIndices() = default;
+
+    explicit MeshIndices(const std::vector<uint32_t> &indices) { Assign(indices); }
+
+    void Assign(const std::vector<uint32_t> &indices);
+
+    VkIndexType GetIndexType() const { return index_type_; }
+
+    size_t GetCount() const { return count_; }
+
+    VkDeviceSize GetSize() const { return data_.size(); }
+
+    const void *GetData() const { return data_.data(); }
+
+    uint32_t Get(size_t i) const;
+
+private:
+    VkIndexType index_type_ = VK_INDEX_TYPE_UINT16;
+    size_t count_ = 0;
+    std::vector<uint8_t> data_;
+};
+
+// A range of an index buffer drawn with
+// vkCmdDrawIndexed(index_count, 1, first_index, vertex_offset, 0).
+struct SubMesh {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    int32_t vertex_offset = 0;
+};
+
+// A level of detail stored as a range of the shared index buffer. error is the largest distance,
+// in model units, between this level's surface and the full detail one.
+struct MeshLod {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    float error = 0.0f;
+};
+
+// Splits a triangle list into sub-meshes that each reference at most max_vertices vertices, so
+// that meshes of any size can be drawn with 16-bit indices on GPUs where 32-bit indices are
+// slow. Triangles keep their order. vertex_remap receives, for every vertex of the new vertex
+// array, the index of the source vertex (vertices on a sub-mesh border are duplicated) and
+// indices is rewritten relative to its sub-mesh's vertex_offset.
+std::vector<SubMesh> SplitMesh(std::vector<uint32_t> &indices,
+                               size_t vertex_count,
+                               std::vector<uint32_t> &vertex_remap,
+                               uint32_t max_vertices = UINT16_MAX + 1);
+
+template<typename Vertex>
+std::vector<SubMesh> SplitMesh(std::vector<Vertex> &vertices,
+                               std::vector<uint32_t> &indices,
+                               uint32_t max_vertices = UINT16_MAX + 1) {
+    std::vector<uint32_t> vertex_remap;
+    std::vector<SubMesh> sub_meshes = SplitMesh(indices, vertices.size(), vertex_remap,
+                                                max_vertices);
+    std::vector<Vertex> split_vertices(vertex_remap.size());
+    for (size_t i = 0; i < vertex_remap.size(); i++) {
+        split_vertices[i] = vertices[vertex_remap[i]];
+    }
+    vertices.swap(split_vertices);
+    return sub_meshes;
+}
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MESH_INDICES_H
@@ -0,0 +1,312 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace tiny_engine {
+
+namespace {
+
+// Triangles using each vertex, triangles[offsets[v]] .. triangles[offsets[v + 1]].
+struct Adjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+void BuildAdjacency(Adjacency &adjacency,
+                    const uint32_t *indices,
+                    size_t index_count,
+                    size_t vertex_count) {
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    for (size_t i = 0; i < index_count; i++) {
+        adjacency.offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    adjacency.triangles.resize(index_count);
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < index_count; i++) {
+        adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+// FIFO cache simulated with timestamps: a vertex is cached while fewer than cache_size misses
+// happened since it was loaded, so a lookup is O(1) and Reset() does not touch the table.
+class VertexCache {
+public:
+    VertexCache(size_t vertex_count, size_t cache_size)
+            : cache_time_(vertex_count, 0),
+              cache_size_(static_cast<uint32_t>(cache_size)),
+              time_(cache_size_ + 1) {}
+
+    bool Contains(uint32_t v) const { return time_ - cache_time_[v] <= cache_size_; }
+
+    // Returns the number of vertices which had to be transformed.
+    uint32_t Access(const uint32_t *triangle) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; k++) {
+            if (!Contains(triangle[k])) {
+                cache_time_[triangle[k]] = time_++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void Reset() { time_ += cache_size_ + 1; }
+
+    uint32_t GetTime() const { return time_; }
+
+    uint32_t GetCacheTime(uint32_t v) const { return cache_time_[v]; }
+
+private:
+    std::vector<uint32_t> cache_time_;
+    uint32_t cache_size_;
+    uint32_t time_;
+};
+
+void LoadPosition(float *position, const float *positions, size_t stride, uint32_t v) {
+    memcpy(position, reinterpret_cast<const uint8_t *>(positions) + v * stride,
+           3 * sizeof(float));
+}
+
+} // namespace
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t *indices,
+                                         size_t index_count,
+                                         size_t vertex_count,
+                                         size_t cache_size) {
+    VertexCacheStatistics statistics;
+    VertexCache cache(vertex_count, cache_size);
+    std::vector<uint8_t> referenced(vertex_count, 0);
+    size_t referenced_count = 0;
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        statistics.vertices_transformed += cache.Access(indices + i);
+        for (int k = 0; k < 3; k++) {
+            referenced_count += referenced[indices[i + k]] ? 0 : 1;
+            referenced[indices[i + k]] = 1;
+        }
+    }
+
+    if (index_count >= 3) {
+        statistics.acmr = static_cast<float>(statistics.vertices_transformed)
+                          / static_cast<float>(index_count / 3);
+        statistics.atvr = static_cast<float>(statistics.vertices_transformed)
+                          / static_cast<float>(referenced_count);
+    }
+    return statistics;
+}
+
+void OptimizeVertexCache(uint32_t *destination,
+                         const uint32_t *indices,
+                         size_t index_count,
+                         size_t vertex_count,
+                         size_t cache_size) {
+    Adjacency adjacency;
+    BuildAdjacency(adjacency, indices, index_count, vertex_count);
+
+    // Number of triangles still to be emitted per vertex.
+    std::vector<uint32_t> live(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+    std::vector<uint8_t> emitted(index_count / 3, 0);
+    std::vector<uint32_t> dead_end;
+    dead_end.reserve(index_count);
+    std::vector<uint32_t> candidates;
+    VertexCache cache(vertex_count, cache_size);
+
+    size_t output = 0;
+    uint32_t cursor = 0;
+    auto next_live = [&]() -> int64_t {
+        while (cursor < vertex_count && live[cursor] == 0) {
+            cursor++;
+        }
+        return cursor < vertex_count ? static_cast<int64_t>(cursor) : -1;
+    };
+
+    int64_t fanning = next_live();
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++) {
+            uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle]) {
+                continue;
+            }
+            const uint32_t *corners = indices + 3 * triangle;
+            for (int k = 0; k < 3; k++) {
+                destination[output++] = corners[k];
+                dead_end.push_back(corners[k]);
+                candidates.push_back(corners[k]);
+                live[corners[k]]--;
+            }
+            cache.Access(corners);
+            emitted[triangle] = 1;
+        }
+
+        // Continue with the candidate which has been cached longest but will still be cached
+        // after all its triangles are emitted.
+        int64_t next = -1;
+        int64_t best_priority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            int64_t age = cache.GetTime() - cache.GetCacheTime(v);
+            if (age + 2 * static_cast<int64_t>(live[v]) <= static_cast<int64_t>(cache_size)) {
+                priority = age;
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        // Dead end: the most recently used vertex with triangles left, else any vertex.
+        while (next < 0 && !dead_end.empty()) {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0) {
+                next = v;
+            }
+        }
+        if (next < 0) {
+            next = next_live();
+        }
+        fanning = next;
+    }
+}
+
+void OptimizeOverdraw(uint32_t *destination,
+                      const uint32_t *indices,
+                      size_t index_count,
+                      const float *positions,
+                      size_t vertex_count,
+                      size_t positions_stride,
+                      float threshold,
+                      size_t cache_size) {
+    size_t triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // Hard boundaries: triangles which miss the cache for all three vertices, reordering there
+    // costs nothing.
+    std::vector<uint32_t> hard_clusters;
+    VertexCache cache(vertex_count, cache_size);
+    for (size_t t = 0; t < triangle_count; t++) {
+        if (cache.Access(indices + 3 * t) == 3 || t == 0) {
+            hard_clusters.push_back(static_cast<uint32_t>(t));
+        }
+    }
+    hard_clusters.push_back(static_cast<uint32_t>(triangle_count));
+
+    // Soft boundaries: cut a hard cluster whenever the part so far reuses the cache about as
+    // well as the whole cluster does.
+    std::vector<uint32_t> clusters;
+    for (size_t c = 0; c + 1 < hard_clusters.size(); c++) {
+        uint32_t start = hard_clusters[c];
+        uint32_t end = hard_clusters[c + 1];
+
+        cache.Reset();
+        uint32_t cluster_misses = 0;
+        for (uint32_t t = start; t < end; t++) {
+            cluster_misses += cache.Access(indices + 3 * t);
+        }
+        float target = threshold * static_cast<float>(cluster_misses)
+                       / static_cast<float>(end - start);
+
+        cache.Reset();
+        clusters.push_back(start);
+        uint32_t cluster_start = start;
+        uint32_t misses = 0;
+        for (uint32_t t = start; t + 1 < end; t++) {
+            misses += cache.Access(indices + 3 * t);
+            if (static_cast<float>(misses) <= target * static_cast<float>(t + 1 - cluster_start)) {
+                clusters.push_back(t + 1);
+                cluster_start = t + 1;
+                misses = 0;
+                cache.Reset();
+            }
+        }
+    }
+    clusters.push_back(static_cast<uint32_t>(triangle_count));
+
+    float mesh_centroid[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        float position[3];
+        LoadPosition(position, positions, positions_stride, indices[i]);
+        for (int k = 0; k < 3; k++) {
+            mesh_centroid[k] += position[k] / static_cast<float>(triangle_count * 3);
+        }
+    }
+
+    // Sort key: how far the cluster lies out along its own average normal. Clusters on the
+    // outside facing away from the center occlude the rest and go first.
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        float centroid[3] = {0.0f, 0.0f, 0.0f};
+        float normal[3] = {0.0f, 0.0f, 0.0f};
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            float p0[3], p1[3], p2[3];
+            LoadPosition(p0, positions, positions_stride, indices[3 * t + 0]);
+            LoadPosition(p1, positions, positions_stride, indices[3 * t + 1]);
+            LoadPosition(p2, positions, positions_stride, indices[3 * t + 2]);
+
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+            normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+            normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+            for (int k = 0; k < 3; k++) {
+                centroid[k] += p0[k] + p1[k] + p2[k];
+            }
+        }
+
+        float corner_count = static_cast<float>(3 * (clusters[c + 1] - clusters[c]));
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                                 + normal[2] * normal[2]);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        sort_keys[c] = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            sort_keys[c] += (centroid[k] / corner_count - mesh_centroid[k]) * normal[k] * scale;
+        }
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sort_keys[a] > sort_keys[b];
+    });
+
+    size_t output = 0;
+    for (uint32_t c : order) {
+        size_t count = 3 * (clusters[c + 1] - clusters[c]);
+        memcpy(destination + output, indices + 3 * clusters[c], count * sizeof(uint32_t));
+        output += count;
+    }
+}
+
+size_t GenerateVertexFetchRemap(const uint32_t *indices,
+                                size_t index_count,
+                                size_t vertex_count,
+                                uint32_t *remap) {
+    std::fill(remap, remap + vertex_count, ~0u);
+    uint32_t next = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        if (remap[indices[i]] == ~0u) {
+            remap[indices[i]] = next++;
+        }
+    }
+    return next;
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,81 @@
+#ifndef TINY_ENGINE_MESH_OPTIMIZER_H
+#define TINY_ENGINE_MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Post-transform cache size assumed by the optimizations, mobile GPUs keep roughly 16 to 32
+// shaded vertices around and ordering for the smaller cache does not hurt the larger one.
+const size_t kVertexCacheSize = 16;
+
+struct VertexCacheStatistics {
+    size_t vertices_transformed = 0;
+    // Average cache miss ratio: transformed vertices per triangle, 0.5 is the best a regular
+    // grid can do and 3 means no reuse at all.
+    float acmr = 0.0f;
+    // Average transform to vertex ratio: transformed vertices per referenced vertex, 1 is ideal.
+    float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries over a triangle list, for
+// measuring the optimizations offline.
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t *indices,
+                                         size_t index_count,
+                                         size_t vertex_count,
+                                         size_t cache_size = kVertexCacheSize);
+
+// Reorders triangles for post-transform cache reuse using Tipsify (Sander, Nehab, Barczak 2007),
+// which runs in linear time. destination may not alias indices.
+void OptimizeVertexCache(uint32_t *destination,
+                         const uint32_t *indices,
+                         size_t index_count,
+                         size_t vertex_count,
+                         size_t cache_size = kVertexCacheSize);
+
+// Reorders runs of triangles of a cache optimized list so that those facing away from the mesh
+// center are drawn first, which lets early depth testing reject more of the rest. The list is cut
+// where the cache is cold anyway, and runs are split further as long as their cache miss ratio
+// stays within threshold (1.05 allows 5% worse ACMR). positions are float3 at positions_stride
+// bytes apart. destination may not alias indices.
+void OptimizeOverdraw(uint32_t *destination,
+                      const uint32_t *indices,
+                      size_t index_count,
+                      const float *positions,
+                      size_t vertex_count,
+                      size_t positions_stride,
+                      float threshold = 1.05f,
+                      size_t cache_size = kVertexCacheSize);
+
+// Numbers vertices in the order the index list first uses them, so vertex fetch walks memory
+// linearly. remap[i] receives the new index of vertex i, or ~0u if no triangle uses it.
+// Returns the number of used vertices.
+size_t GenerateVertexFetchRemap(const uint32_t *indices,
+                                size_t index_count,
+                                size_t vertex_count,
+                                uint32_t *remap);
+
+// Applies GenerateVertexFetchRemap to vertices and indices, unused vertices are dropped.
+template<typename Vertex>
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+    std::vector<uint32_t> remap(vertices.size());
+    size_t used_count = GenerateVertexFetchRemap(indices.data(), indices.size(), vertices.size(),
+                                                 remap.data());
+
+    std::vector<Vertex> ordered(used_count);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] != ~0u) {
+            ordered[remap[i]] = vertices[i];
+        }
+    }
+    for (uint32_t &index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MESH_OPTIMIZER_H
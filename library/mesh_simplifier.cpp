@@ -0,0 +1,472 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "mesh_optimizer.h"
+#include "vertex_welder.h"
+
+namespace tiny_engine {
+
+namespace {
+
+enum class VertexKind : uint8_t {
+    kManifold,
+    // On an open border with exactly one border edge in and one out.
+    kBorder,
+    // Attribute seams, non-manifold fans and border corners.
+    kLocked
+};
+
+// Sum of squared distances to a set of planes, weighted by area:
+// error(p) = p^T A p + 2 b^T p + c, with A symmetric.
+struct Quadric {
+    float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+    float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+    float c = 0.0f;
+    float w = 0.0f;
+
+    void AddPlane(const float n[3], float d, float weight) {
+        a00 += weight * n[0] * n[0];
+        a11 += weight * n[1] * n[1];
+        a22 += weight * n[2] * n[2];
+        a10 += weight * n[1] * n[0];
+        a20 += weight * n[2] * n[0];
+        a21 += weight * n[2] * n[1];
+        b0 += weight * n[0] * d;
+        b1 += weight * n[1] * d;
+        b2 += weight * n[2] * d;
+        c += weight * d * d;
+        w += weight;
+    }
+
+    void Add(const Quadric &other) {
+        a00 += other.a00;
+        a11 += other.a11;
+        a22 += other.a22;
+        a10 += other.a10;
+        a20 += other.a20;
+        a21 += other.a21;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        w += other.w;
+    }
+
+    // Unnormalized error, divide by the total weight for a squared distance.
+    float Evaluate(const float p[3]) const {
+        float rx = a00 * p[0] + a10 * p[1] + a20 * p[2];
+        float ry = a10 * p[0] + a11 * p[1] + a21 * p[2];
+        float rz = a20 * p[0] + a21 * p[1] + a22 * p[2];
+        float r = rx * p[0] + ry * p[1] + rz * p[2]
+                  + 2.0f * (b0 * p[0] + b1 * p[1] + b2 * p[2]) + c;
+        return std::fabs(r);
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float error;
+};
+
+struct Adjacency {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+void BuildAdjacency(Adjacency &adjacency,
+                    const uint32_t *indices,
+                    size_t index_count,
+                    size_t vertex_count) {
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    for (size_t i = 0; i < index_count; i++) {
+        adjacency.offsets[indices[i] + 1]++;
+    }
+    for (size_t v = 0; v < vertex_count; v++) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    adjacency.triangles.resize(index_count);
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < index_count; i++) {
+        adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+// Number of triangles containing the directed edge a -> b.
+uint32_t CountEdge(const Adjacency &adjacency, const uint32_t *indices, uint32_t a, uint32_t b) {
+    uint32_t count = 0;
+    for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; i++) {
+        const uint32_t *triangle = indices + 3 * adjacency.triangles[i];
+        for (int k = 0; k < 3; k++) {
+            if (triangle[k] == a && triangle[(k + 1) % 3] == b) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+void Cross(float *result, const float *p0, const float *p1, const float *p2) {
+    float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    result[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    result[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    result[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+float Length(const float *v) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+void ClassifyVertices(std::vector<VertexKind> &kinds,
+                      std::vector<uint32_t> &border_next,
+                      std::vector<uint32_t> &border_prev,
+                      const Adjacency &adjacency,
+                      const uint32_t *indices,
+                      size_t index_count,
+                      const std::vector<float> &positions,
+                      size_t vertex_count) {
+    // Vertices sharing a position with another vertex sit on a UV (or other attribute) seam,
+    // moving them independently would open a crack.
+    std::vector<uint32_t> position_remap(vertex_count);
+    GenerateVertexRemap(positions.data(), vertex_count, 3 * sizeof(float),
+                        position_remap.data());
+    std::vector<uint32_t> position_uses(vertex_count, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        position_uses[position_remap[v]]++;
+    }
+
+    const uint32_t kNone = ~0u;
+    kinds.assign(vertex_count, VertexKind::kManifold);
+    border_next.assign(vertex_count, kNone);
+    border_prev.assign(vertex_count, kNone);
+    for (size_t i = 0; i < index_count; i++) {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+        uint32_t forward = CountEdge(adjacency, indices, a, b);
+        uint32_t backward = CountEdge(adjacency, indices, b, a);
+        if (forward > 1 || backward > 1) {
+            kinds[a] = VertexKind::kLocked;
+            kinds[b] = VertexKind::kLocked;
+        } else if (backward == 0) {
+            // A second border edge through the same vertex makes it a corner of two borders.
+            if (border_next[a] != kNone || border_prev[b] != kNone) {
+                kinds[a] = VertexKind::kLocked;
+                kinds[b] = VertexKind::kLocked;
+            }
+            border_next[a] = b;
+            border_prev[b] = a;
+        }
+    }
+
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (position_uses[position_remap[v]] > 1) {
+            kinds[v] = VertexKind::kLocked;
+        } else if (kinds[v] == VertexKind::kManifold
+                   && (border_next[v] != kNone || border_prev[v] != kNone)) {
+            kinds[v] = border_next[v] != kNone && border_prev[v] != kNone ? VertexKind::kBorder
+                                                                            : VertexKind::kLocked;
+        }
+    }
+}
+
+void ComputeQuadrics(std::vector<Quadric> &quadrics,
+                     const uint32_t *indices,
+                     size_t index_count,
+                     const std::vector<float> &positions,
+                     const std::vector<uint32_t> &border_next) {
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        const float *p0 = &positions[3 * indices[i + 0]];
+        const float *p1 = &positions[3 * indices[i + 1]];
+        const float *p2 = &positions[3 * indices[i + 2]];
+
+        float normal[3];
+        Cross(normal, p0, p1, p2);
+        float length = Length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            normal[k] /= length;
+        }
+        float d = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+        float area = 0.5f * length;
+        for (int k = 0; k < 3; k++) {
+            quadrics[indices[i + k]].AddPlane(normal, d, area);
+        }
+
+        // Border edges also get a plane through the edge perpendicular to the triangle, which
+        // keeps the outline in place when vertices slide along it.
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = indices[i + k];
+            uint32_t b = indices[i + (k + 1) % 3];
+            if (border_next[a] != b) {
+                continue;
+            }
+            const float *pa = &positions[3 * a];
+            const float *pb = &positions[3 * b];
+            float edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+            float edge_length = Length(edge);
+            float perpendicular[3] = {
+                    edge[1] * normal[2] - edge[2] * normal[1],
+                    edge[2] * normal[0] - edge[0] * normal[2],
+                    edge[0] * normal[1] - edge[1] * normal[0]
+            };
+            float perpendicular_length = Length(perpendicular);
+            if (perpendicular_length == 0.0f) {
+                continue;
+            }
+            for (int j = 0; j < 3; j++) {
+                perpendicular[j] /= perpendicular_length;
+            }
+            float edge_d = -(perpendicular[0] * pa[0] + perpendicular[1] * pa[1]
+                             + perpendicular[2] * pa[2]);
+            float weight = 10.0f * edge_length * edge_length;
+            quadrics[a].AddPlane(perpendicular, edge_d, weight);
+            quadrics[b].AddPlane(perpendicular, edge_d, weight);
+        }
+    }
+}
+
+bool CanCollapse(const std::vector<VertexKind> &kinds,
+                 const std::vector<uint32_t> &border_next,
+                 const std::vector<uint32_t> &border_prev,
+                 uint32_t from,
+                 uint32_t to) {
+    switch (kinds[from]) {
+        case VertexKind::kManifold:
+            return true;
+        case VertexKind::kBorder:
+            return border_next[from] == to || border_prev[from] == to;
+        default:
+            return false;
+    }
+}
+
+// Whether redirecting from to to turns any remaining triangle around from over.
+bool HasTriangleFlips(const Adjacency &adjacency,
+                      const uint32_t *indices,
+                      const std::vector<float> &positions,
+                      uint32_t from,
+                      uint32_t to) {
+    for (uint32_t i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; i++) {
+        const uint32_t *triangle = indices + 3 * adjacency.triangles[i];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+            continue;
+        }
+
+        const float *corners[3];
+        const float *moved[3];
+        for (int k = 0; k < 3; k++) {
+            corners[k] = &positions[3 * triangle[k]];
+            moved[k] = triangle[k] == from ? &positions[3 * to] : corners[k];
+        }
+        float before[3];
+        float after[3];
+        Cross(before, corners[0], corners[1], corners[2]);
+        Cross(after, moved[0], moved[1], moved[2]);
+        float dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        // Rejects rotations of more than about 75 degrees, not only complete flips.
+        if (dot <= 0.25f * Length(before) * Length(after)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+size_t SimplifyMesh(uint32_t *destination,
+                    const uint32_t *indices,
+                    size_t index_count,
+                    const float *positions,
+                    size_t vertex_count,
+                    size_t positions_stride,
+                    size_t target_index_count,
+                    float target_error,
+                    float *result_error) {
+    memcpy(destination, indices, index_count * sizeof(uint32_t));
+    if (result_error) {
+        *result_error = 0.0f;
+    }
+    if (index_count <= target_index_count || vertex_count == 0) {
+        return index_count;
+    }
+
+    // Work in a unit cube so errors are relative and the float quadrics stay well conditioned.
+    std::vector<float> unit_positions(3 * vertex_count);
+    float bounds_min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float bounds_max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t v = 0; v < vertex_count; v++) {
+        memcpy(&unit_positions[3 * v],
+               reinterpret_cast<const uint8_t *>(positions) + v * positions_stride,
+               3 * sizeof(float));
+        for (int k = 0; k < 3; k++) {
+            float value = unit_positions[3 * v + k];
+            bounds_min[k] = std::min(bounds_min[k], value);
+            bounds_max[k] = std::max(bounds_max[k], value);
+        }
+    }
+    float extent = std::max(bounds_max[0] - bounds_min[0],
+                            std::max(bounds_max[1] - bounds_min[1],
+                                     bounds_max[2] - bounds_min[2]));
+    float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (size_t v = 0; v < vertex_count; v++) {
+        for (int k = 0; k < 3; k++) {
+            unit_positions[3 * v + k] = (unit_positions[3 * v + k] - bounds_min[k]) * scale;
+        }
+    }
+
+    Adjacency adjacency;
+    BuildAdjacency(adjacency, destination, index_count, vertex_count);
+    std::vector<VertexKind> kinds;
+    std::vector<uint32_t> border_next;
+    std::vector<uint32_t> border_prev;
+    ClassifyVertices(kinds, border_next, border_prev, adjacency, destination, index_count,
+                     unit_positions, vertex_count);
+    std::vector<Quadric> quadrics(vertex_count);
+    ComputeQuadrics(quadrics, destination, index_count, unit_positions, border_next);
+
+    float max_error = target_error * target_error;
+    float error = 0.0f;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint8_t> locked(vertex_count);
+    size_t result_count = index_count;
+
+    // Each pass ranks every possible collapse and applies the cheapest ones whose neighborhoods
+    // do not overlap, until no collapse is left under the error limit.
+    while (result_count > target_index_count) {
+        collapses.clear();
+        for (size_t i = 0; i < result_count; i++) {
+            uint32_t a = destination[i];
+            uint32_t b = destination[i - i % 3 + (i + 1) % 3];
+            uint32_t pair[2][2] = {{a, b}, {b, a}};
+            for (auto &edge : pair) {
+                if (!CanCollapse(kinds, border_next, border_prev, edge[0], edge[1])) {
+                    continue;
+                }
+                const float *target = &unit_positions[3 * edge[1]];
+                float weight = quadrics[edge[0]].w + quadrics[edge[1]].w;
+                float cost = (quadrics[edge[0]].Evaluate(target)
+                              + quadrics[edge[1]].Evaluate(target))
+                             / (weight > 0.0f ? weight : 1.0f);
+                collapses.push_back({edge[0], edge[1], cost});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.error < b.error;
+        });
+
+        for (size_t v = 0; v < vertex_count; v++) {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(locked.begin(), locked.end(), 0);
+        size_t triangles_to_remove = (result_count - target_index_count) / 3 + 1;
+        size_t triangles_removed = 0;
+        size_t collapse_count = 0;
+        for (const Collapse &collapse : collapses) {
+            if (triangles_removed >= triangles_to_remove || collapse.error > max_error) {
+                break;
+            }
+            if (locked[collapse.from] || locked[collapse.to]
+                || HasTriangleFlips(adjacency, destination, unit_positions, collapse.from,
+                                    collapse.to)) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            error = std::max(error, collapse.error);
+            // Lock the whole one-ring so the flip test above stays valid for this pass.
+            for (uint32_t i = adjacency.offsets[collapse.from];
+                 i < adjacency.offsets[collapse.from + 1]; i++) {
+                const uint32_t *triangle = destination + 3 * adjacency.triangles[i];
+                locked[triangle[0]] = locked[triangle[1]] = locked[triangle[2]] = 1;
+            }
+            triangles_removed += kinds[collapse.from] == VertexKind::kBorder ? 1 : 2;
+            collapse_count++;
+        }
+        if (collapse_count == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result_count; i += 3) {
+            uint32_t a = remap[destination[i + 0]];
+            uint32_t b = remap[destination[i + 1]];
+            uint32_t c = remap[destination[i + 2]];
+            if (a != b && b != c && c != a) {
+                destination[write++] = a;
+                destination[write++] = b;
+                destination[write++] = c;
+            }
+        }
+        result_count = write;
+        BuildAdjacency(adjacency, destination, result_count, vertex_count);
+    }
+
+    if (result_error) {
+        *result_error = std::sqrt(error) * extent;
+    }
+    return result_count;
+}
+
+std::vector<MeshLod> GenerateLodChain(std::vector<uint32_t> &indices,
+                                      const float *positions,
+                                      size_t vertex_count,
+                                      size_t positions_stride,
+                                      size_t max_lod_count,
+                                      float reduction,
+                                      float max_error) {
+    std::vector<MeshLod> lods(1);
+    lods[0].index_count = static_cast<uint32_t>(indices.size());
+
+    std::vector<uint32_t> simplified(indices.size());
+    std::vector<uint32_t> optimized(indices.size());
+    while (lods.size() < max_lod_count) {
+        const MeshLod &previous = lods.back();
+        size_t target = static_cast<size_t>(previous.index_count * reduction) / 3 * 3;
+        float level_error = 0.0f;
+        size_t count = SimplifyMesh(simplified.data(), indices.data() + previous.first_index,
+                                    previous.index_count, positions, vertex_count,
+                                    positions_stride, target, max_error, &level_error);
+        if (count == 0 || count > previous.index_count * 9 / 10) {
+            break;
+        }
+
+        OptimizeVertexCache(optimized.data(), simplified.data(), count, vertex_count);
+        MeshLod lod;
+        lod.first_index = static_cast<uint32_t>(indices.size());
+        lod.index_count = static_cast<uint32_t>(count);
+        // Each level is simplified from the previous one, so the deviations add up.
+        lod.error = previous.error + level_error;
+        indices.insert(indices.end(), optimized.begin(), optimized.begin() + count);
+        lods.push_back(lod);
+    }
+    return lods;
+}
+
+size_t SelectLod(const std::vector<MeshLod> &lods,
+                 float distance,
+                 float projection_scale,
+                 float viewport_height,
+                 float max_pixel_error) {
+    float pixels_per_unit = projection_scale * 0.5f * viewport_height
+                            / std::max(distance, 1e-6f);
+    size_t selected = 0;
+    for (size_t i = 1; i < lods.size(); i++) {
+        if (lods[i].error * pixels_per_unit <= max_pixel_error) {
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,53 @@
+#ifndef TINY_ENGINE_MESH_SIMPLIFIER_H
+#define TINY_ENGINE_MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_indices.h"
+
+namespace tiny_engine {
+
+// Reduces a triangle list towards target_index_count indices by collapsing edges in order of
+// their quadric error (Garland and Heckbert 1997). Vertices never move, a collapse only redirects
+// one vertex to a neighbor, so every level keeps using the original vertex buffer. Vertices on
+// attribute seams (same position, different vertex) and non-manifold vertices are kept, border
+// vertices only slide along the border. Stops early when the next collapse would exceed
+// target_error, given relative to the largest extent of the mesh. Returns the new index count
+// written to destination (which needs index_count entries); result_error receives the deviation
+// in model units.
+size_t SimplifyMesh(uint32_t *destination,
+                    const uint32_t *indices,
+                    size_t index_count,
+                    const float *positions,
+                    size_t vertex_count,
+                    size_t positions_stride,
+                    size_t target_index_count,
+                    float target_error,
+                    float *result_error = nullptr);
+
+// Appends up to max_lod_count - 1 coarser levels to indices, each with about reduction times the
+// triangles of the one before and its own vertex cache optimized order. The first returned level
+// is the unchanged input. Generation stops once a level gains less than 10% or the deviation
+// would exceed max_error (relative to the mesh extent).
+std::vector<MeshLod> GenerateLodChain(std::vector<uint32_t> &indices,
+                                      const float *positions,
+                                      size_t vertex_count,
+                                      size_t positions_stride,
+                                      size_t max_lod_count = 5,
+                                      float reduction = 0.5f,
+                                      float max_error = 0.05f);
+
+// Picks the coarsest level whose error projects to at most max_pixel_error pixels for an object
+// distance units in front of a perspective camera. projection_scale is proj[1][1] (the cotangent
+// of half the vertical field of view) and viewport_height is in pixels.
+size_t SelectLod(const std::vector<MeshLod> &lods,
+                 float distance,
+                 float projection_scale,
+                 float viewport_height,
+                 float max_pixel_error = 1.0f);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MESH_SIMPLIFIER_H
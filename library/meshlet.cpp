@@ -0,0 +1,324 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vertex_welder.h"
+
+namespace tiny_engine {
+
+namespace {
+
+// Triangles turned more than 60 degrees away from the meshlet's average normal start another
+// meshlet, wide normal cones can never be culled.
+const float kMinConeAlignment = 0.5f;
+// Score penalty, in new vertices, for a triangle facing 90 degrees away from the average normal.
+const float kConeWeight = 0.5f;
+
+void LoadPosition(float *position, const float *positions, size_t stride, uint32_t v) {
+    memcpy(position, reinterpret_cast<const uint8_t *>(positions) + v * stride,
+           3 * sizeof(float));
+}
+
+float Dot(const float *a, const float *b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Normalize(float *v) {
+    float length = std::sqrt(Dot(v, v));
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+void ComputeBounds(Meshlet &meshlet,
+                   const uint32_t *indices,
+                   const float *positions,
+                   size_t positions_stride) {
+    const uint32_t *triangles = indices + meshlet.first_index;
+    size_t triangle_count = meshlet.index_count / 3;
+
+    // Bounding box center, then the farthest corner. Not minimal, but close for the compact
+    // patches the builder produces.
+    float bounds_min[3];
+    LoadPosition(bounds_min, positions, positions_stride, triangles[0]);
+    float bounds_max[3] = {bounds_min[0], bounds_min[1], bounds_min[2]};
+    for (size_t i = 1; i < meshlet.index_count; i++) {
+        float p[3];
+        LoadPosition(p, positions, positions_stride, triangles[i]);
+        for (int k = 0; k < 3; k++) {
+            bounds_min[k] = std::min(bounds_min[k], p[k]);
+            bounds_max[k] = std::max(bounds_max[k], p[k]);
+        }
+    }
+    float radius_squared = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        meshlet.center[k] = 0.5f * (bounds_min[k] + bounds_max[k]);
+    }
+    for (size_t i = 0; i < meshlet.index_count; i++) {
+        float p[3];
+        LoadPosition(p, positions, positions_stride, triangles[i]);
+        float d[3] = {p[0] - meshlet.center[0], p[1] - meshlet.center[1],
+                      p[2] - meshlet.center[2]};
+        radius_squared = std::max(radius_squared, Dot(d, d));
+    }
+    meshlet.radius = std::sqrt(radius_squared);
+
+    // Normal cone around the average of the unit triangle normals.
+    std::vector<float> normals(3 * triangle_count);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (size_t t = 0; t < triangle_count; t++) {
+        float p0[3], p1[3], p2[3];
+        LoadPosition(p0, positions, positions_stride, triangles[3 * t + 0]);
+        LoadPosition(p1, positions, positions_stride, triangles[3 * t + 1]);
+        LoadPosition(p2, positions, positions_stride, triangles[3 * t + 2]);
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float *n = &normals[3 * t];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        Normalize(n);
+        for (int k = 0; k < 3; k++) {
+            axis[k] += n[k];
+        }
+    }
+    Normalize(axis);
+
+    float min_dot = 1.0f;
+    for (size_t t = 0; t < triangle_count; t++) {
+        min_dot = std::min(min_dot, Dot(&normals[3 * t], axis));
+    }
+    // Normals spread over (nearly) a half sphere, some triangle faces every camera.
+    if (min_dot <= 0.1f) {
+        meshlet.cone_cutoff = 1.0f;
+        return;
+    }
+
+    // Move the apex back along the axis until it is behind every triangle plane:
+    // dot(center - t * axis - corner, normal) = 0.
+    float max_t = 0.0f;
+    for (size_t t = 0; t < triangle_count; t++) {
+        float p0[3];
+        LoadPosition(p0, positions, positions_stride, triangles[3 * t]);
+        const float *n = &normals[3 * t];
+        float c[3] = {meshlet.center[0] - p0[0], meshlet.center[1] - p0[1],
+                      meshlet.center[2] - p0[2]};
+        max_t = std::max(max_t, Dot(c, n) / Dot(axis, n));
+    }
+    for (int k = 0; k < 3; k++) {
+        meshlet.cone_apex[k] = meshlet.center[k] - axis[k] * max_t;
+        meshlet.cone_axis[k] = axis[k];
+    }
+    // The normal cone has half angle acos(min_dot), triangles face away from cameras inside the
+    // opposite cone widened by 90 degrees, whose cosine is sin(acos(min_dot)).
+    meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+bool IsVisible(const Meshlet &meshlet, const float planes[6][4], const float *camera_position) {
+    for (int i = 0; i < 6; i++) {
+        if (Dot(planes[i], meshlet.center) + planes[i][3] < -meshlet.radius) {
+            return false;
+        }
+    }
+    float direction[3] = {meshlet.cone_apex[0] - camera_position[0],
+                          meshlet.cone_apex[1] - camera_position[1],
+                          meshlet.cone_apex[2] - camera_position[2]};
+    Normalize(direction);
+    return Dot(direction, meshlet.cone_axis) < meshlet.cone_cutoff;
+}
+
+} // namespace
+
+std::vector<Meshlet> BuildMeshlets(uint32_t *indices,
+                                   size_t index_count,
+                                   const float *positions,
+                                   size_t vertex_count,
+                                   size_t positions_stride,
+                                   size_t max_vertices,
+                                   size_t max_triangles) {
+    size_t triangle_count = index_count / 3;
+
+    // Triangles around each position, vertices split by a seam still connect their triangles.
+    std::vector<float> packed_positions(3 * vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        LoadPosition(&packed_positions[3 * v], positions, positions_stride,
+                     static_cast<uint32_t>(v));
+    }
+    std::vector<uint32_t> position_remap(vertex_count);
+    size_t position_count = GenerateVertexRemap(packed_positions.data(), vertex_count,
+                                                3 * sizeof(float), position_remap.data());
+    std::vector<uint32_t> offsets(position_count + 1, 0);
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        offsets[position_remap[indices[i]] + 1]++;
+    }
+    for (size_t p = 0; p < position_count; p++) {
+        offsets[p + 1] += offsets[p];
+    }
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; i++) {
+        adjacency[fill[position_remap[indices[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<float> normals(3 * triangle_count);
+    for (size_t t = 0; t < triangle_count; t++) {
+        float p0[3], p1[3], p2[3];
+        LoadPosition(p0, positions, positions_stride, indices[3 * t + 0]);
+        LoadPosition(p1, positions, positions_stride, indices[3 * t + 1]);
+        LoadPosition(p2, positions, positions_stride, indices[3 * t + 2]);
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float *n = &normals[3 * t];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        Normalize(n);
+    }
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> ordered;
+    ordered.reserve(triangle_count * 3);
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    // A vertex belongs to the current meshlet while its stamp matches, as in SplitMesh.
+    std::vector<uint32_t> stamps(vertex_count, UINT32_MAX);
+    uint32_t stamp = 0;
+    std::vector<uint32_t> meshlet_vertices;
+
+    auto new_vertex_count = [&](const uint32_t *triangle) {
+        size_t count = 0;
+        for (size_t j = 0; j < 3; j++) {
+            bool seen = stamps[triangle[j]] == stamp;
+            for (size_t k = 0; k < j && !seen; k++) {
+                seen = triangle[k] == triangle[j];
+            }
+            count += seen ? 0 : 1;
+        }
+        return count;
+    };
+
+    for (size_t seed = 0; seed < triangle_count; seed++) {
+        if (emitted[seed]) {
+            continue;
+        }
+
+        Meshlet meshlet;
+        meshlet.first_index = static_cast<uint32_t>(ordered.size());
+        meshlet_vertices.clear();
+        float axis[3] = {0.0f, 0.0f, 0.0f};
+        int64_t next = static_cast<int64_t>(seed);
+        while (next >= 0) {
+            const uint32_t *triangle = indices + 3 * next;
+            for (size_t j = 0; j < 3; j++) {
+                if (stamps[triangle[j]] != stamp) {
+                    stamps[triangle[j]] = stamp;
+                    meshlet_vertices.push_back(triangle[j]);
+                }
+                ordered.push_back(triangle[j]);
+            }
+            emitted[next] = 1;
+            meshlet.index_count += 3;
+            for (int k = 0; k < 3; k++) {
+                axis[k] += normals[3 * next + k];
+            }
+            if (meshlet.index_count / 3 >= max_triangles) {
+                break;
+            }
+
+            // Best neighbor: fewest new vertices, then closest to the current average normal.
+            float cone[3] = {axis[0], axis[1], axis[2]};
+            Normalize(cone);
+            next = -1;
+            float best_score = 0.0f;
+            for (uint32_t v : meshlet_vertices) {
+                uint32_t p = position_remap[v];
+                for (uint32_t i = offsets[p]; i < offsets[p + 1]; i++) {
+                    uint32_t candidate = adjacency[i];
+                    if (emitted[candidate]) {
+                        continue;
+                    }
+                    size_t extra = new_vertex_count(indices + 3 * candidate);
+                    if (meshlet_vertices.size() + extra > max_vertices) {
+                        continue;
+                    }
+                    float alignment = Dot(&normals[3 * candidate], cone);
+                    if (alignment < kMinConeAlignment) {
+                        continue;
+                    }
+                    float score = static_cast<float>(extra)
+                                  + kConeWeight * (1.0f - alignment);
+                    if (next < 0 || score < best_score) {
+                        best_score = score;
+                        next = candidate;
+                    }
+                }
+            }
+        }
+        meshlets.push_back(meshlet);
+        stamp++;
+    }
+
+    memcpy(indices, ordered.data(), ordered.size() * sizeof(uint32_t));
+    for (Meshlet &meshlet : meshlets) {
+        ComputeBounds(meshlet, indices, positions, positions_stride);
+    }
+    return meshlets;
+}
+
+void ExtractFrustumPlanes(float planes[6][4], const float *matrix) {
+    // Row i of the column major matrix.
+    auto row = [matrix](int i, int j) { return matrix[j * 4 + i]; };
+    for (int j = 0; j < 4; j++) {
+        planes[0][j] = row(3, j) + row(0, j);
+        planes[1][j] = row(3, j) - row(0, j);
+        planes[2][j] = row(3, j) + row(1, j);
+        planes[3][j] = row(3, j) - row(1, j);
+        planes[4][j] = row(2, j);
+        planes[5][j] = row(3, j) - row(2, j);
+    }
+    for (int i = 0; i < 6; i++) {
+        float length = std::sqrt(Dot(planes[i], planes[i]));
+        if (length > 0.0f) {
+            for (int j = 0; j < 4; j++) {
+                planes[i][j] /= length;
+            }
+        }
+    }
+}
+
+size_t CullMeshlets(void *destination,
+                    const std::vector<Meshlet> &meshlets,
+                    const void *index_data,
+                    size_t index_size,
+                    const float planes[6][4],
+                    const float camera_position[3]) {
+    auto *output = static_cast<uint8_t *>(destination);
+    const auto *input = static_cast<const uint8_t *>(index_data);
+    size_t written = 0;
+
+    // Neighboring visible meshlets are contiguous in the index list, copy them in one go.
+    size_t run_start = 0;
+    size_t run_count = 0;
+    for (const Meshlet &meshlet : meshlets) {
+        if (!IsVisible(meshlet, planes, camera_position)) {
+            continue;
+        }
+        if (run_count > 0 && run_start + run_count == meshlet.first_index) {
+            run_count += meshlet.index_count;
+            continue;
+        }
+        memcpy(output + written * index_size, input + run_start * index_size,
+               run_count * index_size);
+        written += run_count;
+        run_start = meshlet.first_index;
+        run_count = meshlet.index_count;
+    }
+    memcpy(output + written * index_size, input + run_start * index_size,
+           run_count * index_size);
+    return written + run_count;
+}
+
+} // namespace tiny_engine
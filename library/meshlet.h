@@ -0,0 +1,59 @@
+#ifndef TINY_ENGINE_MESHLET_H
+#define TINY_ENGINE_MESHLET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// A run of at most kMeshletMaxTriangles triangles of an index list touching at most
+// kMeshletMaxVertices vertices, with bounds in model space for culling the whole run at once.
+struct Meshlet {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    float center[3] = {0.0f, 0.0f, 0.0f};
+    float radius = 0.0f;
+    // Backface cone: every triangle faces away from cameras at positions p with
+    // dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff. A cutoff of 1 never culls.
+    float cone_apex[3] = {0.0f, 0.0f, 0.0f};
+    float cone_axis[3] = {0.0f, 0.0f, 0.0f};
+    float cone_cutoff = 1.0f;
+};
+
+// Limits that map onto mesh shading hardware as well (NVIDIA recommends 64 / 126, 124 keeps the
+// 8-bit local triangle list a multiple of 4 bytes).
+const size_t kMeshletMaxVertices = 64;
+const size_t kMeshletMaxTriangles = 124;
+
+// Groups the triangles of an index list into meshlets and reorders indices so every meshlet is a
+// contiguous range. Meshlets grow across neighboring triangles (connected by position, so UV
+// seams do not cut them) preferring triangles which add few vertices and keep the normal cone
+// narrow. positions are float3 at positions_stride bytes apart.
+std::vector<Meshlet> BuildMeshlets(uint32_t *indices,
+                                   size_t index_count,
+                                   const float *positions,
+                                   size_t vertex_count,
+                                   size_t positions_stride,
+                                   size_t max_vertices = kMeshletMaxVertices,
+                                   size_t max_triangles = kMeshletMaxTriangles);
+
+// Frustum planes (a, b, c, d), inside where a*x + b*y + c*z + d >= 0, of a column major
+// projection * view * model matrix with Vulkan's 0..1 depth range. The planes live in the space
+// the matrix transforms from, so with a model matrix included they can be tested against
+// model space bounds directly. Planes are normalized for sphere tests.
+void ExtractFrustumPlanes(float planes[6][4], const float *matrix);
+
+// Copies the index ranges of the meshlets which are inside the frustum and not back-facing from
+// index_data (index_size bytes per index) into destination, which needs room for all of them.
+// camera_position is in the same space as the planes. Returns the number of indices written.
+size_t CullMeshlets(void *destination,
+                    const std::vector<Meshlet> &meshlets,
+                    const void *index_data,
+                    size_t index_size,
+                    const float planes[6][4],
+                    const float camera_position[3]);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MESHLET_H
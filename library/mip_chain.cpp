@@ -0,0 +1,221 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TINY_ENGINE_MIP_CHAIN_NEON
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TINY_ENGINE_MIP_CHAIN_SSE2
+#endif
+
+namespace tiny_engine {
+
+namespace {
+
+// 4096 buckets keep 8-bit results within 1 of exact rounding. Next to black, where sRGB steps
+// are the finest in linear space (1/3294), one bucket is about 0.8 of a step, so a value near a
+// step boundary may round to the neighbouring code. mip_chain_test holds it to that bound.
+const int kEncodeBits = 12;
+
+// 8-bit to 16-bit linear and back, for sRGB and for plain unorm channels.
+struct ConversionTables {
+    uint16_t decode_srgb[256];
+    uint16_t decode_unorm[256];
+    uint8_t encode_srgb[1 << kEncodeBits];
+    uint8_t encode_unorm[1 << kEncodeBits];
+
+    ConversionTables() {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            float linear = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            decode_srgb[i] = static_cast<uint16_t>(std::lround(linear * 65535.0f));
+            decode_unorm[i] = static_cast<uint16_t>(i * 257);
+        }
+        const int bucket_count = 1 << kEncodeBits;
+        for (int i = 0; i < bucket_count; i++) {
+            float linear = (i + 0.5f) / bucket_count;
+            float c = linear <= 0.0031308f ? linear * 12.92f
+                                           : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            encode_srgb[i] = static_cast<uint8_t>(std::lround(c * 255.0f));
+            encode_unorm[i] = static_cast<uint8_t>(std::lround(linear * 255.0f));
+        }
+    }
+};
+
+const ConversionTables &GetConversionTables() {
+    static const ConversionTables tables;
+    return tables;
+}
+
+void DownsampleRow(uint16_t *destination,
+                   const uint16_t *row0,
+                   const uint16_t *row1,
+                   uint32_t width,
+                   uint32_t source_width) {
+    uint32_t x = 0;
+    if (source_width >= 2) {
+#if defined(TINY_ENGINE_MIP_CHAIN_NEON)
+        // Two destination pixels from four source pixels of each row per iteration.
+        for (; x + 2 <= width; x += 2) {
+            uint16x8_t a0 = vld1q_u16(row0 + x * 8);
+            uint16x8_t a1 = vld1q_u16(row0 + x * 8 + 8);
+            uint16x8_t b0 = vld1q_u16(row1 + x * 8);
+            uint16x8_t b1 = vld1q_u16(row1 + x * 8 + 8);
+            uint32x4_t sum0 = vaddq_u32(vaddl_u16(vget_low_u16(a0), vget_high_u16(a0)),
+                                        vaddl_u16(vget_low_u16(b0), vget_high_u16(b0)));
+            uint32x4_t sum1 = vaddq_u32(vaddl_u16(vget_low_u16(a1), vget_high_u16(a1)),
+                                        vaddl_u16(vget_low_u16(b1), vget_high_u16(b1)));
+            vst1q_u16(destination + x * 4,
+                      vcombine_u16(vrshrn_n_u32(sum0, 2), vrshrn_n_u32(sum1, 2)));
+        }
+#elif defined(TINY_ENGINE_MIP_CHAIN_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi32(2);
+        // SSE2 has no unsigned 32 to 16-bit pack, so pack with a bias of 32768 and flip it back.
+        const __m128i bias32 = _mm_set1_epi32(32768);
+        const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+        for (; x + 2 <= width; x += 2) {
+            __m128i sum[2];
+            for (int i = 0; i < 2; i++) {
+                __m128i a = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(row0 + (x + i) * 8));
+                __m128i b = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(row1 + (x + i) * 8));
+                __m128i s = _mm_add_epi32(_mm_unpacklo_epi16(a, zero),
+                                          _mm_unpackhi_epi16(a, zero));
+                s = _mm_add_epi32(s, _mm_add_epi32(_mm_unpacklo_epi16(b, zero),
+                                                   _mm_unpackhi_epi16(b, zero)));
+                s = _mm_srli_epi32(_mm_add_epi32(s, rounding), 2);
+                sum[i] = _mm_sub_epi32(s, bias32);
+            }
+            __m128i packed = _mm_xor_si128(_mm_packs_epi32(sum[0], sum[1]), bias16);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x * 4), packed);
+        }
+#endif
+    }
+    for (; x < width; x++) {
+        uint32_t x0 = std::min(x * 2, source_width - 1) * 4;
+        uint32_t x1 = std::min(x * 2 + 1, source_width - 1) * 4;
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+            destination[x * 4 + c] = static_cast<uint16_t>((sum + 2) >> 2);
+        }
+    }
+}
+
+void Encode(uint8_t *destination, const uint16_t *source, size_t pixel_count, bool srgb) {
+    const ConversionTables &tables = GetConversionTables();
+    const uint8_t *color = srgb ? tables.encode_srgb : tables.encode_unorm;
+    const int shift = 16 - kEncodeBits;
+    for (size_t i = 0; i < pixel_count; i++) {
+        destination[i * 4] = color[source[i * 4] >> shift];
+        destination[i * 4 + 1] = color[source[i * 4 + 1] >> shift];
+        destination[i * 4 + 2] = color[source[i * 4 + 2] >> shift];
+        destination[i * 4 + 3] = tables.encode_unorm[source[i * 4 + 3] >> shift];
+    }
+}
+
+} // namespace
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> GetMipChainLayout(uint32_t width,
+                                        uint32_t height,
+                                        uint32_t mip_levels,
+                                        size_t pixel_size,
+                                        uint32_t block_dimension) {
+    std::vector<MipLevel> levels(mip_levels);
+    size_t offset = 0;
+    for (MipLevel &level : levels) {
+        level.offset = offset;
+        level.width = width;
+        level.height = height;
+        offset += static_cast<size_t>((width + block_dimension - 1) / block_dimension)
+                  * ((height + block_dimension - 1) / block_dimension) * pixel_size;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return levels;
+}
+
+size_t GetMipChainSize(uint32_t width,
+                       uint32_t height,
+                       uint32_t mip_levels,
+                       size_t pixel_size,
+                       uint32_t block_dimension) {
+    std::vector<MipLevel> levels = GetMipChainLayout(width,
+                                                     height,
+                                                     mip_levels,
+                                                     pixel_size,
+                                                     block_dimension);
+    const MipLevel &last = levels.back();
+    return last.offset
+           + static_cast<size_t>((last.width + block_dimension - 1) / block_dimension)
+             * ((last.height + block_dimension - 1) / block_dimension) * pixel_size;
+}
+
+void DownsampleRgba16(uint16_t *destination,
+                      const uint16_t *source,
+                      uint32_t width,
+                      uint32_t height) {
+    uint32_t destination_width = std::max(width / 2, 1u);
+    uint32_t destination_height = std::max(height / 2, 1u);
+    size_t pitch = static_cast<size_t>(width) * 4;
+    for (uint32_t y = 0; y < destination_height; y++) {
+        const uint16_t *row0 = source + std::min(y * 2, height - 1) * pitch;
+        const uint16_t *row1 = source + std::min(y * 2 + 1, height - 1) * pitch;
+        DownsampleRow(destination + static_cast<size_t>(y) * destination_width * 4,
+                      row0,
+                      row1,
+                      destination_width,
+                      width);
+    }
+}
+
+void GenerateMipChain(uint8_t *destination,
+                      const uint8_t *pixels,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t mip_levels,
+                      bool srgb) {
+    std::vector<MipLevel> levels = GetMipChainLayout(width, height, mip_levels, 4);
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    if (destination != pixels) {
+        memcpy(destination, pixels, pixel_count * 4);
+    }
+    if (mip_levels < 2) {
+        return;
+    }
+
+    const ConversionTables &tables = GetConversionTables();
+    const uint16_t *color = srgb ? tables.decode_srgb : tables.decode_unorm;
+    std::vector<uint16_t> current(pixel_count * 4);
+    for (size_t i = 0; i < pixel_count; i++) {
+        current[i * 4] = color[pixels[i * 4]];
+        current[i * 4 + 1] = color[pixels[i * 4 + 1]];
+        current[i * 4 + 2] = color[pixels[i * 4 + 2]];
+        current[i * 4 + 3] = tables.decode_unorm[pixels[i * 4 + 3]];
+    }
+
+    std::vector<uint16_t> next(static_cast<size_t>(levels[1].width) * levels[1].height * 4);
+    for (uint32_t i = 1; i < mip_levels; i++) {
+        DownsampleRgba16(next.data(), current.data(), levels[i - 1].width, levels[i - 1].height);
+        Encode(destination + levels[i].offset,
+               next.data(),
+               static_cast<size_t>(levels[i].width) * levels[i].height,
+               srgb);
+        std::swap(current, next);
+    }
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,58 @@
+#ifndef TINY_ENGINE_MIP_CHAIN_H
+#define TINY_ENGINE_MIP_CHAIN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Placement of one level in a tightly packed mip chain, offset is in bytes from level 0. width
+// and height are in pixels also for block compressed chains.
+struct MipLevel {
+    size_t offset = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Number of levels of a full chain down to 1x1.
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+// pixel_size is the size of a block of block_dimension x block_dimension pixels for block
+// compressed formats, partial blocks at the edges take a whole block.
+std::vector<MipLevel> GetMipChainLayout(uint32_t width,
+                                        uint32_t height,
+                                        uint32_t mip_levels,
+                                        size_t pixel_size,
+                                        uint32_t block_dimension = 1);
+
+size_t GetMipChainSize(uint32_t width,
+                       uint32_t height,
+                       uint32_t mip_levels,
+                       size_t pixel_size,
+                       uint32_t block_dimension = 1);
+
+// Writes the RGBA8 image pixels and mip_levels - 1 box filtered levels below it to destination,
+// laid out as GetMipChainLayout(width, height, mip_levels, 4). With srgb the color channels are
+// filtered in linear space (alpha always is). Levels are filtered from a 16-bit linear copy of
+// the one above rather than from its 8-bit result so rounding does not add up down the chain.
+// destination is only written, sequentially, so it may be write combined staging memory.
+// pixels may be destination itself, level 0 is then left in place and read once.
+void GenerateMipChain(uint8_t *destination,
+                      const uint8_t *pixels,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t mip_levels,
+                      bool srgb);
+
+// One 2x2 box filter step on 16-bit RGBA pixels, rounding to nearest. Odd trailing rows and
+// columns are dropped and dimensions of 1 are clamped, like a linear filtered blit. destination
+// needs max(width / 2, 1) * max(height / 2, 1) pixels. Uses NEON or SSE2 where available.
+void DownsampleRgba16(uint16_t *destination,
+                      const uint16_t *source,
+                      uint32_t width,
+                      uint32_t height);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_MIP_CHAIN_H
@@ -0,0 +1,379 @@
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace tiny_engine {
+
+namespace {
+
+// Below this a chunk costs more in thread start up than it saves.
+const size_t kMinChunkSize = 256 * 1024;
+
+enum RecordType {
+    kRecordOther,
+    kRecordPosition,
+    kRecordTexcoord,
+    kRecordNormal,
+    kRecordFace
+};
+
+struct Chunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+
+    size_t position_count = 0;
+    size_t texcoord_count = 0;
+    size_t normal_count = 0;
+
+    // Number of records of each kind in all chunks before this one.
+    size_t position_base = 0;
+    size_t texcoord_base = 0;
+    size_t normal_base = 0;
+
+    std::vector<ObjIndex> indices;
+    std::string error;
+};
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char *SkipSpace(const char *p, const char *end) {
+    while (p < end && IsSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+inline const char *FindLineEnd(const char *p, const char *end) {
+    const void *line_end = memchr(p, '\n', end - p);
+    return line_end == nullptr ? end : static_cast<const char *>(line_end);
+}
+
+// Classifies the line starting at p and moves p past the keyword.
+inline RecordType ParseRecordType(const char *&p, const char *end) {
+    p = SkipSpace(p, end);
+    if (end - p < 2) return kRecordOther;
+
+    if (p[0] == 'v') {
+        if (IsSpace(p[1])) {
+            p += 2;
+            return kRecordPosition;
+        }
+        if (end - p >= 3 && IsSpace(p[2])) {
+            if (p[1] == 't') {
+                p += 3;
+                return kRecordTexcoord;
+            }
+            if (p[1] == 'n') {
+                p += 3;
+                return kRecordNormal;
+            }
+        }
+    } else if (p[0] == 'f' && IsSpace(p[1])) {
+        p += 2;
+        return kRecordFace;
+    }
+    return kRecordOther;
+}
+
+inline double Pow10(int exponent) {
+    // Powers of ten up to 1e22 are exact in a double.
+    static const double kTable[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    return exponent <= 22 ? kTable[exponent] : std::pow(10.0, exponent);
+}
+
+// Decimal float without locale lookups or errno, at most one rounding step away from strtof
+// for the values found in meshes. Returns nullptr if there is no number at p.
+inline const char *ParseFloat(const char *p, const char *end, float &value) {
+    p = SkipSpace(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    for (; p < end && IsDigit(*p); p++) {
+        has_digits = true;
+        if (significant_digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant_digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && IsDigit(*p); p++) {
+            has_digits = true;
+            if (significant_digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant_digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!has_digits) return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negative_exponent = *q == '-';
+            q++;
+        }
+        if (q < end && IsDigit(*q)) {
+            int explicit_exponent = 0;
+            for (; q < end && IsDigit(*q); q++) {
+                explicit_exponent = std::min(explicit_exponent * 10 + (*q - '0'), 10000);
+            }
+            exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            p = q;
+        }
+    }
+
+    double result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / Pow10(-exponent) : result * Pow10(exponent);
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+inline const char *ParseInt(const char *p, const char *end, int64_t &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || !IsDigit(*p)) return nullptr;
+
+    int64_t result = 0;
+    for (; p < end && IsDigit(*p); p++) {
+        result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+// OBJ indices are 1-based, negative ones count back from the last record read so far.
+inline bool ResolveIndex(int64_t raw, size_t count_so_far, size_t total, int32_t &index) {
+    int64_t resolved = raw > 0 ? raw - 1 : static_cast<int64_t>(count_so_far) + raw;
+    if (raw == 0 || resolved < 0 || resolved >= static_cast<int64_t>(total)) {
+        return false;
+    }
+    index = static_cast<int32_t>(resolved);
+    return true;
+}
+
+template<typename Function>
+void RunParallel(size_t count, Function function) {
+    std::vector<std::thread> threads;
+    threads.reserve(count > 0 ? count - 1 : 0);
+    for (size_t i = 1; i < count; i++) {
+        threads.emplace_back(function, i);
+    }
+    if (count > 0) {
+        function(0);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void CountRecords(Chunk &chunk) {
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *line_end = FindLineEnd(p, chunk.end);
+        switch (ParseRecordType(p, line_end)) {
+            case kRecordPosition:
+                chunk.position_count++;
+                break;
+            case kRecordTexcoord:
+                chunk.texcoord_count++;
+                break;
+            case kRecordNormal:
+                chunk.normal_count++;
+                break;
+            default:
+                break;
+        }
+        p = line_end + 1;
+    }
+}
+
+bool ParseFloats(const char *p, const char *end, float *values, int required, int optional) {
+    for (int i = 0; i < required + optional; i++) {
+        const char *next = ParseFloat(p, end, values[i]);
+        if (next == nullptr) {
+            if (i < required) return false;
+            values[i] = 0.0f;
+            continue;
+        }
+        p = next;
+    }
+    return true;
+}
+
+void ParseChunk(Chunk &chunk, ObjModel &model) {
+    size_t position = chunk.position_base;
+    size_t texcoord = chunk.texcoord_base;
+    size_t normal = chunk.normal_base;
+    size_t position_total = model.positions.size() / 3;
+    size_t texcoord_total = model.texcoords.size() / 2;
+    size_t normal_total = model.normals.size() / 3;
+    std::vector<ObjIndex> polygon;
+
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *line_end = FindLineEnd(p, chunk.end);
+        switch (ParseRecordType(p, line_end)) {
+            case kRecordPosition:
+                if (!ParseFloats(p, line_end, &model.positions[3 * position++], 3, 0)) {
+                    chunk.error = "invalid vertex position";
+                    return;
+                }
+                break;
+            case kRecordTexcoord:
+                if (!ParseFloats(p, line_end, &model.texcoords[2 * texcoord++], 1, 1)) {
+                    chunk.error = "invalid texture coordinate";
+                    return;
+                }
+                break;
+            case kRecordNormal:
+                if (!ParseFloats(p, line_end, &model.normals[3 * normal++], 3, 0)) {
+                    chunk.error = "invalid vertex normal";
+                    return;
+                }
+                break;
+            case kRecordFace:
+                polygon.clear();
+                for (p = SkipSpace(p, line_end); p < line_end && *p != '#';
+                     p = SkipSpace(p, line_end)) {
+                    ObjIndex index;
+                    int64_t raw = 0;
+                    p = ParseInt(p, line_end, raw);
+                    if (p == nullptr || !ResolveIndex(raw, position, position_total,
+                                                      index.position)) {
+                        chunk.error = "invalid face position index";
+                        return;
+                    }
+                    if (p < line_end && *p == '/') {
+                        p++;
+                        if (p < line_end && *p != '/') {
+                            p = ParseInt(p, line_end, raw);
+                            if (p == nullptr || !ResolveIndex(raw, texcoord, texcoord_total,
+                                                              index.texcoord)) {
+                                chunk.error = "invalid face texture coordinate index";
+                                return;
+                            }
+                        }
+                        if (p < line_end && *p == '/') {
+                            p = ParseInt(p + 1, line_end, raw);
+                            if (p == nullptr || !ResolveIndex(raw, normal, normal_total,
+                                                              index.normal)) {
+                                chunk.error = "invalid face normal index";
+                                return;
+                            }
+                        }
+                    }
+                    polygon.push_back(index);
+                }
+                if (polygon.size() < 3) {
+                    chunk.error = "face with less than 3 vertices";
+                    return;
+                }
+                for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                    chunk.indices.push_back(polygon[0]);
+                    chunk.indices.push_back(polygon[i]);
+                    chunk.indices.push_back(polygon[i + 1]);
+                }
+                break;
+            default:
+                break;
+        }
+        p = line_end + 1;
+    }
+}
+
+} // namespace
+
+ObjModel ParseObj(const char *data, size_t size, unsigned thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(thread_count,
+                                                              size / kMinChunkSize));
+
+    // Split at line boundaries so no record straddles two chunks.
+    const char *end = data + size;
+    std::vector<Chunk> chunks(chunk_count);
+    const char *begin = data;
+    for (size_t i = 0; i < chunk_count; i++) {
+        const char *chunk_end = i + 1 == chunk_count ? end : data + size / chunk_count * (i + 1);
+        if (chunk_end < begin) {
+            chunk_end = begin;
+        }
+        if (chunk_end < end) {
+            chunk_end = FindLineEnd(chunk_end, end);
+            chunk_end = chunk_end < end ? chunk_end + 1 : end;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = chunk_end;
+        begin = chunk_end;
+    }
+
+    // Counting first lets every chunk write its attributes straight into the final arrays and
+    // resolve relative indices, which need the number of records before the chunk.
+    RunParallel(chunk_count, [&chunks](size_t i) {
+        CountRecords(chunks[i]);
+    });
+
+    size_t position_count = 0, texcoord_count = 0, normal_count = 0;
+    for (auto &chunk : chunks) {
+        chunk.position_base = position_count;
+        chunk.texcoord_base = texcoord_count;
+        chunk.normal_base = normal_count;
+        position_count += chunk.position_count;
+        texcoord_count += chunk.texcoord_count;
+        normal_count += chunk.normal_count;
+    }
+
+    ObjModel model;
+    model.positions.resize(3 * position_count);
+    model.texcoords.resize(2 * texcoord_count);
+    model.normals.resize(3 * normal_count);
+
+    RunParallel(chunk_count, [&chunks, &model](size_t i) {
+        ParseChunk(chunks[i], model);
+    });
+
+    size_t index_count = 0;
+    for (auto &chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error("failed to parse obj: " + chunk.error + "!");
+        }
+        index_count += chunk.indices.size();
+    }
+    model.indices.reserve(index_count);
+    for (auto &chunk : chunks) {
+        model.indices.insert(model.indices.end(), chunk.indices.begin(), chunk.indices.end());
+        std::vector<ObjIndex>().swap(chunk.indices);
+    }
+    return model;
+}
+
+} // namespace tiny_engine
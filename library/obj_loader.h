@@ -0,0 +1,32 @@
+#ifndef TINY_ENGINE_OBJ_LOADER_H
+#define TINY_ENGINE_OBJ_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// 0-based indices into ObjModel's attribute arrays, -1 if the face vertex does not have one.
+struct ObjIndex {
+    int32_t position = -1;
+    int32_t texcoord = -1;
+    int32_t normal = -1;
+};
+
+struct ObjModel {
+    std::vector<float> positions;  // x, y, z
+    std::vector<float> texcoords;  // u, v
+    std::vector<float> normals;    // x, y, z
+    std::vector<ObjIndex> indices; // three per triangle, polygons are fan triangulated
+};
+
+// Parses the v/vt/vn/f records of a Wavefront OBJ file, everything else (groups, materials,
+// smoothing groups) is skipped. The text is split into line aligned chunks which are parsed on
+// thread_count threads (0 picks one per core), results are merged in file order so the output
+// does not depend on the thread count.
+ObjModel ParseObj(const char *data, size_t size, unsigned thread_count = 0);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_OBJ_LOADER_H
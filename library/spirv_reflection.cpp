@@ -0,0 +1,510 @@
+#include "spirv_reflection.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "log.h"
+#include "mesh_cache.h"
+
+namespace tiny_engine {
+
+namespace {
+
+// The parts of the SPIR-V specification the reflection reads, spirv.h is not in the NDK's
+// Vulkan headers.
+const uint32_t kMagic = 0x07230203;
+const size_t kHeaderWords = 5;
+
+enum Op : uint32_t {
+    kOpEntryPoint = 15,
+    kOpTypeInt = 21,
+    kOpTypeFloat = 22,
+    kOpTypeVector = 23,
+    kOpTypeImage = 25,
+    kOpTypeSampler = 26,
+    kOpTypeSampledImage = 27,
+    kOpTypeArray = 28,
+    kOpTypeRuntimeArray = 29,
+    kOpTypeStruct = 30,
+    kOpTypePointer = 32,
+    kOpConstant = 43,
+    kOpFunction = 54,
+    kOpFunctionEnd = 56,
+    kOpVariable = 59,
+    kOpDecorate = 71
+};
+
+enum Decoration : uint32_t {
+    kDecorationBufferBlock = 3,
+    kDecorationBuiltIn = 11,
+    kDecorationLocation = 30,
+    kDecorationBinding = 33,
+    kDecorationDescriptorSet = 34
+};
+
+enum StorageClass : uint32_t {
+    kStorageClassUniformConstant = 0,
+    kStorageClassInput = 1,
+    kStorageClassUniform = 2,
+    kStorageClassStorageBuffer = 12
+};
+
+enum Dim : uint32_t {
+    kDimBuffer = 5,
+    kDimSubpassData = 6
+};
+
+// One result id, with whichever fields its instruction sets.
+struct Id {
+    uint32_t op = 0;
+    // Element, component, pointee or image type.
+    uint32_t type = 0;
+    // Component count, constant value, storage class or image dimension.
+    uint32_t value = 0;
+    // Bit width, or 2 for storage images.
+    uint32_t width = 0;
+    bool is_signed = false;
+    bool buffer_block = false;
+    bool builtin = false;
+    bool has_location = false;
+    uint32_t location = 0;
+    uint32_t set = 0;
+    uint32_t binding = 0;
+};
+
+VkShaderStageFlags GetStage(uint32_t execution_model) {
+    switch (execution_model) {
+        case 0:
+            return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1:
+            return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2:
+            return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3:
+            return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4:
+            return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5:
+            return VK_SHADER_STAGE_COMPUTE_BIT;
+        default:
+            return 0;
+    }
+}
+
+VkDescriptorType GetImageDescriptorType(const Id &image) {
+    if (image.value == kDimSubpassData) {
+        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+    if (image.value == kDimBuffer) {
+        return image.width == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+    }
+    return image.width == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+}
+
+VkFormat GetInputFormat(const Id &scalar, uint32_t components) {
+    static const VkFormat kFloatFormats[] = {VK_FORMAT_R32_SFLOAT,
+                                             VK_FORMAT_R32G32_SFLOAT,
+                                             VK_FORMAT_R32G32B32_SFLOAT,
+                                             VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat kSintFormats[] = {VK_FORMAT_R32_SINT,
+                                            VK_FORMAT_R32G32_SINT,
+                                            VK_FORMAT_R32G32B32_SINT,
+                                            VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat kUintFormats[] = {VK_FORMAT_R32_UINT,
+                                            VK_FORMAT_R32G32_UINT,
+                                            VK_FORMAT_R32G32B32_UINT,
+                                            VK_FORMAT_R32G32B32A32_UINT};
+    if (scalar.width != 32 || components < 1 || components > 4) {
+        return VK_FORMAT_UNDEFINED;
+    }
+    if (scalar.op == kOpTypeFloat) {
+        return kFloatFormats[components - 1];
+    }
+    if (scalar.op == kOpTypeInt) {
+        return scalar.is_signed ? kSintFormats[components - 1] : kUintFormats[components - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+} // namespace
+
+bool ReflectShader(const void *code, size_t size, ShaderReflection &reflection) {
+    reflection = ShaderReflection();
+    // The code comes from a std::vector<char>, copy rather than assume it is word aligned.
+    std::vector<uint32_t> words(size / sizeof(uint32_t));
+    memcpy(words.data(), code, words.size() * sizeof(uint32_t));
+    if (size % sizeof(uint32_t) != 0 || words.size() < kHeaderWords || words[0] != kMagic) {
+        LOGW("not a SPIR-V module");
+        return false;
+    }
+    uint32_t bound = words[3];
+    if (bound > (1u << 22)) {
+        LOGW("SPIR-V id bound %u is out of range", bound);
+        return false;
+    }
+    std::vector<Id> ids(bound);
+    std::vector<uint32_t> variables;
+    auto valid = [bound](uint32_t id) { return id != 0 && id < bound; };
+
+    // Types, decorations and global variables all come before the first function. Of the
+    // functions only the word counts are read, a module ends with OpFunctionEnd so one cut off
+    // anywhere is rejected.
+    bool functions = false;
+    uint32_t last_op = 0;
+    for (size_t i = kHeaderWords; i < words.size();) {
+        uint32_t op = words[i] & 0xffff;
+        uint32_t count = words[i] >> 16;
+        if (count == 0 || i + count > words.size()) {
+            LOGW("truncated SPIR-V instruction at word %zu", i);
+            return false;
+        }
+        const uint32_t *operands = &words[i + 1];
+        i += count;
+        last_op = op;
+        functions = functions || op == kOpFunction;
+        if (functions) {
+            continue;
+        }
+        if (op == kOpEntryPoint && count >= 3) {
+            if (reflection.stages != 0) {
+                LOGW("SPIR-V modules with several entry points are not supported");
+                return false;
+            }
+            reflection.stages = GetStage(operands[0]);
+            continue;
+        }
+        if (op == kOpDecorate && count >= 3) {
+            if (!valid(operands[0])) {
+                continue;
+            }
+            Id &target = ids[operands[0]];
+            uint32_t literal = count >= 4 ? operands[2] : 0;
+            switch (operands[1]) {
+                case kDecorationBufferBlock:
+                    target.buffer_block = true;
+                    break;
+                case kDecorationBuiltIn:
+                    target.builtin = true;
+                    break;
+                case kDecorationLocation:
+                    target.has_location = true;
+                    target.location = literal;
+                    break;
+                case kDecorationBinding:
+                    target.binding = literal;
+                    break;
+                case kDecorationDescriptorSet:
+                    target.set = literal;
+                    break;
+                default:
+                    break;
+            }
+            continue;
+        }
+
+        // Every other instruction read has its result id first, except constants and
+        // variables which have the result type first.
+        bool typed = op == kOpConstant || op == kOpVariable;
+        if (count < (typed ? 3u : 2u)) {
+            continue;
+        }
+        uint32_t result = typed ? operands[1] : operands[0];
+        if (!valid(result)) {
+            continue;
+        }
+        Id &id = ids[result];
+        switch (op) {
+            case kOpTypeInt:
+                if (count >= 4) {
+                    id.op = op;
+                    id.width = operands[1];
+                    id.is_signed = operands[2] != 0;
+                }
+                break;
+            case kOpTypeFloat:
+                if (count >= 3) {
+                    id.op = op;
+                    id.width = operands[1];
+                }
+                break;
+            case kOpTypeVector:
+            case kOpTypePointer:
+                if (count >= 4) {
+                    id.op = op;
+                    id.type = op == kOpTypeVector ? operands[1] : operands[2];
+                    id.value = op == kOpTypeVector ? operands[2] : operands[1];
+                }
+                break;
+            case kOpTypeImage:
+                if (count >= 9) {
+                    id.op = op;
+                    id.value = operands[2];
+                    id.width = operands[6];
+                }
+                break;
+            case kOpTypeSampledImage:
+            case kOpTypeArray:
+            case kOpTypeRuntimeArray:
+                if (count >= 3) {
+                    id.op = op;
+                    id.type = operands[1];
+                    // The length id of an array, resolved once all constants are known.
+                    id.value = op == kOpTypeArray && count >= 4 ? operands[2] : 0;
+                }
+                break;
+            case kOpTypeSampler:
+            case kOpTypeStruct:
+                id.op = op;
+                break;
+            case kOpConstant:
+                if (count >= 4) {
+                    id.op = op;
+                    id.value = operands[2];
+                }
+                break;
+            case kOpVariable:
+                if (count >= 4) {
+                    id.op = op;
+                    id.type = operands[0];
+                    id.value = operands[2];
+                    variables.push_back(result);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (last_op != kOpFunctionEnd) {
+        LOGW("truncated SPIR-V module");
+        return false;
+    }
+    if (reflection.stages == 0) {
+        LOGW("SPIR-V module has no supported entry point");
+        return false;
+    }
+
+    for (uint32_t variable_id : variables) {
+        const Id &variable = ids[variable_id];
+        if (!valid(variable.type) || ids[variable.type].op != kOpTypePointer
+            || !valid(ids[variable.type].type)) {
+            LOGW("SPIR-V variable %u has no pointer type", variable_id);
+            return false;
+        }
+        uint32_t storage_class = variable.value;
+        const Id *type = &ids[ids[variable.type].type];
+
+        if (storage_class == kStorageClassInput) {
+            // Built-ins, and blocks of them like gl_PerVertex in later stages, are not vertex
+            // attributes.
+            if (!(reflection.stages & VK_SHADER_STAGE_VERTEX_BIT) || variable.builtin
+                || type->op == kOpTypeStruct) {
+                continue;
+            }
+            uint32_t components = 1;
+            if (type->op == kOpTypeVector) {
+                components = type->value;
+                type = valid(type->type) ? &ids[type->type] : nullptr;
+            }
+            ShaderInput input;
+            input.location = variable.location;
+            input.format = type != nullptr ? GetInputFormat(*type, components)
+                                           : VK_FORMAT_UNDEFINED;
+            input.size = components * 4;
+            if (!variable.has_location || input.format == VK_FORMAT_UNDEFINED) {
+                LOGW("vertex input %u is not a 32-bit scalar or vector with a location",
+                     variable_id);
+                return false;
+            }
+            reflection.inputs.push_back(input);
+            continue;
+        }
+        if (storage_class != kStorageClassUniformConstant
+            && storage_class != kStorageClassUniform
+            && storage_class != kStorageClassStorageBuffer) {
+            continue;
+        }
+
+        ShaderBinding binding;
+        binding.set = variable.set;
+        binding.binding = variable.binding;
+        binding.stages = reflection.stages;
+        if (type->op == kOpTypeRuntimeArray) {
+            LOGW("runtime descriptor array %u is not supported", variable_id);
+            return false;
+        }
+        if (type->op == kOpTypeArray) {
+            if (!valid(type->value) || ids[type->value].op != kOpConstant
+                || !valid(type->type)) {
+                LOGW("descriptor array %u has no constant length", variable_id);
+                return false;
+            }
+            binding.count = ids[type->value].value;
+            type = &ids[type->type];
+        }
+        if (storage_class == kStorageClassStorageBuffer
+            || (storage_class == kStorageClassUniform && type->buffer_block)) {
+            binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        } else if (storage_class == kStorageClassUniform) {
+            binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        } else if (type->op == kOpTypeSampler) {
+            binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        } else if (type->op == kOpTypeSampledImage && valid(type->type)) {
+            const Id &image = ids[type->type];
+            binding.type = image.value == kDimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                                                     : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        } else if (type->op == kOpTypeImage) {
+            binding.type = GetImageDescriptorType(*type);
+        } else {
+            LOGW("uniform constant %u is not a sampler or image", variable_id);
+            return false;
+        }
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+              [](const ShaderBinding &a, const ShaderBinding &b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+              [](const ShaderInput &a, const ShaderInput &b) {
+                  return a.location < b.location;
+              });
+    return true;
+}
+
+std::shared_ptr<const ShaderReflection> GetShaderReflection(const void *code, size_t size) {
+    static std::mutex mutex;
+    static std::unordered_map<uint64_t, std::shared_ptr<const ShaderReflection>> cache;
+
+    uint64_t key = HashBytes(code, size);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    auto reflection = std::make_shared<ShaderReflection>();
+    if (!ReflectShader(code, size, *reflection)) {
+        throw std::runtime_error("failed to reflect shader!");
+    }
+    cache.emplace(key, reflection);
+    return reflection;
+}
+
+bool MergeShaderReflections(const ShaderReflection &a,
+                            const ShaderReflection &b,
+                            ShaderReflection &merged) {
+    ShaderReflection result;
+    result.stages = a.stages | b.stages;
+    result.inputs = (a.stages & VK_SHADER_STAGE_VERTEX_BIT) ? a.inputs : b.inputs;
+    result.bindings = a.bindings;
+    for (const ShaderBinding &binding : b.bindings) {
+        auto it = std::find_if(result.bindings.begin(), result.bindings.end(),
+                               [&binding](const ShaderBinding &other) {
+                                   return other.set == binding.set
+                                          && other.binding == binding.binding;
+                               });
+        if (it == result.bindings.end()) {
+            result.bindings.push_back(binding);
+        } else if (it->type != binding.type || it->count != binding.count) {
+            LOGW("set %u binding %u is declared differently by the shader stages",
+                 binding.set, binding.binding);
+            return false;
+        } else {
+            it->stages |= binding.stages;
+        }
+    }
+    std::sort(result.bindings.begin(), result.bindings.end(),
+              [](const ShaderBinding &x, const ShaderBinding &y) {
+                  return x.set != y.set ? x.set < y.set : x.binding < y.binding;
+              });
+    merged = std::move(result);
+    return true;
+}
+
+void UseDynamicBuffers(ShaderReflection &reflection) {
+    for (ShaderBinding &binding : reflection.bindings) {
+        if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+            binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        } else if (binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+            binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        }
+    }
+}
+
+std::vector<VkDescriptorSetLayoutBinding> GetDescriptorSetLayoutBindings(
+        const ShaderReflection &reflection,
+        uint32_t set) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (const ShaderBinding &binding : reflection.bindings) {
+        if (binding.set != set) {
+            continue;
+        }
+        VkDescriptorSetLayoutBinding layout_binding{};
+        layout_binding.binding = binding.binding;
+        layout_binding.descriptorType = binding.type;
+        layout_binding.descriptorCount = binding.count;
+        layout_binding.stageFlags = binding.stages;
+        layout_binding.pImmutableSamplers = nullptr;
+        bindings.push_back(layout_binding);
+    }
+    return bindings;
+}
+
+std::vector<VkDescriptorPoolSize> GetDescriptorPoolSizes(const ShaderReflection &reflection,
+                                                         uint32_t set,
+                                                         uint32_t set_count) {
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    for (const ShaderBinding &binding : reflection.bindings) {
+        if (binding.set != set) {
+            continue;
+        }
+        auto it = std::find_if(pool_sizes.begin(), pool_sizes.end(),
+                               [&binding](const VkDescriptorPoolSize &pool_size) {
+                                   return pool_size.type == binding.type;
+                               });
+        if (it == pool_sizes.end()) {
+            VkDescriptorPoolSize pool_size{};
+            pool_size.type = binding.type;
+            pool_sizes.push_back(pool_size);
+            it = pool_sizes.end() - 1;
+        }
+        it->descriptorCount += binding.count * set_count;
+    }
+    return pool_sizes;
+}
+
+std::vector<VkVertexInputBindingDescription> GetVertexBindingDescriptions(
+        const ShaderReflection &reflection) {
+    if (reflection.inputs.empty()) {
+        return {};
+    }
+    VkVertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    for (const ShaderInput &input : reflection.inputs) {
+        binding_description.stride += input.size;
+    }
+    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return {binding_description};
+}
+
+std::vector<VkVertexInputAttributeDescription> GetVertexAttributeDescriptions(
+        const ShaderReflection &reflection) {
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    uint32_t offset = 0;
+    for (const ShaderInput &input : reflection.inputs) {
+        VkVertexInputAttributeDescription attribute_description{};
+        attribute_description.binding = 0;
+        attribute_description.location = input.location;
+        attribute_description.format = input.format;
+        attribute_description.offset = offset;
+        attribute_descriptions.push_back(attribute_description);
+        offset += input.size;
+    }
+    return attribute_descriptions;
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,78 @@
+#ifndef TINY_ENGINE_SPIRV_REFLECTION_H
+#define TINY_ENGINE_SPIRV_REFLECTION_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tiny_engine {
+
+// A descriptor a shader declares. Uniform and storage blocks come out as the plain buffer types,
+// see UseDynamicBuffers.
+struct ShaderBinding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uint32_t count = 1;
+    VkShaderStageFlags stages = 0;
+};
+
+// A vertex shader input, built-ins left out. format is the 32-bit float, signed or unsigned
+// integer format with the component count of the input type.
+struct ShaderInput {
+    uint32_t location = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t size = 0;
+};
+
+// What the pipeline layout and vertex input state of one or more shader stages need.
+struct ShaderReflection {
+    VkShaderStageFlags stages = 0;
+    // Sorted by set and binding.
+    std::vector<ShaderBinding> bindings;
+    // Sorted by location, empty for stages other than the vertex stage.
+    std::vector<ShaderInput> inputs;
+};
+
+// Parses the declarations of a SPIR-V module with a single entry point. Returns false, with the
+// reason logged, for malformed modules and for what the reflection does not cover: runtime
+// arrays of descriptors and vertex inputs which are not 32-bit scalars or vectors.
+bool ReflectShader(const void *code, size_t size, ShaderReflection &reflection);
+
+// ReflectShader through a cache keyed by the hash of code, so stages shared across materials
+// are parsed once. Throws if the module cannot be reflected.
+std::shared_ptr<const ShaderReflection> GetShaderReflection(const void *code, size_t size);
+
+// Combines stages into one reflection, a binding used by several stages gets all of their stage
+// flags. Returns false, with the reason logged, if the stages declare a binding differently.
+bool MergeShaderReflections(const ShaderReflection &a,
+                            const ShaderReflection &b,
+                            ShaderReflection &merged);
+
+// Turns uniform and storage buffers into their dynamic types, for buffers bound at a per-frame
+// offset like VulkanApplication's uniform buffer.
+void UseDynamicBuffers(ShaderReflection &reflection);
+
+// Bindings of set, in the order of reflection.bindings.
+std::vector<VkDescriptorSetLayoutBinding> GetDescriptorSetLayoutBindings(
+        const ShaderReflection &reflection,
+        uint32_t set);
+
+// Descriptors of set_count sets laid out like set, one pool size per descriptor type.
+std::vector<VkDescriptorPoolSize> GetDescriptorPoolSizes(const ShaderReflection &reflection,
+                                                         uint32_t set,
+                                                         uint32_t set_count);
+
+// Vertex input for one interleaved binding 0 with the inputs tightly packed in location order,
+// which is how a struct of glm vectors matching the shader inputs is laid out.
+std::vector<VkVertexInputBindingDescription> GetVertexBindingDescriptions(
+        const ShaderReflection &reflection);
+
+std::vector<VkVertexInputAttributeDescription> GetVertexAttributeDescriptions(
+        const ShaderReflection &reflection);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_SPIRV_REFLECTION_H
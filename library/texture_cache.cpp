@@ -0,0 +1,125 @@
+#include "texture_cache.h"
+
+#include <cstring>
+
+#include "etc2_encoder.h"
+#include "log.h"
+#include "mesh_cache.h"
+
+namespace tiny_engine {
+
+namespace {
+
+const char kMagic[4] = {'T', 'E', 'T', 'X'};
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Bytes per block and block width and height of the formats a texture can be baked to.
+bool GetBlockFormat(VkFormat format, size_t &block_size, uint32_t &block_dimension) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            block_size = 4;
+            block_dimension = 1;
+            return true;
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            block_size = GetEtc2BlockSize(false);
+            block_dimension = kEtc2BlockDimension;
+            return true;
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+            block_size = GetEtc2BlockSize(true);
+            block_dimension = kEtc2BlockDimension;
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+std::vector<MipLevel> GetTextureLevels(VkFormat format,
+                                       uint32_t width,
+                                       uint32_t height,
+                                       uint32_t mip_levels) {
+    size_t block_size;
+    uint32_t block_dimension;
+    if (!GetBlockFormat(format, block_size, block_dimension)) {
+        return {};
+    }
+    return GetMipChainLayout(width, height, mip_levels, block_size, block_dimension);
+}
+
+size_t GetTextureSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mip_levels) {
+    size_t block_size;
+    uint32_t block_dimension;
+    if (!GetBlockFormat(format, block_size, block_dimension)) {
+        return 0;
+    }
+    return GetMipChainSize(width, height, mip_levels, block_size, block_dimension);
+}
+
+bool TextureCache::Load(const std::string &filename, uint64_t source_hash) {
+    file_ = Filesystem::GetInstance().MapData(filename);
+    header_ = nullptr;
+    if (file_.size() < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+
+    const auto *header = file_.As<TextureCacheHeader>();
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion
+        || header->source_hash != source_hash) {
+        LOGI("Texture cache %s is stale", filename.c_str());
+        file_ = FileView();
+        return false;
+    }
+
+    size_t size = GetTextureSize(static_cast<VkFormat>(header->format),
+                                 header->width,
+                                 header->height,
+                                 header->mip_levels);
+    if (size == 0 || header->mip_levels == 0 || header->data_size != size
+        || header->data_offset + header->data_size > file_.size()
+        || HashBytes(file_.data() + sizeof(TextureCacheHeader),
+                     file_.size() - sizeof(TextureCacheHeader)) != header->content_hash) {
+        LOGW("Texture cache %s is corrupted", filename.c_str());
+        file_ = FileView();
+        return false;
+    }
+
+    header_ = header;
+    return true;
+}
+
+bool TextureCache::Save(const std::string &filename,
+                        uint64_t source_hash,
+                        VkFormat format,
+                        uint32_t width,
+                        uint32_t height,
+                        uint32_t mip_levels,
+                        const void *data,
+                        size_t size) {
+    TextureCacheHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.source_hash = source_hash;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.mip_levels = mip_levels;
+    header.data_offset = AlignUp(sizeof(TextureCacheHeader), 16);
+    header.data_size = size;
+
+    std::vector<uint8_t> file(header.data_offset + size, 0);
+    memcpy(file.data() + header.data_offset, data, size);
+    header.content_hash = HashBytes(file.data() + sizeof(TextureCacheHeader),
+                                    file.size() - sizeof(TextureCacheHeader));
+    memcpy(file.data(), &header, sizeof(header));
+
+    return Filesystem::GetInstance().WriteData(filename, file.data(), file.size());
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,85 @@
+#ifndef TINY_ENGINE_TEXTURE_CACHE_H
+#define TINY_ENGINE_TEXTURE_CACHE_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+#include "mip_chain.h"
+
+namespace tiny_engine {
+
+// Level layout of a tightly packed mip chain of an RGBA8 or ETC2 format, empty for other
+// formats.
+std::vector<MipLevel> GetTextureLevels(VkFormat format,
+                                       uint32_t width,
+                                       uint32_t height,
+                                       uint32_t mip_levels);
+
+// Size of the whole chain of GetTextureLevels, 0 for unsupported formats.
+size_t GetTextureSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mip_levels);
+
+// On-disk layout of a baked texture, the level data starts 16-byte aligned and is laid out as
+// GetTextureLevels(format, width, height, mip_levels).
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    // Hash of the source image file, a texture baked from another version of it is ignored.
+    uint64_t source_hash;
+    // Hash of everything after the header, catches truncated or corrupted files.
+    uint64_t content_hash;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+// Mip chain of a texture in its final GPU format (ETC2 blocks), memory mapped from the
+// Filesystem data directory so loading it costs neither image decoding nor encoding.
+class TextureCache {
+public:
+    // Bump whenever the encoder or the mip generation changes.
+    static constexpr uint32_t kVersion = 1;
+
+    // Returns false if the file is missing, was baked from a different source or fails
+    // validation; the caller then decodes the source and calls Save.
+    bool Load(const std::string &filename, uint64_t source_hash);
+
+    static bool Save(const std::string &filename,
+                     uint64_t source_hash,
+                     VkFormat format,
+                     uint32_t width,
+                     uint32_t height,
+                     uint32_t mip_levels,
+                     const void *data,
+                     size_t size);
+
+    VkFormat GetFormat() const { return static_cast<VkFormat>(header_->format); }
+
+    uint32_t GetWidth() const { return header_->width; }
+
+    uint32_t GetHeight() const { return header_->height; }
+
+    uint32_t GetMipLevels() const { return header_->mip_levels; }
+
+    const uint8_t *GetData() const { return file_.data() + header_->data_offset; }
+
+    size_t GetDataSize() const { return static_cast<size_t>(header_->data_size); }
+
+    std::vector<MipLevel> GetLevels() const {
+        return GetTextureLevels(GetFormat(), GetWidth(), GetHeight(), GetMipLevels());
+    }
+
+private:
+    FileView file_;
+    const TextureCacheHeader *header_ = nullptr;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_TEXTURE_CACHE_H
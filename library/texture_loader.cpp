@@ -0,0 +1,199 @@
+#include "texture_loader.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "etc2_encoder.h"
+#include "mesh_cache.h"
+
+namespace tiny_engine {
+
+namespace {
+
+void TakeBakedTexture(TextureData &texture) {
+    texture.format = texture.cache.GetFormat();
+    texture.data = texture.cache.GetData();
+    texture.size = texture.cache.GetDataSize();
+    texture.levels = texture.cache.GetLevels();
+    texture.generate_mipmaps = false;
+}
+
+bool IsRgba8Format(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+// Whether format is one of the ETC2 formats EncodeEtc2MipChain writes, and which.
+bool GetEtc2Format(VkFormat format, bool &alpha, bool &srgb) {
+    switch (format) {
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            alpha = false;
+            srgb = format == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK;
+            return true;
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            alpha = true;
+            srgb = format == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool LoadKtx2Texture(const FileView &file, TextureData &texture) {
+    if (!texture.ktx2.Load(file)) {
+        return false;
+    }
+    texture.format = texture.ktx2.GetFormat();
+    texture.data = texture.ktx2.GetData();
+    texture.size = texture.ktx2.GetDataSize();
+    texture.levels = texture.ktx2.GetLevels();
+    texture.generate_mipmaps = texture.ktx2.GetGenerateMipmaps();
+    return true;
+}
+
+bool LoadBakedTexture(const std::string &cache_file,
+                      uint64_t source_hash,
+                      VkFormat rgb_format,
+                      VkFormat rgba_format,
+                      TextureData &texture) {
+    if (!texture.cache.Load(cache_file, source_hash)
+        || (texture.cache.GetFormat() != rgb_format
+            && texture.cache.GetFormat() != rgba_format)) {
+        return false;
+    }
+    TakeBakedTexture(texture);
+    return true;
+}
+
+bool GetStagedImageFormat(const ImageInfo &info,
+                          VkFormat rgb_format,
+                          VkFormat rgba_format,
+                          VkFormat &format) {
+    // EncodeTexture picks rgb_format for images with an alpha channel whose pixels are opaque.
+    if (info.alpha && rgb_format != rgba_format) {
+        return false;
+    }
+    format = info.alpha ? rgba_format : rgb_format;
+    return IsRgba8Format(format);
+}
+
+void EncodeTexture(DecodedImage image,
+                   const std::string &cache_file,
+                   uint64_t source_hash,
+                   VkFormat rgb_format,
+                   VkFormat rgba_format,
+                   TextureData &texture) {
+    uint32_t width = image.width;
+    uint32_t height = image.height;
+    bool alpha = image.alpha
+                 && HasAlpha(image.pixels.data(), static_cast<size_t>(width) * height);
+    texture.format = alpha ? rgba_format : rgb_format;
+    texture.generate_mipmaps = false;
+    if (IsRgba8Format(texture.format)) {
+        texture.pixels = std::move(image.pixels);
+        texture.data = texture.pixels.data();
+        texture.size = static_cast<size_t>(width) * height * 4;
+        texture.levels = GetMipChainLayout(width, height, 1, 4);
+        return;
+    }
+    bool etc2_alpha;
+    bool srgb;
+    if (!GetEtc2Format(texture.format, etc2_alpha, srgb)) {
+        throw std::runtime_error("unsupported texture format!");
+    }
+
+    uint32_t mip_levels = GetMipLevelCount(width, height);
+    texture.chain = EncodeEtc2MipChain(image.pixels.data(),
+                                       width,
+                                       height,
+                                       mip_levels,
+                                       etc2_alpha,
+                                       srgb);
+    TextureCache::Save(cache_file,
+                       source_hash,
+                       texture.format,
+                       width,
+                       height,
+                       mip_levels,
+                       texture.chain.data(),
+                       texture.chain.size());
+    texture.data = texture.chain.data();
+    texture.size = texture.chain.size();
+    texture.levels = GetTextureLevels(texture.format, width, height, mip_levels);
+}
+
+TextureSource::TextureSource(std::string filename,
+                             std::string ktx2_filename,
+                             std::string cache_filename)
+        : filename_(std::move(filename)),
+          ktx2_filename_(std::move(ktx2_filename)),
+          cache_filename_(std::move(cache_filename)) {}
+
+void TextureSource::Prefetch() {
+    if (ktx2_filename_.empty() || !Filesystem::GetInstance().Exists(ktx2_filename_)) {
+        PrefetchImage();
+    }
+}
+
+void TextureSource::PrefetchImage() {
+    if (prefetched_) {
+        return;
+    }
+    prefetched_ = true;
+    file_ = Filesystem::GetInstance().Map(filename_);
+    source_hash_ = HashBytes(file_.data(), file_.size());
+    cached_ = cache_.Load(cache_filename_, source_hash_);
+}
+
+void TextureSource::Start(VkFormat rgb_format,
+                          VkFormat rgba_format,
+                          const std::function<bool(VkFormat)> &supported,
+                          const CreateStaging &create_staging) {
+    rgb_format_ = rgb_format;
+    rgba_format_ = rgba_format;
+    // A KTX2 container is uploaded as is, without decoding or encoding.
+    if (!prefetched_ && !ktx2_filename_.empty()
+        && Filesystem::GetInstance().Exists(ktx2_filename_)
+        && LoadKtx2Texture(Filesystem::GetInstance().Map(ktx2_filename_), texture_)
+        && supported(texture_.format)) {
+        return;
+    }
+    texture_ = TextureData();
+
+    PrefetchImage();
+    if (cached_ && (cache_.GetFormat() == rgb_format || cache_.GetFormat() == rgba_format)) {
+        texture_.cache = std::move(cache_);
+        TakeBakedTexture(texture_);
+        return;
+    }
+    ImageInfo info;
+    VkFormat format;
+    if (GetImageInfo(file_.data(), file_.size(), info)
+        && GetStagedImageFormat(info, rgb_format, rgba_format, format)) {
+        size_t level0_size = GetDecodeBufferSize(info);
+        create_staging(info.width, info.height, format, level0_size, texture_);
+        pixels_ = ImageDecodePool::GetInstance().Submit(
+                file_, static_cast<uint8_t *>(texture_.staging_memory.mapped), level0_size);
+    } else {
+        pixels_ = ImageDecodePool::GetInstance().Submit(file_);
+    }
+}
+
+void TextureSource::Load(TextureData &texture) {
+    texture = std::move(texture_);
+    texture_ = TextureData();
+    if (pixels_.valid()) {
+        DecodedImage image = pixels_.get();
+        if (texture.staging_buffer == VK_NULL_HANDLE) {
+            EncodeTexture(std::move(image), cache_filename_, source_hash_, rgb_format_,
+                          rgba_format_, texture);
+        }
+    }
+    cache_ = TextureCache();
+    file_ = FileView();
+}
+
+} // namespace tiny_engine
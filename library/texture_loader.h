@@ -0,0 +1,129 @@
+#ifndef TINY_ENGINE_TEXTURE_LOADER_H
+#define TINY_ENGINE_TEXTURE_LOADER_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "filesystem.h"
+#include "image_decode_pool.h"
+#include "image_decoder.h"
+#include "ktx2_texture.h"
+#include "memory_allocator.h"
+#include "mip_chain.h"
+#include "texture_cache.h"
+
+namespace tiny_engine {
+
+// CPU side of a texture, ready for VulkanApplication::UploadTexture.
+struct TextureData {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // RGBA8 level 0 whose mip chain is built on upload, empty if data holds the whole chain.
+    std::vector<uint8_t> pixels;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::vector<MipLevel> levels;
+    bool generate_mipmaps = false;
+    // Whichever of these (or pixels) data points into.
+    Ktx2Texture ktx2;
+    TextureCache cache;
+    std::vector<uint8_t> chain;
+    // Set instead of pixels for an RGBA8 level 0 written straight into mapped staging memory,
+    // which data then points into, see VulkanApplication::CreateTextureStaging.
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    MemoryAllocation staging_memory;
+
+    // Whether only an RGBA8 level 0 is given (in pixels or staging memory) and the upload builds
+    // the rest of the chain.
+    bool HasRgba8Level0() const { return !pixels.empty() || staging_buffer != VK_NULL_HANDLE; }
+};
+
+// Takes the levels of a KTX2 container as they are. Returns false if file is not one.
+bool LoadKtx2Texture(const FileView &file, TextureData &texture);
+
+// Takes the chain baked into the data file cache_file, if it was baked from the image with
+// source_hash in rgb_format or rgba_format.
+bool LoadBakedTexture(const std::string &cache_file,
+                      uint64_t source_hash,
+                      VkFormat rgb_format,
+                      VkFormat rgba_format,
+                      TextureData &texture);
+
+// Whether an image with info becomes RGBA8 pixels in rgb_format or rgba_format whatever its
+// pixels are, so it can be decoded straight into staging memory, and in which format. False if
+// it is encoded to ETC2 or its format depends on whether any pixel is transparent.
+bool GetStagedImageFormat(const ImageInfo &info,
+                          VkFormat rgb_format,
+                          VkFormat rgba_format,
+                          VkFormat &format);
+
+// Makes the texture of a decoded image, in rgba_format if it has alpha and rgb_format otherwise.
+// RGBA8 keeps the pixels. ETC2 formats are encoded into a full mip chain, which takes a while,
+// so the chain is also baked into cache_file for LoadBakedTexture. Throws std::runtime_error for
+// other formats.
+void EncodeTexture(DecodedImage image,
+                   const std::string &cache_file,
+                   uint64_t source_hash,
+                   VkFormat rgb_format,
+                   VkFormat rgba_format,
+                   TextureData &texture);
+
+// The texture of an image asset, loaded from the first of: a KTX2 container shipped next to the
+// image, the chain baked into a data file by an earlier run, and the image itself.
+class TextureSource {
+public:
+    TextureSource(std::string filename, std::string ktx2_filename, std::string cache_filename);
+
+    // Makes the staging memory of an RGBA8 level 0 of width x height in format in texture, with
+    // room for level0_size bytes, see VulkanApplication::CreateTextureStaging.
+    using CreateStaging = std::function<void(uint32_t width,
+                                             uint32_t height,
+                                             VkFormat format,
+                                             size_t level0_size,
+                                             TextureData &texture)>;
+
+    // Unless there is a KTX2 container, maps the image and loads its baked chain. Call it early,
+    // e.g. from the application constructor; Start does it otherwise.
+    void Prefetch();
+
+    // Picks the KTX2 container if supported accepts its format, else the baked chain in
+    // rgb_format or rgba_format, else the image, which starts decoding on the ImageDecodePool:
+    // straight into staging memory from create_staging if it stays RGBA8, into a buffer for the
+    // ETC2 encoder otherwise. Call it once the device exists, e.g. from OnDeviceCreated, so the
+    // decode overlaps with the rest of Init.
+    void Start(VkFormat rgb_format,
+               VkFormat rgba_format,
+               const std::function<bool(VkFormat)> &supported,
+               const CreateStaging &create_staging);
+
+    // Fills texture once Start has, waiting for the decode and encoding the image if needed.
+    // Releases the files, so call it once. Throws std::runtime_error if the image cannot be
+    // decoded; texture owns the staging memory then as well.
+    void Load(TextureData &texture);
+
+private:
+    // Maps the image and loads its baked chain.
+    void PrefetchImage();
+
+private:
+    std::string filename_;
+    std::string ktx2_filename_;
+    std::string cache_filename_;
+    bool prefetched_ = false;
+    FileView file_;
+    uint64_t source_hash_ = 0;
+    TextureCache cache_;
+    bool cached_ = false;
+    VkFormat rgb_format_ = VK_FORMAT_UNDEFINED;
+    VkFormat rgba_format_ = VK_FORMAT_UNDEFINED;
+    TextureData texture_;
+    std::future<DecodedImage> pixels_;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_TEXTURE_LOADER_H
@@ -0,0 +1,156 @@
+#include "texture_residency.h"
+
+#include <algorithm>
+
+namespace tiny_engine {
+
+uint32_t TextureResidency::Add(std::vector<size_t> level_sizes,
+                               TextureResidencyHandlers handlers) {
+    uint32_t id;
+    if (free_ids_.empty()) {
+        id = static_cast<uint32_t>(textures_.size());
+        textures_.emplace_back();
+    } else {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+    Texture &texture = textures_[id];
+    texture = Texture();
+    texture.used = true;
+    texture.level_sizes = std::move(level_sizes);
+    texture.tail_sizes.assign(texture.level_sizes.size() + 1, 0);
+    for (size_t i = texture.level_sizes.size(); i > 0; i--) {
+        texture.tail_sizes[i - 1] = texture.tail_sizes[i] + texture.level_sizes[i - 1];
+    }
+    texture.handlers = std::move(handlers);
+    texture.first_level = GetLevelCount(texture);
+    return id;
+}
+
+void TextureResidency::Remove(uint32_t id) {
+    Texture &texture = textures_[id];
+    resident_size_ -= GetSize(texture);
+    texture = Texture();
+    free_ids_.push_back(id);
+}
+
+void TextureResidency::SetResident(uint32_t id, uint32_t first_level) {
+    Texture &texture = textures_[id];
+    resident_size_ -= GetSize(texture);
+    texture.first_level = std::min(first_level, GetLevelCount(texture));
+    resident_size_ += GetSize(texture);
+    texture.restreaming = false;
+}
+
+void TextureResidency::Touch(uint32_t id, uint64_t frame) {
+    textures_[id].last_used = std::max(textures_[id].last_used, frame);
+}
+
+void TextureResidency::Evict(Texture &texture) {
+    resident_size_ -= GetSize(texture);
+    texture.first_level = GetLevelCount(texture);
+    texture.handlers.evict();
+}
+
+void TextureResidency::Update(uint64_t frame) {
+    if (budget_ == 0) {
+        // Unlimited, only bring back what an earlier budget took away.
+        for (Texture &texture : textures_) {
+            if (texture.used && texture.first_level != 0 && !texture.restreaming
+                && texture.last_used + 1 >= frame) {
+                texture.restreaming = true;
+                texture.restream_level = 0;
+                texture.handlers.restream(0);
+            }
+        }
+        return;
+    }
+
+    // Idle textures go first, least recently used first.
+    if (resident_size_ > budget_) {
+        std::vector<Texture *> idle;
+        for (Texture &texture : textures_) {
+            if (texture.used && GetSize(texture) != 0 && texture.last_used + kIdleFrames < frame) {
+                idle.push_back(&texture);
+            }
+        }
+        std::sort(idle.begin(), idle.end(), [](const Texture *a, const Texture *b) {
+            return a->last_used < b->last_used;
+        });
+        for (size_t i = 0; i < idle.size() && resident_size_ > budget_; i++) {
+            Evict(*idle[i]);
+        }
+    }
+
+    // Then the top level of the largest texture, until it fits. Every texture keeps its last
+    // level, so a budget below even that is exceeded rather than drawing placeholders.
+    if (resident_size_ > budget_) {
+        std::vector<uint32_t> first_levels(textures_.size());
+        for (size_t i = 0; i < textures_.size(); i++) {
+            first_levels[i] = textures_[i].first_level;
+        }
+        size_t size = resident_size_;
+        while (size > budget_) {
+            size_t largest = textures_.size();
+            size_t largest_size = 0;
+            for (size_t i = 0; i < textures_.size(); i++) {
+                const Texture &texture = textures_[i];
+                if (!texture.used || first_levels[i] + 1 >= GetLevelCount(texture)) {
+                    continue;
+                }
+                size_t level_size = texture.level_sizes[first_levels[i]];
+                if (level_size > largest_size) {
+                    largest = i;
+                    largest_size = level_size;
+                }
+            }
+            if (largest == textures_.size()) {
+                break;
+            }
+            size -= largest_size;
+            first_levels[largest]++;
+        }
+        for (size_t i = 0; i < textures_.size(); i++) {
+            if (first_levels[i] != textures_[i].first_level) {
+                textures_[i].trimmed_frame = frame;
+                textures_[i].handlers.trim(first_levels[i]);
+            }
+        }
+        return;
+    }
+
+    // Used textures below their full size grow back as far as the budget allows, but not right
+    // after a trim so that textures do not swap levels back and forth. Evicted ones come back at
+    // least at their last level. Restreams still on their way count as resident already.
+    size_t size = resident_size_;
+    for (const Texture &texture : textures_) {
+        if (texture.used && texture.restreaming) {
+            size += texture.tail_sizes[texture.restream_level] - GetSize(texture);
+        }
+    }
+    for (Texture &texture : textures_) {
+        if (!texture.used || texture.first_level == 0 || texture.restreaming
+            || texture.last_used + 1 < frame
+            || (texture.first_level < GetLevelCount(texture)
+                && texture.trimmed_frame + kIdleFrames > frame)) {
+            continue;
+        }
+        size_t others = size - GetSize(texture);
+        size_t available = others < budget_ ? budget_ - others : 0;
+        uint32_t level = texture.first_level;
+        while (level > 0 && texture.tail_sizes[level - 1] <= available) {
+            level--;
+        }
+        if (level == GetLevelCount(texture)) {
+            level--;
+        }
+        if (level < texture.first_level) {
+            size += texture.tail_sizes[level] - GetSize(texture);
+            texture.restreaming = true;
+            texture.restream_level = level;
+            texture.handlers.restream(level);
+        }
+    }
+}
+
+} // namespace tiny_engine
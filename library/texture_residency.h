@@ -0,0 +1,93 @@
+#ifndef TINY_ENGINE_TEXTURE_RESIDENCY_H
+#define TINY_ENGINE_TEXTURE_RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace tiny_engine {
+
+// Carries out the decisions of TextureResidency::Update for one texture, on the render thread.
+struct TextureResidencyHandlers {
+    // Replace the image by one holding only levels first_level and below of the current one,
+    // then call SetResident.
+    std::function<void(uint32_t first_level)> trim;
+    // Destroy the image, the texture is drawn with a placeholder until it is streamed again.
+    std::function<void()> evict;
+    // Stream the texture again with levels first_level and below, then call SetResident.
+    std::function<void(uint32_t first_level)> restream;
+};
+
+// Keeps the textures in device memory within a budget. Textures not used for a while are
+// evicted least recently used first; if the used ones alone exceed the budget their top mips
+// are dropped, largest first. Used textures which are evicted or trimmed are streamed back,
+// at the finest level that fits. Sizes are the tightly packed level sizes, a little below the
+// actual allocations.
+class TextureResidency {
+public:
+    // Textures used within this many frames are not evicted, only trimmed. Trimmed textures
+    // wait as long before they grow again.
+    static constexpr uint64_t kIdleFrames = 60;
+
+    // 0 means unlimited.
+    void SetBudget(size_t budget) { budget_ = budget; }
+
+    size_t GetBudget() const { return budget_; }
+
+    // Adds a texture with level_sizes[i] bytes for mip level i, not resident until SetResident.
+    // Returns its id.
+    uint32_t Add(std::vector<size_t> level_sizes, TextureResidencyHandlers handlers);
+
+    void Remove(uint32_t id);
+
+    // The image of id now holds levels first_level and below.
+    void SetResident(uint32_t id, uint32_t first_level);
+
+    // Records that id is drawn in frame, whether resident or not.
+    void Touch(uint32_t id, uint64_t frame);
+
+    // Render thread, once per frame before it is recorded: evicts and trims until the resident
+    // size fits the budget, and restreams used textures which can grow again.
+    void Update(uint64_t frame);
+
+    size_t GetResidentSize() const { return resident_size_; }
+
+    // First resident level of id, the level count if it is not resident.
+    uint32_t GetFirstLevel(uint32_t id) const { return textures_[id].first_level; }
+
+private:
+    struct Texture {
+        bool used = false;
+        std::vector<size_t> level_sizes;
+        // Bytes of levels i and below, with a 0 past the last level.
+        std::vector<size_t> tail_sizes;
+        TextureResidencyHandlers handlers;
+        uint32_t first_level = 0;
+        uint64_t last_used = 0;
+        uint64_t trimmed_frame = 0;
+        bool restreaming = false;
+        // First level asked for while restreaming.
+        uint32_t restream_level = 0;
+    };
+
+    uint32_t GetLevelCount(const Texture &texture) const {
+        return static_cast<uint32_t>(texture.level_sizes.size());
+    }
+
+    size_t GetSize(const Texture &texture) const {
+        return texture.tail_sizes[texture.first_level];
+    }
+
+    void Evict(Texture &texture);
+
+private:
+    std::vector<Texture> textures_;
+    std::vector<uint32_t> free_ids_;
+    size_t budget_ = 0;
+    size_t resident_size_ = 0;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_TEXTURE_RESIDENCY_H
@@ -0,0 +1,123 @@
+#include "upload_batch.h"
+
+#include <stdexcept>
+
+namespace tiny_engine {
+
+void UploadBatch::Init(VkDevice device, VkQueue queue, VkCommandPool command_pool) {
+    device_ = device;
+    queue_ = queue;
+    command_pool_ = command_pool;
+}
+
+void UploadBatch::Destroy() {
+    if (IsRecording()) {
+        Submit();
+    }
+    Wait();
+}
+
+void UploadBatch::Begin() {
+    if (IsRecording()) return;
+
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool = command_pool_;
+    alloc_info.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device_, &alloc_info, &command_buffer_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(command_buffer_, &begin_info);
+}
+
+void UploadBatch::Defer(std::function<void()> release) {
+    if (IsRecording()) {
+        releases_.push_back(std::move(release));
+    } else {
+        release();
+    }
+}
+
+void UploadBatch::Submit() {
+    if (!IsRecording()) return;
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+                            | VK_ACCESS_INDEX_READ_BIT
+                            | VK_ACCESS_UNIFORM_READ_BIT
+                            | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer_,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                         | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                         | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         1,
+                         &barrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+    vkEndCommandBuffer(command_buffer_);
+
+    Submission submission;
+    submission.command_buffer = command_buffer_;
+    submission.releases.swap(releases_);
+    command_buffer_ = VK_NULL_HANDLE;
+
+    VkFenceCreateInfo fence_create_info{};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device_, &fence_create_info, nullptr, &submission.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload fence!");
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &submission.command_buffer;
+
+    if (vkQueueSubmit(queue_, 1, &submit_info, submission.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+    submissions_.push_back(std::move(submission));
+}
+
+bool UploadBatch::Poll() {
+    auto it = submissions_.begin();
+    while (it != submissions_.end()) {
+        if (vkGetFenceStatus(device_, it->fence) == VK_SUCCESS) {
+            Retire(*it);
+            it = submissions_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return submissions_.empty();
+}
+
+void UploadBatch::Wait() {
+    for (auto &submission : submissions_) {
+        vkWaitForFences(device_, 1, &submission.fence, VK_TRUE, UINT64_MAX);
+        Retire(submission);
+    }
+    submissions_.clear();
+}
+
+void UploadBatch::Retire(Submission &submission) {
+    for (auto &release : submission.releases) {
+        release();
+    }
+    vkDestroyFence(device_, submission.fence, nullptr);
+    vkFreeCommandBuffers(device_, command_pool_, 1, &submission.command_buffer);
+}
+
+} // namespace tiny_engine
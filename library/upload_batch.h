@@ -0,0 +1,57 @@
+#ifndef TINY_ENGINE_UPLOAD_BATCH_H
+#define TINY_ENGINE_UPLOAD_BATCH_H
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <vector>
+
+namespace tiny_engine {
+
+// Records staging copies and layout transitions into one command buffer which is submitted
+// with a fence, so loading a scene costs a single GPU round trip instead of one per copy.
+// Resources that must outlive the copies (staging buffers) are released once the fence signals.
+class UploadBatch {
+public:
+    void Init(VkDevice device, VkQueue queue, VkCommandPool command_pool);
+
+    void Destroy();
+
+    void Begin();
+
+    bool IsRecording() const { return command_buffer_ != VK_NULL_HANDLE; }
+
+    VkCommandBuffer GetCommandBuffer() const { return command_buffer_; }
+
+    void Defer(std::function<void()> release);
+
+    // Ends recording and submits, returns immediately. Transfer writes are made visible to
+    // vertex input and shader reads of any later submission on the same queue.
+    void Submit();
+
+    // Returns true once everything submitted so far has finished, releasing what it can.
+    bool Poll();
+
+    void Wait();
+
+private:
+    struct Submission {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        std::vector<std::function<void()>> releases;
+    };
+
+    void Retire(Submission &submission);
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueue queue_ = VK_NULL_HANDLE;
+    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+
+    VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+    std::vector<std::function<void()>> releases_;
+    std::vector<Submission> submissions_;
+};
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_UPLOAD_BATCH_H
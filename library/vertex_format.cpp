@@ -0,0 +1,216 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace tiny_engine {
+
+namespace {
+
+VkFormat GetFormat(PositionFormat format) {
+    switch (format) {
+        case PositionFormat::kFloat16:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case PositionFormat::kSnorm16:
+            return VK_FORMAT_R16G16B16A16_SNORM;
+        default:
+            return VK_FORMAT_R32G32B32_SFLOAT;
+    }
+}
+
+VkFormat GetFormat(ColorFormat format) {
+    return format == ColorFormat::kUnorm8 ? VK_FORMAT_R8G8B8A8_UNORM
+                                          : VK_FORMAT_R32G32B32_SFLOAT;
+}
+
+VkFormat GetFormat(TexCoordFormat format) {
+    switch (format) {
+        case TexCoordFormat::kFloat16:
+            return VK_FORMAT_R16G16_SFLOAT;
+        case TexCoordFormat::kUnorm16:
+            return VK_FORMAT_R16G16_UNORM;
+        default:
+            return VK_FORMAT_R32G32_SFLOAT;
+    }
+}
+
+uint32_t GetSize(PositionFormat format) {
+    return format == PositionFormat::kFloat32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+uint32_t GetSize(ColorFormat format) {
+    return format == ColorFormat::kUnorm8 ? 4 * sizeof(uint8_t) : 3 * sizeof(float);
+}
+
+uint32_t GetSize(TexCoordFormat format) {
+    return format == TexCoordFormat::kFloat32 ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+}
+
+uint16_t ToSnorm16(float value) {
+    float clamped = std::min(std::max(value, -1.0f), 1.0f);
+    return static_cast<uint16_t>(static_cast<int16_t>(std::lround(clamped * 32767.0f)));
+}
+
+uint16_t ToUnorm16(float value) {
+    float clamped = std::min(std::max(value, 0.0f), 1.0f);
+    return static_cast<uint16_t>(std::lround(clamped * 65535.0f));
+}
+
+uint8_t ToUnorm8(float value) {
+    float clamped = std::min(std::max(value, 0.0f), 1.0f);
+    return static_cast<uint8_t>(std::lround(clamped * 255.0f));
+}
+
+} // namespace
+
+VertexLayout MakeVertexLayout(PositionFormat position_format,
+                              ColorFormat color_format,
+                              TexCoordFormat tex_coord_format) {
+    VertexLayout layout;
+    layout.position_format = position_format;
+    layout.color_format = color_format;
+    layout.tex_coord_format = tex_coord_format;
+    layout.position_offset = 0;
+    layout.color_offset = layout.position_offset + GetSize(position_format);
+    layout.tex_coord_offset = layout.color_offset + GetSize(color_format);
+    layout.stride = layout.tex_coord_offset + GetSize(tex_coord_format);
+    return layout;
+}
+
+std::vector<VkVertexInputBindingDescription> GetVertexBindingDescriptions(
+        const VertexLayout &layout) {
+    VkVertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    binding_description.stride = layout.stride;
+    binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return {binding_description};
+}
+
+std::vector<VkVertexInputAttributeDescription> GetVertexAttributeDescriptions(
+        const VertexLayout &layout) {
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions(3);
+    attribute_descriptions[0].binding = 0;
+    attribute_descriptions[0].location = 0;
+    attribute_descriptions[0].format = GetFormat(layout.position_format);
+    attribute_descriptions[0].offset = layout.position_offset;
+    attribute_descriptions[1].binding = 0;
+    attribute_descriptions[1].location = 1;
+    attribute_descriptions[1].format = GetFormat(layout.color_format);
+    attribute_descriptions[1].offset = layout.color_offset;
+    attribute_descriptions[2].binding = 0;
+    attribute_descriptions[2].location = 2;
+    attribute_descriptions[2].format = GetFormat(layout.tex_coord_format);
+    attribute_descriptions[2].offset = layout.tex_coord_offset;
+    return attribute_descriptions;
+}
+
+PositionTransform ComputePositionTransform(const VertexLayout &layout,
+                                           const float bounds_min[3],
+                                           const float bounds_max[3]) {
+    PositionTransform transform;
+    if (layout.position_format == PositionFormat::kFloat32) {
+        return transform;
+    }
+    for (int i = 0; i < 3; i++) {
+        float half_extent = 0.5f * (bounds_max[i] - bounds_min[i]);
+        transform.offset[i] = 0.5f * (bounds_min[i] + bounds_max[i]);
+        transform.scale[i] = half_extent > 0.0f ? half_extent : 1.0f;
+    }
+    return transform;
+}
+
+void QuantizeVertices(uint8_t *destination,
+                      const VertexLayout &layout,
+                      const PositionTransform &transform,
+                      const void *vertices,
+                      size_t vertex_count,
+                      size_t vertex_stride,
+                      size_t position_offset,
+                      size_t color_offset,
+                      size_t tex_coord_offset) {
+    const uint8_t *source = static_cast<const uint8_t *>(vertices);
+    for (size_t i = 0; i < vertex_count; i++) {
+        const uint8_t *vertex = source + i * vertex_stride;
+        uint8_t *output = destination + i * layout.stride;
+
+        float position[3];
+        memcpy(position, vertex + position_offset, sizeof(position));
+        if (layout.position_format == PositionFormat::kFloat32) {
+            memcpy(output + layout.position_offset, position, sizeof(position));
+        } else {
+            uint16_t packed[4] = {0, 0, 0, 0};
+            for (int k = 0; k < 3; k++) {
+                float relative = (position[k] - transform.offset[k]) / transform.scale[k];
+                packed[k] = layout.position_format == PositionFormat::kSnorm16
+                            ? ToSnorm16(relative) : FloatToHalf(relative);
+            }
+            memcpy(output + layout.position_offset, packed, sizeof(packed));
+        }
+
+        float color[3];
+        memcpy(color, vertex + color_offset, sizeof(color));
+        if (layout.color_format == ColorFormat::kFloat32) {
+            memcpy(output + layout.color_offset, color, sizeof(color));
+        } else {
+            uint8_t packed[4] = {ToUnorm8(color[0]), ToUnorm8(color[1]), ToUnorm8(color[2]), 255};
+            memcpy(output + layout.color_offset, packed, sizeof(packed));
+        }
+
+        float tex_coord[2];
+        memcpy(tex_coord, vertex + tex_coord_offset, sizeof(tex_coord));
+        if (layout.tex_coord_format == TexCoordFormat::kFloat32) {
+            memcpy(output + layout.tex_coord_offset, tex_coord, sizeof(tex_coord));
+        } else {
+            uint16_t packed[2];
+            for (int k = 0; k < 2; k++) {
+                packed[k] = layout.tex_coord_format == TexCoordFormat::kUnorm16
+                            ? ToUnorm16(tex_coord[k]) : FloatToHalf(tex_coord[k]);
+            }
+            memcpy(output + layout.tex_coord_offset, packed, sizeof(packed));
+        }
+    }
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff) {
+        // Inf stays Inf, NaN stays a quiet NaN.
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+
+    int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (half_exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (half_exponent <= 0) {
+        // Subnormal half or zero.
+        if (half_exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) {
+            half_mantissa++;
+        }
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    // A carry out of the mantissa correctly bumps the exponent (up to Inf).
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+} // namespace tiny_engine
@@ -0,0 +1,85 @@
+#ifndef TINY_ENGINE_VERTEX_FORMAT_H
+#define TINY_ENGINE_VERTEX_FORMAT_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Storage formats for the position, color and texture coordinate attributes. Only formats whose
+// VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT support is mandatory are used, so 16-bit positions take
+// four components (the shader still reads a vec3).
+enum class PositionFormat {
+    kFloat32,
+    // Half floats of the position relative to the mesh bounds, see PositionTransform.
+    kFloat16,
+    // Signed normalized 16-bit integers of the position relative to the mesh bounds.
+    kSnorm16
+};
+
+enum class ColorFormat {
+    kFloat32,
+    kUnorm8
+};
+
+enum class TexCoordFormat {
+    kFloat32,
+    kFloat16,
+    // Clamps texture coordinates to [0, 1], only for meshes which do not rely on wrapping.
+    kUnorm16
+};
+
+// Interleaved vertex with position at location 0, color at 1 and texture coordinate at 2.
+struct VertexLayout {
+    PositionFormat position_format = PositionFormat::kFloat32;
+    ColorFormat color_format = ColorFormat::kFloat32;
+    TexCoordFormat tex_coord_format = TexCoordFormat::kFloat32;
+    uint32_t position_offset = 0;
+    uint32_t color_offset = 0;
+    uint32_t tex_coord_offset = 0;
+    uint32_t stride = 0;
+};
+
+VertexLayout MakeVertexLayout(PositionFormat position_format,
+                              ColorFormat color_format,
+                              TexCoordFormat tex_coord_format);
+
+std::vector<VkVertexInputBindingDescription> GetVertexBindingDescriptions(
+        const VertexLayout &layout);
+
+std::vector<VkVertexInputAttributeDescription> GetVertexAttributeDescriptions(
+        const VertexLayout &layout);
+
+// Maps a stored position back to model space, model = stored * scale + offset. Quantized
+// positions are stored relative to the center and half extent of the mesh bounds so they use
+// the whole range of the format; the transform is folded into the model matrix.
+struct PositionTransform {
+    float offset[3] = {0.0f, 0.0f, 0.0f};
+    float scale[3] = {1.0f, 1.0f, 1.0f};
+};
+
+PositionTransform ComputePositionTransform(const VertexLayout &layout,
+                                           const float bounds_min[3],
+                                           const float bounds_max[3]);
+
+// Converts vertex_count float vertices (float3 position, float3 color and float2 texture
+// coordinate at the given offsets) into layout. destination holds vertex_count * layout.stride
+// bytes.
+void QuantizeVertices(uint8_t *destination,
+                      const VertexLayout &layout,
+                      const PositionTransform &transform,
+                      const void *vertices,
+                      size_t vertex_count,
+                      size_t vertex_stride,
+                      size_t position_offset,
+                      size_t color_offset,
+                      size_t tex_coord_offset);
+
+// IEEE 754 binary16 with round to nearest even.
+uint16_t FloatToHalf(float value);
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_VERTEX_FORMAT_H
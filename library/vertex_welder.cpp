@@ -0,0 +1,79 @@
+#include "vertex_welder.h"
+
+#include <cstring>
+
+namespace tiny_engine {
+
+namespace {
+
+const uint32_t kEmpty = ~0u;
+
+// MurmurHash2 over the vertex bytes, vertices are small so the per word mixing dominates and
+// every bit of every attribute affects the result (unlike XOR-combining per component hashes).
+uint32_t HashVertex(const uint8_t *vertex, size_t size) {
+    const uint32_t m = 0x5bd1e995;
+    const int r = 24;
+    uint32_t h = static_cast<uint32_t>(size);
+
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint32_t k;
+        memcpy(&k, vertex + i, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h *= m;
+        h ^= k;
+    }
+    for (; i < size; i++) {
+        h ^= vertex[i];
+        h *= m;
+    }
+
+    h ^= h >> 13;
+    h *= m;
+    h ^= h >> 15;
+    return h;
+}
+
+} // namespace
+
+size_t GenerateVertexRemap(const void *vertices,
+                           size_t vertex_count,
+                           size_t vertex_size,
+                           uint32_t *remap) {
+    const uint8_t *data = static_cast<const uint8_t *>(vertices);
+
+    // Open addressing with the table at most half full, the table only stores the index of the
+    // first vertex of each kind so a probe touches 4 bytes until the hash matches.
+    size_t table_size = 1;
+    while (table_size < vertex_count * 2) {
+        table_size *= 2;
+    }
+    size_t mask = table_size - 1;
+    std::vector<uint32_t> table(table_size, kEmpty);
+
+    uint32_t unique_count = 0;
+    for (size_t i = 0; i < vertex_count; i++) {
+        const uint8_t *vertex = data + i * vertex_size;
+        size_t bucket = HashVertex(vertex, vertex_size) & mask;
+
+        // Triangular probing visits every bucket of a power of two table.
+        for (size_t probe = 1;; probe++) {
+            uint32_t first = table[bucket];
+            if (first == kEmpty) {
+                table[bucket] = static_cast<uint32_t>(i);
+                remap[i] = unique_count++;
+                break;
+            }
+            if (memcmp(data + first * vertex_size, vertex, vertex_size) == 0) {
+                remap[i] = remap[first];
+                break;
+            }
+            bucket = (bucket + probe) & mask;
+        }
+    }
+    return unique_count;
+}
+
+} // namespace tiny_engine
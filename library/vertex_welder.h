@@ -0,0 +1,43 @@
+#ifndef TINY_ENGINE_VERTEX_WELDER_H
+#define TINY_ENGINE_VERTEX_WELDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tiny_engine {
+
+// Finds identical vertices in vertex_count vertices of vertex_size bytes each. remap[i] receives
+// the welded index of vertex i, welded vertices are numbered in order of first occurrence.
+// Returns the number of unique vertices. Vertices are compared bit for bit, so the vertex type
+// must not contain padding (and -0.0f differs from 0.0f).
+size_t GenerateVertexRemap(const void *vertices,
+                           size_t vertex_count,
+                           size_t vertex_size,
+                           uint32_t *remap);
+
+// Welds an unindexed vertex stream (e.g. one vertex per OBJ face corner) in place: vertices keeps
+// only the unique vertices and the returned list indexes them.
+template<typename Vertex>
+std::vector<uint32_t> WeldVertices(std::vector<Vertex> &vertices) {
+    std::vector<uint32_t> indices(vertices.size());
+    size_t unique_count = GenerateVertexRemap(vertices.data(),
+                                              vertices.size(),
+                                              sizeof(Vertex),
+                                              indices.data());
+
+    // Unique vertices are numbered by first occurrence, so compacting front to back never
+    // overwrites a vertex which is still to be moved.
+    uint32_t next = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] == next) {
+            vertices[next++] = vertices[i];
+        }
+    }
+    vertices.resize(unique_count);
+    return indices;
+}
+
+} // namespace tiny_engine
+
+#endif //TINY_ENGINE_VERTEX_WELDER_H
@@ -1,12 +1,19 @@
 #include "vulkan_application.h"
 
+#ifdef ANDROID
 #include <vulkan/vulkan_android.h>
 #include <android/native_window.h>
+#endif
 #include <set>
 #include <string>
 #include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
 
+#include "filesystem.h"
 #include "log.h"
+#include "texture_loader.h"
 
 namespace tiny_engine {
 
@@ -15,13 +22,19 @@ void VulkanApplication::Init() {
     CreateDebugMessenger();
     CreateSurface();
     CreateDevice();
+    texture_residency_.SetBudget(GetTextureMemoryBudget());
+    OnDeviceCreated();
     CreateSwapchain();
     CreateSwapchainImageViews();
     CreateRenderPass();
+    ReflectShaders();
     CreateDescriptorSetLayout();
     CreateShaderModules();
+    CreatePipelineCache();
     CreateGraphicsPipeline();
     CreateCommandPool();
+    upload_batch_.Init(device_, graphics_queue_, command_pool_);
+    upload_batch_.Begin();
     CreateDepthResources();
     CreateFramebuffers();
     CreateVertexBuffer();
@@ -32,33 +45,362 @@ void VulkanApplication::Init() {
     CreateTextureSampler();
     CreateDescriptorPool();
     CreateDescriptorSets();
+    upload_batch_.Submit();
     CreateCommandBuffers();
     CreateSyncObjects();
+    upload_batch_.Wait();
 }
 
-void VulkanApplication::Draw() {}
+void VulkanApplication::Draw() {
+    // Only the fence of the frame slot we are about to reuse is waited on, the other
+    // max_frames_in_flight_ - 1 frames keep the GPU busy while the CPU records this one.
+    vkWaitForFences(device_, 1, &in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
+
+    uint32_t image_index;
+    VkResult result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX,
+                                            image_available_semaphores_[current_frame_],
+                                            VK_NULL_HANDLE,
+                                            &image_index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        LOGI("RecreateSwapChain cause of VK_ERROR_OUT_OF_DATE_KHR");
+        RecreateSwapchain();
+        return;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swap chain image!");
+    }
+
+    if (images_in_flight_[image_index] != VK_NULL_HANDLE) {
+        vkWaitForFences(device_, 1, &images_in_flight_[image_index], VK_TRUE, UINT64_MAX);
+    }
+    images_in_flight_[image_index] = in_flight_fences_[current_frame_];
+
+    ReleaseRetiredResources(false);
+    UploadStreamedAssets();
+    UpdateTextureResidency();
+    UpdateFrame(current_frame_);
+
+    VkCommandBuffer command_buffer = command_buffers_[current_frame_];
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    VkRenderPassBeginInfo render_pass_begin_info{};
+    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_begin_info.renderPass = render_pass_;
+    render_pass_begin_info.framebuffer = framebuffers_[image_index];
+    render_pass_begin_info.renderArea.offset = {0, 0};
+    render_pass_begin_info.renderArea.extent = swapchain_extent_;
+
+    std::array<VkClearValue, 2> clear_values{};
+    clear_values[0].color = clear_color_;
+    clear_values[1].depthStencil = {1.0f, 0};
+
+    render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+    render_pass_begin_info.pClearValues = clear_values.data();
+
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) swapchain_extent_.width;
+    viewport.height = (float) swapchain_extent_.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapchain_extent_;
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    RecordCommandBuffer(command_buffer, image_index);
+    vkCmdEndRenderPass(command_buffer);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkSemaphore wait_semaphores[] = {image_available_semaphores_[current_frame_]};
+    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+
+    VkSemaphore signal_semaphores[] = {render_finished_semaphores_[current_frame_]};
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = signal_semaphores;
+
+    vkResetFences(device_, 1, &in_flight_fences_[current_frame_]);
+
+    if (vkQueueSubmit(graphics_queue_, 1, &submit_info, in_flight_fences_[current_frame_]) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+
+    VkPresentInfoKHR present_info{};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = signal_semaphores;
+
+    VkSwapchainKHR swapchains[] = {swapchain_};
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = swapchains;
+
+    present_info.pImageIndices = &image_index;
+
+    current_frame_ = (current_frame_ + 1) % max_frames_in_flight_;
+    frame_count_++;
+
+    result = vkQueuePresentKHR(present_queue_, &present_info);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        LOGI("RecreateSwapChain cause of result:%d", result);
+        RecreateSwapchain();
+    } else if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to present swap chain image!");
+    }
+}
+
+void VulkanApplication::RecreateSwapchain() {
+    // A minimized or not yet laid out window has no area, keep the old swapchain until it has.
+    VkExtent2D window_extent = GetWindowExtent();
+    if (window_extent.width == 0 || window_extent.height == 0) {
+        return;
+    }
+
+    vkDeviceWaitIdle(device_);
+
+    vkFreeCommandBuffers(device_, command_pool_, command_buffers_.size(), command_buffers_.data());
+    command_buffers_.clear();
+    DestroyFramebuffers();
+    vkDestroyImageView(device_, depth_image_view_, nullptr);
+    DestroyImage(device_, depth_image_, depth_image_memory_);
+    DestroySwapchainImageViews();
+
+    // The surface format does not change for the same surface, so the render pass and the
+    // pipeline (viewport and scissor are dynamic) stay valid.
+    VkSwapchainKHR old_swapchain = swapchain_;
+    CreateSwapchain();
+    vkDestroySwapchainKHR(device_, old_swapchain, nullptr);
+
+    CreateSwapchainImageViews();
+    CreateDepthResources();
+    CreateFramebuffers();
+    CreateCommandBuffers();
+
+    images_in_flight_.assign(swapchain_images_.size(), VK_NULL_HANDLE);
+
+    OnSwapchainRecreated();
+}
+
+void VulkanApplication::OnDeviceCreated() {}
+
+void VulkanApplication::OnSwapchainRecreated() {}
+
+void VulkanApplication::UploadStreamedAssets() {
+    // Staging buffers of earlier uploads are released once their copies have finished.
+    upload_batch_.Poll();
+    if (!asset_streamer_.HasUploads()) {
+        return;
+    }
+    // Submitted on the graphics queue before this frame, whose reads the batch's barrier covers.
+    upload_batch_.Begin();
+    asset_streamer_.Update(stream_upload_budget_);
+    upload_batch_.Submit();
+}
+
+void VulkanApplication::UpdateTextureResidency() {
+    texture_residency_.Update(frame_count_);
+    // Trims are recorded into the upload batch.
+    upload_batch_.Submit();
+}
+
+size_t VulkanApplication::GetTextureMemoryBudget() {
+    if (texture_memory_budget_ != 0) {
+        return texture_memory_budget_;
+    }
+    // Mobile GPUs share one heap with the rest of the system, take a quarter of it.
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device_, &memory_properties);
+    VkDeviceSize heap_size = 0;
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        const VkMemoryHeap &heap = memory_properties.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0
+            && (heap_size == 0 || heap.size < heap_size)) {
+            heap_size = heap.size;
+        }
+    }
+    return static_cast<size_t>(heap_size / 4);
+}
+
+void VulkanApplication::RetireResource(std::function<void()> release) {
+    retired_resources_.emplace_back(frame_count_, std::move(release));
+}
+
+void VulkanApplication::ReleaseRetiredResources(bool all) {
+    // Called after waiting for the fence of the current frame slot, the last frame which can
+    // still use a resource retired in frame n is n, which that fence covers from frame
+    // n + max_frames_in_flight_ on.
+    while (!retired_resources_.empty()
+           && (all || retired_resources_.front().first + max_frames_in_flight_ <= frame_count_)) {
+        retired_resources_.front().second();
+        retired_resources_.pop_front();
+    }
+}
+
+void VulkanApplication::TrimTextureImage(VkImage &image,
+                                         MemoryAllocation &image_memory,
+                                         VkFormat format,
+                                         uint32_t width,
+                                         uint32_t height,
+                                         uint32_t mip_levels,
+                                         uint32_t first_level) {
+    std::vector<MipLevel> levels = GetMipChainLayout(width, height, mip_levels, 1);
+    uint32_t trimmed_levels = mip_levels - first_level;
+    VkImage trimmed_image;
+    MemoryAllocation trimmed_image_memory;
+    CreateImage(physical_device_,
+                device_,
+                levels[first_level].width,
+                levels[first_level].height,
+                format,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                trimmed_image,
+                trimmed_image_memory,
+                trimmed_levels);
+
+    upload_batch_.Begin();
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(device_, command_pool_);
+
+    std::array<VkImageMemoryBarrier, 2> barriers{};
+    for (VkImageMemoryBarrier &barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = trimmed_levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+    // Earlier frames on the queue finish sampling the old image before it is read.
+    barriers[0].image = image;
+    barriers[0].subresourceRange.baseMipLevel = first_level;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].image = trimmed_image;
+    barriers[1].subresourceRange.baseMipLevel = 0;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data());
+
+    std::vector<VkImageCopy> regions(trimmed_levels);
+    for (uint32_t i = 0; i < trimmed_levels; i++) {
+        VkImageCopy &region = regions[i];
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.mipLevel = first_level + i;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffset = {0, 0, 0};
+        region.dstSubresource = region.srcSubresource;
+        region.dstSubresource.mipLevel = i;
+        region.dstOffset = {0, 0, 0};
+        region.extent = {levels[first_level + i].width, levels[first_level + i].height, 1};
+    }
+    vkCmdCopyImage(command_buffer,
+                   image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   trimmed_image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   static_cast<uint32_t>(regions.size()),
+                   regions.data());
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barriers[1]);
+
+    EndSingleTimeCommands(device_, command_pool_, graphics_queue_, command_buffer);
+
+    VkImage old_image = image;
+    MemoryAllocation old_image_memory = image_memory;
+    RetireResource([this, old_image, old_image_memory]() mutable {
+        DestroyImage(device_, old_image, old_image_memory);
+    });
+    image = trimmed_image;
+    image_memory = trimmed_image_memory;
+}
 
 void VulkanApplication::Cleanup() {
+    asset_streamer_.Stop();
+    vkDeviceWaitIdle(device_);
+    upload_batch_.Destroy();
+    ReleaseRetiredResources(true);
+    DestroyResources();
     vkFreeCommandBuffers(device_, command_pool_, command_buffers_.size(), command_buffers_.data());
     DestroySyncObjects();
     vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
     DestroyUniformBuffers();
-    vkDestroyBuffer(device_, index_buffer_, nullptr);
-    vkFreeMemory(device_, index_buffer_memory_, nullptr);
-    vkDestroyBuffer(device_, vertex_buffer_, nullptr);
-    vkFreeMemory(device_, vertex_buffer_memory_, nullptr);
+    DestroyBuffer(device_, index_buffer_, index_buffer_memory_);
+    DestroyBuffer(device_, vertex_buffer_, vertex_buffer_memory_);
     DestroyFramebuffers();
     vkDestroyImageView(device_, depth_image_view_, nullptr);
-    vkDestroyImage(device_, depth_image_, nullptr);
-    vkFreeMemory(device_, depth_image_memory_, nullptr);
+    DestroyImage(device_, depth_image_, depth_image_memory_);
     vkDestroyCommandPool(device_, command_pool_, nullptr);
     vkDestroyPipeline(device_, graphics_pipeline_, nullptr);
     vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
-    vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
+    DestroyPipelineCache();
+    bool cached_layout = false;
+    for (const auto &entry : descriptor_set_layouts_) {
+        cached_layout = cached_layout || entry.second == descriptor_set_layout_;
+        vkDestroyDescriptorSetLayout(device_, entry.second, nullptr);
+    }
+    descriptor_set_layouts_.clear();
+    if (!cached_layout) {
+        vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
+    }
     vkDestroyRenderPass(device_, render_pass_, nullptr);
     DestroyShaderModules();
     DestroySwapchainImageViews();
     vkDestroySwapchainKHR(device_, swapchain_, nullptr);
+    allocator_.Destroy();
     vkDestroyDevice(device_, nullptr);
     vkDestroySurfaceKHR(instance_, surface_, nullptr);
     DestroyDebugMessenger();
@@ -120,6 +462,7 @@ void VulkanApplication::CreateDebugMessenger() {
 }
 
 void VulkanApplication::CreateSurface() {
+#ifdef ANDROID
     VkAndroidSurfaceCreateInfoKHR create_info;
     create_info.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
     create_info.pNext = nullptr;
@@ -130,6 +473,24 @@ void VulkanApplication::CreateSurface() {
                                   &surface_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create surface!");
     }
+#else
+    // There is no window system on the host, VK_EXT_headless_surface gives us a surface the
+    // swapchain can present to without displaying anything (e.g. lavapipe on a CI machine).
+    VkHeadlessSurfaceCreateInfoEXT create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+    create_info.pNext = nullptr;
+    create_info.flags = 0;
+
+    auto func = (PFN_vkCreateHeadlessSurfaceEXT) vkGetInstanceProcAddr(
+            instance_,
+            "vkCreateHeadlessSurfaceEXT");
+    if (func == nullptr) {
+        throw std::runtime_error("VK_EXT_headless_surface is not enabled!");
+    }
+    if (func(instance_, &create_info, nullptr, &surface_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create headless surface!");
+    }
+#endif
 }
 
 void VulkanApplication::CreateDevice() {
@@ -149,7 +510,10 @@ void VulkanApplication::CreateDevice() {
         queue_create_infos.push_back(queue_create_info);
     }
 
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device_, &supported_features);
     VkPhysicalDeviceFeatures device_features{};
+    device_features.textureCompressionETC2 = supported_features.textureCompressionETC2;
     VkDeviceCreateInfo device_create_info{};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     device_create_info.pQueueCreateInfos = queue_create_infos.data();
@@ -170,15 +534,18 @@ void VulkanApplication::CreateDevice() {
     if (graphics_queue_ == VK_NULL_HANDLE || present_queue_ == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to get graphics or present queue failed!");
     }
+
+    allocator_.Init(physical_device_, device_);
 }
 
 void VulkanApplication::CreateSwapchain() {
     SwapChainSupportDetails support_details = QuerySwapChainSupport(physical_device_, surface_);
     VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(support_details.formats);
     VkPresentModeKHR present_mode = ChooseSwapPresentMode(support_details.present_modes);
-    uint32_t window_width = ANativeWindow_getWidth(static_cast<ANativeWindow *>(native_window_));
-    uint32_t window_height = ANativeWindow_getHeight(static_cast<ANativeWindow *>(native_window_));
-    VkExtent2D extent = ChooseSwapExtent(support_details.capabilities, window_width, window_height);
+    VkExtent2D window_extent = GetWindowExtent();
+    VkExtent2D extent = ChooseSwapExtent(support_details.capabilities,
+                                         window_extent.width,
+                                         window_extent.height);
 
     uint32_t image_count = support_details.capabilities.minImageCount + 1;
     if (support_details.capabilities.maxImageCount > 0
@@ -212,16 +579,19 @@ void VulkanApplication::CreateSwapchain() {
     }
 
     create_info.preTransform = support_details.capabilities.currentTransform;
-    create_info.compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+    create_info.compositeAlpha = ChooseCompositeAlpha(support_details.capabilities);
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
 
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // Set while recreating, lets the presentation engine hand resources over to the new one.
+    create_info.oldSwapchain = swapchain_;
 
-    if (vkCreateSwapchainKHR(device_, &create_info, nullptr, &swapchain_) != VK_SUCCESS
-        || swapchain_ == VK_NULL_HANDLE) {
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    if (vkCreateSwapchainKHR(device_, &create_info, nullptr, &swapchain) != VK_SUCCESS
+        || swapchain == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to create swap chain!");
     }
+    swapchain_ = swapchain;
 
     vkGetSwapchainImagesKHR(device_, swapchain_, &image_count, nullptr);
     swapchain_images_.resize(image_count);
@@ -299,13 +669,126 @@ void VulkanApplication::CreateRenderPass() {
     }
 }
 
-void VulkanApplication::CreateDescriptorSetLayout() {}
+void VulkanApplication::ReflectShaders() {
+    std::shared_ptr<const ShaderReflection> vert_reflection =
+            GetShaderReflection(vert_shader_code_.data(), vert_shader_code_.size());
+    std::shared_ptr<const ShaderReflection> frag_reflection =
+            GetShaderReflection(frag_shader_code_.data(), frag_shader_code_.size());
+    if (!MergeShaderReflections(*vert_reflection, *frag_reflection, shader_reflection_)) {
+        throw std::runtime_error("failed to merge shader reflections!");
+    }
+    // Uniform buffers are bound at the offset of the frame slot, see GetUniformOffset.
+    UseDynamicBuffers(shader_reflection_);
+
+    if (attribute_descriptions_.empty()) {
+        // Only a tightly packed vertex can be derived, check the stride if there is one.
+        std::vector<VkVertexInputBindingDescription> binding_descriptions =
+                GetVertexBindingDescriptions(shader_reflection_);
+        if (!binding_descriptions_.empty() && !binding_descriptions.empty()
+            && binding_descriptions_[0].stride != binding_descriptions[0].stride) {
+            throw std::runtime_error("failed to derive vertex attributes, the stride does not "
+                                     "match the vertex shader inputs!");
+        }
+        if (binding_descriptions_.empty()) {
+            binding_descriptions_ = binding_descriptions;
+        }
+        attribute_descriptions_ = GetVertexAttributeDescriptions(shader_reflection_);
+        return;
+    }
+    for (const ShaderInput &input : shader_reflection_.inputs) {
+        auto it = std::find_if(attribute_descriptions_.begin(), attribute_descriptions_.end(),
+                               [&input](const VkVertexInputAttributeDescription &attribute) {
+                                   return attribute.location == input.location;
+                               });
+        if (it == attribute_descriptions_.end()) {
+            LOGE("vertex shader input %u has no attribute", input.location);
+            throw std::runtime_error("failed to match vertex attributes to the vertex shader!");
+        }
+    }
+}
+
+void VulkanApplication::CreateDescriptorSetLayout() {
+    // The pipeline layout has a single set.
+    for (const ShaderBinding &binding : shader_reflection_.bindings) {
+        if (binding.set != 0) {
+            LOGW("set %u binding %u of the shaders is not bound", binding.set, binding.binding);
+        }
+    }
+    descriptor_set_layout_ = GetDescriptorSetLayout(
+            GetDescriptorSetLayoutBindings(shader_reflection_, 0));
+}
+
+VkDescriptorSetLayout VulkanApplication::GetDescriptorSetLayout(
+        const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+    std::string key(reinterpret_cast<const char *>(bindings.data()),
+                    bindings.size() * sizeof(VkDescriptorSetLayoutBinding));
+    auto it = descriptor_set_layouts_.find(key);
+    if (it != descriptor_set_layouts_.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_create_info{};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_create_info.pBindings = bindings.data();
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(device_, &layout_create_info, nullptr,
+                                    &descriptor_set_layout) != VK_SUCCESS ||
+        descriptor_set_layout == VK_NULL_HANDLE) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+    descriptor_set_layouts_.emplace(std::move(key), descriptor_set_layout);
+    return descriptor_set_layout;
+}
 
 void VulkanApplication::CreateShaderModules() {
     vert_shader_module_ = CreateShaderModule(device_, vert_shader_code_);
     frag_shader_module_ = CreateShaderModule(device_, frag_shader_code_);
 }
 
+void VulkanApplication::CreatePipelineCache() {
+    FileView cache_data = Filesystem::GetInstance().MapData(pipeline_cache_file_);
+    if (!cache_data.empty() && !IsPipelineCacheCompatible(cache_data.data(), cache_data.size())) {
+        LOGI("Pipeline cache %s is from another device or driver, discarding it",
+             pipeline_cache_file_.c_str());
+        cache_data = FileView();
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = cache_data.size();
+    create_info.pInitialData = cache_data.data();
+
+    if (vkCreatePipelineCache(device_, &create_info, nullptr, &pipeline_cache_) == VK_SUCCESS) {
+        return;
+    }
+    // Drivers may still reject data that passed the header check, start over empty then.
+    create_info.initialDataSize = 0;
+    create_info.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device_, &create_info, nullptr, &pipeline_cache_) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+void VulkanApplication::DestroyPipelineCache() {
+    if (pipeline_cache_ == VK_NULL_HANDLE) return;
+
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(device_, pipeline_cache_, &data_size, nullptr) == VK_SUCCESS
+        && data_size > 0) {
+        std::vector<uint8_t> data(data_size);
+        if (vkGetPipelineCacheData(device_, pipeline_cache_, &data_size, data.data())
+            == VK_SUCCESS) {
+            if (!Filesystem::GetInstance().WriteData(pipeline_cache_file_, data.data(),
+                                                     data_size)) {
+                LOGW("failed to save pipeline cache %s", pipeline_cache_file_.c_str());
+            }
+        }
+    }
+    vkDestroyPipelineCache(device_, pipeline_cache_, nullptr);
+    pipeline_cache_ = VK_NULL_HANDLE;
+}
+
 void VulkanApplication::CreateGraphicsPipeline() {
     VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
     vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -335,24 +818,22 @@ void VulkanApplication::CreateGraphicsPipeline() {
     input_assembly.topology = primitive_topology_;
     input_assembly.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) swapchain_extent_.width;
-    viewport.height = (float) swapchain_extent_.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchain_extent_;
-
+    // Viewport and scissor are set in Draw, so the pipeline survives swapchain recreation.
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
+
+    std::array<VkDynamicState, 2> dynamic_states = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+    };
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
 
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -415,13 +896,13 @@ void VulkanApplication::CreateGraphicsPipeline() {
     pipeline_create_info.pMultisampleState = &multisampling;
     pipeline_create_info.pDepthStencilState = &depth_stencil;
     pipeline_create_info.pColorBlendState = &color_blending;
-    pipeline_create_info.pDynamicState = nullptr; // Optional
+    pipeline_create_info.pDynamicState = &dynamic_state;
     pipeline_create_info.layout = pipeline_layout_;
     pipeline_create_info.renderPass = render_pass_;
     pipeline_create_info.subpass = 0;
     pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipeline_create_info.basePipelineIndex = -1; // Optional
-    if (vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
+    if (vkCreateGraphicsPipelines(device_, pipeline_cache_, 1, &pipeline_create_info, nullptr,
                                   &graphics_pipeline_) != VK_SUCCESS
         || graphics_pipeline_ == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to create graphics pipeline!");
@@ -434,7 +915,8 @@ void VulkanApplication::CreateCommandPool() {
     VkCommandPoolCreateInfo pool_info{};
     pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     pool_info.queueFamilyIndex = queue_family_indices.graphics_family;
-    pool_info.flags = 0; // Optional
+    // Frame command buffers are re-recorded every frame, see Draw.
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     if (vkCreateCommandPool(device_, &pool_info, nullptr, &command_pool_) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
@@ -503,11 +985,58 @@ void VulkanApplication::CreateTextureImageView() {}
 
 void VulkanApplication::CreateTextureSampler() {}
 
-void VulkanApplication::CreateDescriptorPool() {}
+void VulkanApplication::CreateDescriptorPool() {
+    std::vector<VkDescriptorPoolSize> pool_sizes = GetDescriptorPoolSizes(shader_reflection_,
+                                                                          0,
+                                                                          max_frames_in_flight_);
+    if (pool_sizes.empty()) {
+        return;
+    }
 
-void VulkanApplication::CreateDescriptorSets() {}
+    VkDescriptorPoolCreateInfo pool_create_info{};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_create_info.pPoolSizes = pool_sizes.data();
+    pool_create_info.maxSets = max_frames_in_flight_;
+    if (vkCreateDescriptorPool(device_, &pool_create_info, nullptr, &descriptor_pool_) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
 
-void VulkanApplication::CreateCommandBuffers() {}
+void VulkanApplication::CreateDescriptorSets() {
+    if (descriptor_pool_ == VK_NULL_HANDLE) {
+        return;
+    }
+    std::vector<VkDescriptorSetLayout> layouts(max_frames_in_flight_, descriptor_set_layout_);
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = max_frames_in_flight_;
+    alloc_info.pSetLayouts = layouts.data();
+
+    descriptor_sets_.resize(max_frames_in_flight_);
+    if (vkAllocateDescriptorSets(device_, &alloc_info, descriptor_sets_.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+}
+
+void VulkanApplication::CreateCommandBuffers() {
+    command_buffers_.resize(max_frames_in_flight_);
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = command_pool_;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = static_cast<uint32_t>(command_buffers_.size());
+
+    if (vkAllocateCommandBuffers(device_, &alloc_info, command_buffers_.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+}
+
+void VulkanApplication::UpdateFrame(uint32_t frame_index) {}
+
+void VulkanApplication::RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index) {}
 
 void VulkanApplication::CreateSyncObjects() {
     image_available_semaphores_.resize(max_frames_in_flight_);
@@ -534,6 +1063,8 @@ void VulkanApplication::CreateSyncObjects() {
     }
 }
 
+void VulkanApplication::DestroyResources() {}
+
 void VulkanApplication::DestroySyncObjects() {
     for (size_t i = 0; i < max_frames_in_flight_; i++) {
         vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
@@ -547,12 +1078,9 @@ void VulkanApplication::DestroySyncObjects() {
 }
 
 void VulkanApplication::DestroyUniformBuffers() {
-    for (size_t i = 0; i < uniform_buffers_.size(); i++) {
-        vkDestroyBuffer(device_, uniform_buffers_[i], nullptr);
-        vkFreeMemory(device_, uniform_buffers_memory_[i], nullptr);
-    }
-    uniform_buffers_.clear();
-    uniform_buffers_memory_.clear();
+    DestroyBuffer(device_, uniform_buffer_, uniform_buffer_memory_);
+    uniform_buffer_ = VK_NULL_HANDLE;
+    uniform_buffer_stride_ = 0;
 }
 
 void VulkanApplication::DestroyFramebuffers() {
@@ -598,7 +1126,7 @@ VkPhysicalDevice VulkanApplication::PickPhysicalDevice(VkInstance instance,
     std::vector<VkPhysicalDevice> devices(device_count);
     vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
 
-    VkPhysicalDevice physical_device;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     for (const auto &device : devices) {
         QueueFamilyIndices indices = FindQueueFamilies(device, surface);
         if (!indices.IsComplete()) {
@@ -749,17 +1277,65 @@ VkExtent2D VulkanApplication::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &c
     }
 }
 
+VkCompositeAlphaFlagBitsKHR
+VulkanApplication::ChooseCompositeAlpha(const VkSurfaceCapabilitiesKHR &capabilities) {
+    std::array<VkCompositeAlphaFlagBitsKHR, 4> preferred = {
+            VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+            VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+            VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
+            VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR
+    };
+    for (auto composite_alpha : preferred) {
+        if (capabilities.supportedCompositeAlpha & composite_alpha) {
+            return composite_alpha;
+        }
+    }
+    throw std::runtime_error("failed to find supported composite alpha!");
+}
+
+VkExtent2D VulkanApplication::GetWindowExtent() {
+#ifdef ANDROID
+    auto *native_window = static_cast<ANativeWindow *>(native_window_);
+    return {static_cast<uint32_t>(ANativeWindow_getWidth(native_window)),
+            static_cast<uint32_t>(ANativeWindow_getHeight(native_window))};
+#else
+    return window_extent_;
+#endif
+}
+
+bool VulkanApplication::IsPipelineCacheCompatible(const uint8_t *data, size_t size) {
+    // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID (uint32_t
+    // each) followed by pipelineCacheUUID.
+    const size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (size < header_size) {
+        return false;
+    }
+    uint32_t header[4];
+    memcpy(header, data, sizeof(header));
+    if (header[0] < header_size || header[0] > size
+        || header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device_, &properties);
+    return header[2] == properties.vendorID
+           && header[3] == properties.deviceID
+           && memcmp(data + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
 VkImageView VulkanApplication::CreateImageView(VkDevice device,
                                                VkImage image,
                                                VkFormat format,
-                                               VkImageAspectFlags aspect_flags) {
+                                               VkImageAspectFlags aspect_flags,
+                                               uint32_t mip_levels) {
     VkImageViewCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     create_info.image = image;
     create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
     create_info.format = format;
     create_info.subresourceRange.baseMipLevel = 0;
-    create_info.subresourceRange.levelCount = 1;
+    create_info.subresourceRange.levelCount = mip_levels;
     create_info.subresourceRange.baseArrayLayer = 0;
     create_info.subresourceRange.layerCount = 1;
     create_info.subresourceRange.aspectMask = aspect_flags;
@@ -802,6 +1378,27 @@ VkFormat VulkanApplication::FindSupportedFormat(VkPhysicalDevice physical_device
     throw std::runtime_error("failed to find supported format!");
 }
 
+VkFormat VulkanApplication::FindTextureFormat(bool alpha) {
+    std::vector<VkFormat> candidates = {VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,
+                                        VK_FORMAT_R8G8B8A8_SRGB};
+    if (!alpha) {
+        candidates.insert(candidates.begin(), VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK);
+    }
+    return FindSupportedFormat(physical_device_,
+                               candidates,
+                               VK_IMAGE_TILING_OPTIMAL,
+                               VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                               VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+}
+
+bool VulkanApplication::SupportsTextureFormat(VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
 VkShaderModule
 VulkanApplication::CreateShaderModule(VkDevice device, const std::vector<char> &code) {
     VkShaderModuleCreateInfo create_info{};
@@ -825,14 +1422,15 @@ void VulkanApplication::CreateImage(VkPhysicalDevice physical_device,
                                     VkImageUsageFlags usage,
                                     VkMemoryPropertyFlags properties,
                                     VkImage &image,
-                                    VkDeviceMemory &image_memory) {
+                                    MemoryAllocation &image_memory,
+                                    uint32_t mip_levels) {
     VkImageCreateInfo image_create_info{};
     image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_create_info.imageType = VK_IMAGE_TYPE_2D;
     image_create_info.extent.width = width;
     image_create_info.extent.height = height;
     image_create_info.extent.depth = 1;
-    image_create_info.mipLevels = 1;
+    image_create_info.mipLevels = mip_levels;
     image_create_info.arrayLayers = 1;
     image_create_info.format = format;
     image_create_info.tiling = tiling;
@@ -848,18 +1446,18 @@ void VulkanApplication::CreateImage(VkPhysicalDevice physical_device,
     VkMemoryRequirements mem_requirements;
     vkGetImageMemoryRequirements(device, image, &mem_requirements);
 
-    VkMemoryAllocateInfo memory_alloc_info{};
-    memory_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memory_alloc_info.allocationSize = mem_requirements.size;
-    memory_alloc_info.memoryTypeIndex = FindMemoryType(physical_device,
-                                                       mem_requirements.memoryTypeBits,
-                                                       properties);
+    image_memory = allocator_.Allocate(mem_requirements,
+                                       properties,
+                                       tiling == VK_IMAGE_TILING_LINEAR);
 
-    if (vkAllocateMemory(device, &memory_alloc_info, nullptr, &image_memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    vkBindImageMemory(device, image, image_memory.memory, image_memory.offset);
+}
 
-    vkBindImageMemory(device, image, image_memory, 0);
+void VulkanApplication::DestroyImage(VkDevice device,
+                                     VkImage image,
+                                     MemoryAllocation &image_memory) {
+    vkDestroyImage(device, image, nullptr);
+    allocator_.Free(image_memory);
 }
 
 
@@ -883,7 +1481,8 @@ void VulkanApplication::TransitionImageLayout(VkDevice device,
                                               VkImage image,
                                               VkFormat format,
                                               VkImageLayout old_layout,
-                                              VkImageLayout new_layout) {
+                                              VkImageLayout new_layout,
+                                              uint32_t mip_levels) {
     VkCommandBuffer command_buffer = BeginSingleTimeCommands(device, command_pool);
 
     VkImageMemoryBarrier barrier{};
@@ -895,7 +1494,7 @@ void VulkanApplication::TransitionImageLayout(VkDevice device,
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mip_levels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -946,8 +1545,339 @@ void VulkanApplication::TransitionImageLayout(VkDevice device,
     EndSingleTimeCommands(device, command_pool, graphics_queue, command_buffer);
 }
 
+bool VulkanApplication::SupportsBlitMipmaps(VkPhysicalDevice physical_device, VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                    VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+void VulkanApplication::GenerateMipmaps(VkDevice device,
+                                        VkCommandPool command_pool,
+                                        VkQueue graphics_queue,
+                                        VkImage image,
+                                        VkFormat format,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        uint32_t mip_levels) {
+    if (!SupportsBlitMipmaps(physical_device_, format)) {
+        throw std::runtime_error("texture image format does not support linear blitting!");
+    }
+
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(device, command_pool);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t mip_width = static_cast<int32_t>(width);
+    int32_t mip_height = static_cast<int32_t>(height);
+    for (uint32_t i = 1; i < mip_levels; i++) {
+        // Level i - 1 has been written (by the copy or the previous blit), read it next.
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier);
+
+        int32_t next_width = mip_width > 1 ? mip_width / 2 : 1;
+        int32_t next_height = mip_height > 1 ? mip_height / 2 : 1;
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mip_width, mip_height, 1};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {next_width, next_height, 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        vkCmdBlitImage(command_buffer,
+                       image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1,
+                       &blit,
+                       VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier);
+
+        mip_width = next_width;
+        mip_height = next_height;
+    }
+
+    // The last level was only blitted to.
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+
+    EndSingleTimeCommands(device, command_pool, graphics_queue, command_buffer);
+}
+
+void VulkanApplication::CreateTextureStaging(uint32_t width,
+                                             uint32_t height,
+                                             VkFormat format,
+                                             size_t level0_size,
+                                             TextureData &texture) {
+    uint32_t mip_levels = GetMipLevelCount(width, height);
+    bool blit = !generate_mipmaps_on_cpu_ && SupportsBlitMipmaps(physical_device_, format);
+    VkDeviceSize size = std::max<VkDeviceSize>(
+            GetMipChainSize(width, height, blit ? 1 : mip_levels, 4), level0_size);
+    CreateBuffer(physical_device_,
+                 device_,
+                 size,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 texture.staging_buffer,
+                 texture.staging_memory);
+    texture.format = format;
+    texture.data = static_cast<const uint8_t *>(texture.staging_memory.mapped);
+    texture.size = static_cast<size_t>(width) * height * 4;
+    texture.levels = GetMipChainLayout(width, height, 1, 4);
+    texture.generate_mipmaps = false;
+}
+
+void VulkanApplication::DestroyTextureStaging(TextureData &texture) {
+    if (texture.staging_buffer != VK_NULL_HANDLE) {
+        DestroyBuffer(device_, texture.staging_buffer, texture.staging_memory);
+        texture.staging_buffer = VK_NULL_HANDLE;
+        texture.data = nullptr;
+    }
+}
+
+uint32_t VulkanApplication::UploadStagedTextureImage(const TextureData &texture,
+                                                     VkImage &image,
+                                                     MemoryAllocation &image_memory) {
+    uint32_t width = texture.levels[0].width;
+    uint32_t height = texture.levels[0].height;
+    VkFormat format = texture.format;
+    uint32_t mip_levels = GetMipLevelCount(width, height);
+    bool blit = !generate_mipmaps_on_cpu_ && SupportsBlitMipmaps(physical_device_, format);
+    std::vector<MipLevel> levels = GetMipChainLayout(width, height, blit ? 1 : mip_levels, 4);
+    VkBuffer staging_buffer = texture.staging_buffer;
+    MemoryAllocation staging_buffer_memory = texture.staging_memory;
+
+    // Level 0 was written where the GPU copies it from, the lower levels are filtered from it in
+    // place, so the pixels never exist anywhere else.
+    uint8_t *staging = static_cast<uint8_t *>(staging_buffer_memory.mapped);
+    GenerateMipChain(staging,
+                     staging,
+                     width,
+                     height,
+                     blit ? 1 : mip_levels,
+                     format == VK_FORMAT_R8G8B8A8_SRGB);
+
+    CreateImage(physical_device_,
+                device_,
+                width,
+                height,
+                format,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                image,
+                image_memory,
+                mip_levels);
+
+    TransitionImageLayout(device_,
+                          command_pool_,
+                          graphics_queue_,
+                          image,
+                          format,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          mip_levels);
+
+    CopyBufferToImage(device_, command_pool_, graphics_queue_, staging_buffer, image, levels);
+
+    if (blit) {
+        GenerateMipmaps(device_,
+                        command_pool_,
+                        graphics_queue_,
+                        image,
+                        format,
+                        width,
+                        height,
+                        mip_levels);
+    } else {
+        TransitionImageLayout(device_,
+                              command_pool_,
+                              graphics_queue_,
+                              image,
+                              format,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              mip_levels);
+    }
+
+    ReleaseStagingBuffer(device_, staging_buffer, staging_buffer_memory);
+    return mip_levels;
+}
+
+uint32_t VulkanApplication::UploadTextureImage(const uint8_t *pixels,
+                                               uint32_t width,
+                                               uint32_t height,
+                                               VkFormat format,
+                                               VkImage &image,
+                                               MemoryAllocation &image_memory) {
+    TextureData texture;
+    CreateTextureStaging(width, height, format, static_cast<size_t>(width) * height * 4, texture);
+    memcpy(texture.staging_memory.mapped, pixels, texture.size);
+    return UploadStagedTextureImage(texture, image, image_memory);
+}
+
+uint32_t VulkanApplication::UploadTextureImage(const uint8_t *data,
+                                               size_t size,
+                                               const std::vector<MipLevel> &levels,
+                                               VkFormat format,
+                                               VkImage &image,
+                                               MemoryAllocation &image_memory,
+                                               bool generate_mipmaps) {
+    bool blit = generate_mipmaps && levels.size() == 1 && SupportsBlitMipmaps(physical_device_,
+                                                                              format);
+    uint32_t mip_levels = blit ? GetMipLevelCount(levels[0].width, levels[0].height)
+                               : static_cast<uint32_t>(levels.size());
+    VkDeviceSize image_size = size;
+
+    VkBuffer staging_buffer;
+    MemoryAllocation staging_buffer_memory;
+    CreateBuffer(physical_device_,
+                 device_,
+                 image_size,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 staging_buffer,
+                 staging_buffer_memory);
+
+    memcpy(staging_buffer_memory.mapped, data, static_cast<size_t>(image_size));
+
+    // Transfer source also for TrimTextureImage.
+    CreateImage(physical_device_,
+                device_,
+                levels[0].width,
+                levels[0].height,
+                format,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                image,
+                image_memory,
+                mip_levels);
+
+    TransitionImageLayout(device_,
+                          command_pool_,
+                          graphics_queue_,
+                          image,
+                          format,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          mip_levels);
+
+    CopyBufferToImage(device_, command_pool_, graphics_queue_, staging_buffer, image, levels);
+
+    if (blit) {
+        GenerateMipmaps(device_,
+                        command_pool_,
+                        graphics_queue_,
+                        image,
+                        format,
+                        levels[0].width,
+                        levels[0].height,
+                        mip_levels);
+    } else {
+        TransitionImageLayout(device_,
+                              command_pool_,
+                              graphics_queue_,
+                              image,
+                              format,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              mip_levels);
+    }
+
+    ReleaseStagingBuffer(device_, staging_buffer, staging_buffer_memory);
+    return mip_levels;
+}
+
+uint32_t VulkanApplication::UploadTexture(const TextureData &texture,
+                                         VkImage &image,
+                                         MemoryAllocation &image_memory) {
+    if (texture.staging_buffer != VK_NULL_HANDLE) {
+        return UploadStagedTextureImage(texture, image, image_memory);
+    }
+    if (!texture.pixels.empty()) {
+        return UploadTextureImage(texture.pixels.data(),
+                                  texture.levels[0].width,
+                                  texture.levels[0].height,
+                                  texture.format,
+                                  image,
+                                  image_memory);
+    }
+    return UploadTextureImage(texture.data,
+                              texture.size,
+                              texture.levels,
+                              texture.format,
+                              image,
+                              image_memory,
+                              texture.generate_mipmaps);
+}
+
 VkCommandBuffer VulkanApplication::BeginSingleTimeCommands(VkDevice device,
                                                            VkCommandPool command_pool) {
+    if (upload_batch_.IsRecording()) {
+        return upload_batch_.GetCommandBuffer();
+    }
+
     VkCommandBufferAllocateInfo alloc_info{};
     alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -970,6 +1900,8 @@ void VulkanApplication::EndSingleTimeCommands(VkDevice device,
                                               VkCommandPool command_pool,
                                               VkQueue graphics_queue,
                                               VkCommandBuffer command_buffer) {
+    if (upload_batch_.IsRecording()) return;
+
     vkEndCommandBuffer(command_buffer);
 
     VkSubmitInfo submit_info{};
@@ -989,7 +1921,7 @@ void VulkanApplication::CreateBuffer(VkPhysicalDevice physical_device,
                                      VkBufferUsageFlags usage,
                                      VkMemoryPropertyFlags properties,
                                      VkBuffer &buffer,
-                                     VkDeviceMemory &buffer_memory) {
+                                     MemoryAllocation &buffer_memory) {
     VkBufferCreateInfo buffer_create_info{};
     buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_create_info.size = size;
@@ -1002,16 +1934,40 @@ void VulkanApplication::CreateBuffer(VkPhysicalDevice physical_device,
     VkMemoryRequirements mem_requirements;
     vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
 
-    VkMemoryAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_requirements.size;
-    alloc_info.memoryTypeIndex = FindMemoryType(physical_device, mem_requirements.memoryTypeBits,
-                                                properties);
+    buffer_memory = allocator_.Allocate(mem_requirements, properties, true);
+    vkBindBufferMemory(device, buffer, buffer_memory.memory, buffer_memory.offset);
+}
 
-    if (vkAllocateMemory(device, &alloc_info, nullptr, &buffer_memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
-    vkBindBufferMemory(device, buffer, buffer_memory, 0);
+void VulkanApplication::DestroyBuffer(VkDevice device,
+                                      VkBuffer buffer,
+                                      MemoryAllocation &buffer_memory) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator_.Free(buffer_memory);
+}
+
+void VulkanApplication::ReleaseStagingBuffer(VkDevice device,
+                                             VkBuffer buffer,
+                                             MemoryAllocation &buffer_memory) {
+    MemoryAllocation memory = buffer_memory;
+    buffer_memory = MemoryAllocation();
+    upload_batch_.Defer([this, device, buffer, memory]() mutable {
+        DestroyBuffer(device, buffer, memory);
+    });
+}
+
+void VulkanApplication::CreateUniformRingBuffer(VkDeviceSize element_size, uint32_t slot_count) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device_, &properties);
+    VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    uniform_buffer_stride_ = (element_size + alignment - 1) / alignment * alignment;
+
+    CreateBuffer(physical_device_,
+                 device_,
+                 uniform_buffer_stride_ * slot_count,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 uniform_buffer_,
+                 uniform_buffer_memory_);
 }
 
 void VulkanApplication::CopyBuffer(VkDevice device,
@@ -1020,20 +1976,7 @@ void VulkanApplication::CopyBuffer(VkDevice device,
                                    VkBuffer src_buffer,
                                    VkBuffer dst_buffer,
                                    VkDeviceSize size) {
-    VkCommandBufferAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandPool = command_pool;
-    alloc_info.commandBufferCount = 1;
-
-    VkCommandBuffer command_buffer;
-    vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
-
-    VkCommandBufferBeginInfo begin_info{};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(command_buffer, &begin_info);
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(device, command_pool);
 
     VkBufferCopy copy_region{};
     copy_region.srcOffset = 0; // Optional
@@ -1041,16 +1984,7 @@ void VulkanApplication::CopyBuffer(VkDevice device,
     copy_region.size = size;
     vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
 
-    vkEndCommandBuffer(command_buffer);
-
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
-    vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphics_queue);
-
-    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    EndSingleTimeCommands(device, command_pool, graphics_queue, command_buffer);
 }
 
 void VulkanApplication::CopyBufferToImage(VkDevice device,
@@ -1085,4 +2019,39 @@ void VulkanApplication::CopyBufferToImage(VkDevice device,
                           graphics_queue,
                           command_buffer);
 }
+
+void VulkanApplication::CopyBufferToImage(VkDevice device,
+                                          VkCommandPool command_pool,
+                                          VkQueue graphics_queue,
+                                          VkBuffer buffer,
+                                          VkImage image,
+                                          const std::vector<MipLevel> &levels) {
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(device, command_pool);
+
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        VkBufferImageCopy &region = regions[i];
+        region.bufferOffset = levels[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {levels[i].width, levels[i].height, 1};
+    }
+
+    vkCmdCopyBufferToImage(command_buffer,
+                           buffer,
+                           image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+
+    EndSingleTimeCommands(device,
+                          command_pool,
+                          graphics_queue,
+                          command_buffer);
+}
 } // namespace tiny_engine
\ No newline at end of file
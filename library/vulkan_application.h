@@ -2,11 +2,23 @@
 #define TINY_ENGINE_VULKAN_APPLICATION_H
 
 #include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "asset_streamer.h"
+#include "memory_allocator.h"
+#include "mip_chain.h"
+#include "spirv_reflection.h"
+#include "texture_residency.h"
+#include "upload_batch.h"
+
 namespace tiny_engine {
 
+struct TextureData;
+
 struct QueueFamilyIndices {
     int32_t graphics_family = -1;
     int32_t present_family = -1;
@@ -30,6 +42,10 @@ public:
 
     virtual void Cleanup();
 
+    // Rebuilds the swapchain and everything sized by it (image views, depth buffer, framebuffers,
+    // command buffers) after a resize or rotation. Pipelines, buffers and textures are kept.
+    virtual void RecreateSwapchain();
+
 protected:
     virtual void CreateInstance();
 
@@ -45,10 +61,19 @@ protected:
 
     virtual void CreateRenderPass();
 
+    // Reflects vert_shader_code_ and frag_shader_code_ into shader_reflection_, with uniform and
+    // storage buffers made dynamic. Empty binding_descriptions_ and attribute_descriptions_ are
+    // derived from the vertex shader inputs, given ones are checked against them.
+    virtual void ReflectShaders();
+
+    // Set 0 of shader_reflection_, through GetDescriptorSetLayout.
     virtual void CreateDescriptorSetLayout();
 
     virtual void CreateShaderModules();
 
+    // Seeds pipeline_cache_ from pipeline_cache_file_ in the Filesystem data directory.
+    virtual void CreatePipelineCache();
+
     virtual void CreateGraphicsPipeline();
 
     virtual void CreateCommandPool();
@@ -65,8 +90,11 @@ protected:
 
     virtual void CreateUniformBuffers();
 
+    // Room for max_frames_in_flight_ sets of descriptor_set_layout_, as shader_reflection_
+    // declares them. None if the shaders use no descriptors.
     virtual void CreateDescriptorPool();
 
+    // Allocates descriptor_sets_, one per frame slot. Overrides call it before writing them.
     virtual void CreateDescriptorSets();
 
     virtual void CreateTextureImage();
@@ -77,6 +105,55 @@ protected:
 
     virtual void CreateSyncObjects();
 
+    // Called by Draw before UpdateFrame. Records the uploads of streamed assets which finished
+    // decoding into one batch within stream_upload_budget_ and submits it ahead of the frame.
+    virtual void UploadStreamedAssets();
+
+    // Called by Draw after UploadStreamedAssets, lets texture_residency_ trim, evict and
+    // restream textures for this frame.
+    virtual void UpdateTextureResidency();
+
+    // texture_memory_budget_, or a quarter of the smallest device local heap if that is 0.
+    virtual size_t GetTextureMemoryBudget();
+
+    // Runs release once no frame in flight can use the resource any more, e.g. to destroy an
+    // image which descriptor sets of earlier frames still reference.
+    virtual void RetireResource(std::function<void()> release);
+
+    // Runs the releases whose frames have finished, or all of them with the GPU idle.
+    virtual void ReleaseRetiredResources(bool all);
+
+    // Replaces a sampled image of mip_levels levels by one without its first_level top levels,
+    // copied on the GPU in the upload batch. The old image is retired, views of it must be
+    // replaced by the caller.
+    virtual void TrimTextureImage(VkImage &image,
+                                  MemoryAllocation &image_memory,
+                                  VkFormat format,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t mip_levels,
+                                  uint32_t first_level);
+
+    // Called by Draw once the resources of frame slot frame_index (uniform slot, descriptor set,
+    // command buffer) are no longer used by the GPU.
+    virtual void UpdateFrame(uint32_t frame_index);
+
+    // Records the draw commands of the current frame, inside the render pass which Draw begins
+    // on framebuffers_[image_index]. current_frame_ is the frame slot being recorded.
+    virtual void RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);
+
+    // Called by Init once the device exists, before the swapchain and pipelines are created, e.g.
+    // to start decoding textures (see TextureSource::Start) while they are.
+    virtual void OnDeviceCreated();
+
+    // Called at the end of RecreateSwapchain with the GPU idle, e.g. to update projections which
+    // depend on swapchain_extent_.
+    virtual void OnSwapchainRecreated();
+
+    // Destroys what a subclass created (textures, samplers, extra buffers). Called by Cleanup
+    // once the streamer is stopped and the GPU is idle, before the base objects are destroyed.
+    virtual void DestroyResources();
+
     virtual void DestroySyncObjects();
 
     virtual void DestroyUniformBuffers();
@@ -85,6 +162,9 @@ protected:
 
     virtual void DestroyShaderModules();
 
+    // Writes pipeline_cache_ back to pipeline_cache_file_ before destroying it.
+    virtual void DestroyPipelineCache();
+
     virtual void DestroySwapchainImageViews();
 
     virtual void DestroyDebugMessenger();
@@ -113,10 +193,20 @@ protected:
                                         uint32_t window_width,
                                         uint32_t window_height);
 
+    virtual VkCompositeAlphaFlagBitsKHR
+    ChooseCompositeAlpha(const VkSurfaceCapabilitiesKHR &capabilities);
+
+    virtual VkExtent2D GetWindowExtent();
+
+    // Checks the VkPipelineCacheHeaderVersionOne of data against physical_device_, a cache saved
+    // by another GPU or driver version is useless and some drivers crash on it.
+    virtual bool IsPipelineCacheCompatible(const uint8_t *data, size_t size);
+
     virtual VkImageView CreateImageView(VkDevice device,
                                         VkImage image,
                                         VkFormat format,
-                                        VkImageAspectFlags aspect_flags);
+                                        VkImageAspectFlags aspect_flags,
+                                        uint32_t mip_levels = 1);
 
     virtual VkFormat FindDepthFormat(VkPhysicalDevice physical_device);
 
@@ -125,9 +215,20 @@ protected:
                                          VkImageTiling tiling,
                                          VkFormatFeatureFlags features);
 
+    // Best format for sampled textures with or without alpha: ETC2 where the device can
+    // sample and linearly filter it, VK_FORMAT_R8G8B8A8_SRGB otherwise.
+    virtual VkFormat FindTextureFormat(bool alpha);
+
+    virtual bool SupportsTextureFormat(VkFormat format);
+
     virtual VkShaderModule CreateShaderModule(VkDevice device,
                                               const std::vector<char> &code);
 
+    // Creates a descriptor set layout once per distinct list of bindings, pipelines whose
+    // shaders declare the same set share it. Destroyed by Cleanup.
+    virtual VkDescriptorSetLayout GetDescriptorSetLayout(
+            const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
     virtual void CreateImage(VkPhysicalDevice physical_device,
                              VkDevice device,
                              uint32_t width,
@@ -137,7 +238,12 @@ protected:
                              VkImageUsageFlags usage,
                              VkMemoryPropertyFlags properties,
                              VkImage &image,
-                             VkDeviceMemory &image_memory);
+                             MemoryAllocation &image_memory,
+                             uint32_t mip_levels = 1);
+
+    virtual void DestroyImage(VkDevice device,
+                              VkImage image,
+                              MemoryAllocation &image_memory);
 
     virtual uint32_t FindMemoryType(VkPhysicalDevice physical_device,
                                     uint32_t type_filter,
@@ -149,7 +255,71 @@ protected:
                                        VkImage image,
                                        VkFormat format,
                                        VkImageLayout old_layout,
-                                       VkImageLayout new_layout);
+                                       VkImageLayout new_layout,
+                                       uint32_t mip_levels = 1);
+
+    // Whether GenerateMipmaps can blit format: needs blit source and destination support and
+    // linear filtering with optimal tiling.
+    virtual bool SupportsBlitMipmaps(VkPhysicalDevice physical_device, VkFormat format);
+
+    // Fills levels 1 to mip_levels - 1 of image by successive linear filtered blits from level 0,
+    // which must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL like the others. Leaves every level
+    // in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+    virtual void GenerateMipmaps(VkDevice device,
+                                 VkCommandPool command_pool,
+                                 VkQueue graphics_queue,
+                                 VkImage image,
+                                 VkFormat format,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t mip_levels);
+
+    // Creates the mapped staging buffer of an RGBA8 texture of width x height in texture, its
+    // level 0 is to be written at staging_memory.mapped (level0_size bytes of room, at least
+    // width * height * 4), e.g. decoded there by ImageDecodePool. UploadTexture then builds the
+    // rest of the chain in place and releases the buffer, DestroyTextureStaging releases it
+    // without an upload.
+    virtual void CreateTextureStaging(uint32_t width,
+                                      uint32_t height,
+                                      VkFormat format,
+                                      size_t level0_size,
+                                      TextureData &texture);
+
+    virtual void DestroyTextureStaging(TextureData &texture);
+
+    // Creates a sampled RGBA8 image with a full mip chain from level 0 in the staging buffer of
+    // texture and uploads it, returns the level count. The chain is blitted on the GPU unless
+    // generate_mipmaps_on_cpu_ is set or the format cannot be blitted, then GenerateMipChain
+    // fills the staging buffer in place. Releases the staging buffer.
+    virtual uint32_t UploadStagedTextureImage(const TextureData &texture,
+                                              VkImage &image,
+                                              MemoryAllocation &image_memory);
+
+    // Like UploadStagedTextureImage, with level 0 copied from pixels into a staging buffer.
+    virtual uint32_t UploadTextureImage(const uint8_t *pixels,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        VkFormat format,
+                                        VkImage &image,
+                                        MemoryAllocation &image_memory);
+
+    // Creates a sampled image with one mip level per entry of levels and uploads the size bytes
+    // of the chain in data to it with a single copy, e.g. ETC2 blocks from a TextureCache or the
+    // levels of a Ktx2Texture. With generate_mipmaps a single level is extended to a full chain
+    // by GenerateMipmaps if the format can be blitted. Returns the level count.
+    virtual uint32_t UploadTextureImage(const uint8_t *data,
+                                        size_t size,
+                                        const std::vector<MipLevel> &levels,
+                                        VkFormat format,
+                                        VkImage &image,
+                                        MemoryAllocation &image_memory,
+                                        bool generate_mipmaps = false);
+
+    // Uploads texture with the overload matching its data, see TextureSource. Returns the level
+    // count.
+    virtual uint32_t UploadTexture(const TextureData &texture,
+                                   VkImage &image,
+                                   MemoryAllocation &image_memory);
 
     virtual VkCommandBuffer BeginSingleTimeCommands(VkDevice device,
                                                     VkCommandPool command_pool);
@@ -165,7 +335,27 @@ protected:
                               VkBufferUsageFlags usage,
                               VkMemoryPropertyFlags properties,
                               VkBuffer &buffer,
-                              VkDeviceMemory &buffer_memory);
+                              MemoryAllocation &buffer_memory);
+
+    virtual void DestroyBuffer(VkDevice device,
+                               VkBuffer buffer,
+                               MemoryAllocation &buffer_memory);
+
+    // Destroys the buffer once the upload batch it was copied from has finished on the GPU.
+    virtual void ReleaseStagingBuffer(VkDevice device,
+                                      VkBuffer buffer,
+                                      MemoryAllocation &buffer_memory);
+
+    virtual void CreateUniformRingBuffer(VkDeviceSize element_size, uint32_t slot_count);
+
+    void *GetUniformSlot(uint32_t slot) {
+        return static_cast<uint8_t *>(uniform_buffer_memory_.mapped)
+               + slot * uniform_buffer_stride_;
+    }
+
+    uint32_t GetUniformOffset(uint32_t slot) {
+        return static_cast<uint32_t>(slot * uniform_buffer_stride_);
+    }
 
     virtual void CopyBuffer(VkDevice device,
                             VkCommandPool command_pool,
@@ -182,6 +372,14 @@ protected:
                                    uint32_t width,
                                    uint32_t height);
 
+    // Copies a tightly packed chain laid out as levels into the matching mip levels of image.
+    virtual void CopyBufferToImage(VkDevice device,
+                                   VkCommandPool command_pool,
+                                   VkQueue graphics_queue,
+                                   VkBuffer buffer,
+                                   VkImage image,
+                                   const std::vector<MipLevel> &levels);
+
 protected:
     std::string application_name_;
     std::vector<const char *> extensions_;
@@ -199,12 +397,16 @@ protected:
     VkDebugUtilsMessengerEXT debug_messenger_ = VK_NULL_HANDLE;
 
     void *native_window_ = nullptr;
+    // Used instead of the native window size by the headless (non-Android) backend, which needs
+    // VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME in extensions_.
+    VkExtent2D window_extent_ = {1280, 720};
     VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 
     VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
     VkDevice device_ = VK_NULL_HANDLE;
     VkQueue graphics_queue_ = VK_NULL_HANDLE;
     VkQueue present_queue_ = VK_NULL_HANDLE;
+    MemoryAllocator allocator_;
 
     VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
     std::vector<VkImage> swapchain_images_;
@@ -216,38 +418,63 @@ protected:
     VkShaderModule vert_shader_module_ = VK_NULL_HANDLE;
     VkShaderModule frag_shader_module_ = VK_NULL_HANDLE;
 
+    ShaderReflection shader_reflection_;
     VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+    // Keyed by the bytes of the bindings.
+    std::unordered_map<std::string, VkDescriptorSetLayout> descriptor_set_layouts_;
+    std::string pipeline_cache_file_ = "pipeline_cache.bin";
+    VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
     VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
     VkPipeline graphics_pipeline_ = VK_NULL_HANDLE;
 
     VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    UploadBatch upload_batch_;
+    // Streams assets while frames are drawn, uploads run from UploadStreamedAssets.
+    AssetStreamer asset_streamer_;
+    // Bytes of streamed assets uploaded per frame, more only if a single asset is larger.
+    size_t stream_upload_budget_ = 8 * 1024 * 1024;
+    // Device memory for textures registered with texture_residency_, 0 picks a default, see
+    // GetTextureMemoryBudget.
+    size_t texture_memory_budget_ = 0;
+    TextureResidency texture_residency_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> retired_resources_;
+    // Build texture mip chains with GenerateMipChain instead of GPU blits.
+    bool generate_mipmaps_on_cpu_ = false;
 
     VkImage depth_image_;
-    VkDeviceMemory depth_image_memory_;
+    MemoryAllocation depth_image_memory_;
     VkImageView depth_image_view_;
 
     std::vector<VkFramebuffer> framebuffers_;
 
     VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
-    VkDeviceMemory vertex_buffer_memory_ = VK_NULL_HANDLE;
+    MemoryAllocation vertex_buffer_memory_;
 
     VkBuffer index_buffer_ = VK_NULL_HANDLE;
-    VkDeviceMemory index_buffer_memory_ = VK_NULL_HANDLE;
+    MemoryAllocation index_buffer_memory_;
 
-    std::vector<VkBuffer> uniform_buffers_;
-    std::vector<VkDeviceMemory> uniform_buffers_memory_;
+    // One persistently mapped buffer holding a slot per frame, bound as
+    // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC with GetUniformOffset(slot).
+    VkBuffer uniform_buffer_ = VK_NULL_HANDLE;
+    MemoryAllocation uniform_buffer_memory_;
+    VkDeviceSize uniform_buffer_stride_ = 0;
 
     VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
 
     std::vector<VkDescriptorSet> descriptor_sets_;
 
+    // One per frame in flight, reset and re-recorded by Draw.
     std::vector<VkCommandBuffer> command_buffers_;
+    VkClearColorValue clear_color_ = {{1.0f, 1.0f, 1.0f, 1.0f}};
 
     std::vector<VkSemaphore> image_available_semaphores_;
     std::vector<VkSemaphore> render_finished_semaphores_;
     std::vector<VkFence> in_flight_fences_;
     std::vector<VkFence> images_in_flight_;
     uint32_t max_frames_in_flight_ = 2;
+    uint32_t current_frame_ = 0;
+    // Frames drawn so far.
+    uint64_t frame_count_ = 0;
 };
 
 } //namespace tiny_engine